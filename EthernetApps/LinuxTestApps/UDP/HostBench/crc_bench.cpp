@@ -0,0 +1,117 @@
+/*
+ * CRC32C Benchmark
+ * Host comparison of the two CRC32C implementations that check each other's
+ * trailers: the board's slice-by-8 tables (firmware crc32c.c, built as C
+ * under the board_ prefix) and the client's crc32c.cpp, which uses the
+ * SSE4.2 or ARMv8 CRC instruction when the CPU has it. Checks that both
+ * give the standard check value and agree on every length, alignment and
+ * split, then times each over small, frame-sized and bulk buffers.
+ *
+ * Build: make crc_bench
+ * Usage: ./crc_bench [megabytes per size]
+ */
+
+#include "crc32c.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+extern "C" {
+void board_crc32c_init(void);
+uint32_t board_crc32c(uint32_t crc, const void *buf, uint32_t len);
+}
+
+namespace {
+
+const unsigned long kDefaultMegabytes = 256;
+const quint32 kCheck = 0xE3069283; // crc32c("123456789")
+
+unsigned long failures;
+
+#define CHECK(cond)                                                        \
+  do {                                                                     \
+    if (!(cond)) {                                                         \
+      std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__,         \
+                   __LINE__, #cond);                                       \
+      failures++;                                                          \
+    }                                                                      \
+  } while (0)
+
+quint32 client(quint32 crc, const uchar *p, size_t length) {
+  return crc32c(crc, p, static_cast<qsizetype>(length));
+}
+
+quint32 board(quint32 crc, const uchar *p, size_t length) {
+  return board_crc32c(crc, p, static_cast<uint32_t>(length));
+}
+
+void testAgreement() {
+  CHECK(client(0, reinterpret_cast<const uchar *>("123456789"), 9) == kCheck);
+  CHECK(board(0, reinterpret_cast<const uchar *>("123456789"), 9) == kCheck);
+  CHECK(client(0, nullptr, 0) == 0 && board(0, nullptr, 0) == 0);
+
+  std::vector<uchar> buffer(4096 + 8);
+  srand(1);
+  for (auto &b : buffer)
+    b = static_cast<uchar>(rand());
+
+  // Every misalignment, across the bytewise head, the 8-byte body and tail
+  for (size_t offset = 0; offset < 8; offset++) {
+    for (size_t length = 0; length <= 2100; length += (length < 64 ? 1 : 37)) {
+      const uchar *p = buffer.data() + offset;
+      quint32 whole = client(0, p, length);
+      CHECK(board(0, p, length) == whole);
+
+      // A CRC continued over a split buffer matches the whole one
+      size_t split = length / 3;
+      CHECK(client(client(0, p, split), p + split, length - split) == whole);
+      CHECK(board(board(0, p, split), p + split, length - split) == whole);
+    }
+  }
+}
+
+template <typename Function>
+double nsPerKb(Function crc, const std::vector<uchar> &buffer,
+               unsigned long rounds) {
+  volatile quint32 sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned long r = 0; r < rounds; r++)
+    sink = crc(sink, buffer.data(), buffer.size());
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / rounds * 1024 / buffer.size();
+}
+
+void bench(unsigned long megabytes) {
+  std::printf("ns per KB, %lu MB per size (client uses %s)\n", megabytes,
+              crc32cImplementation());
+  for (size_t size : {64, 1024, 65536}) {
+    std::vector<uchar> buffer(size);
+    for (size_t i = 0; i < size; i++)
+      buffer[i] = static_cast<uchar>(i * 7);
+    unsigned long rounds = megabytes * 1024 * 1024 / size;
+
+    double tables = nsPerKb(board, buffer, rounds);
+    double client_ns = nsPerKb(client, buffer, rounds);
+    std::printf("%6zu B: board slice-by-8 %8.1f  client %8.1f  (%.1fx)\n",
+                size, tables, client_ns, tables / client_ns);
+  }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  unsigned long megabytes =
+      argc > 1 ? std::strtoul(argv[1], nullptr, 0) : kDefaultMegabytes;
+
+  board_crc32c_init();
+  testAgreement();
+  if (failures != 0) {
+    std::fprintf(stderr, "%lu checks failed\n", failures);
+    return 1;
+  }
+  if (megabytes > 0)
+    bench(megabytes);
+  return 0;
+}
@@ -0,0 +1,185 @@
+/*
+ * Slab Allocator Benchmark
+ * Host check of the board's slab.c, built against the lwIP/BSP stubs in
+ * stubs/. Fills the classes in order to check that a request spills into a
+ * larger class only when its own is empty and that exhaustion is counted,
+ * then times slab_alloc/slab_free pairs against malloc/free.
+ *
+ * Build: make slab_bench
+ * Usage: ./slab_bench [rounds]
+ */
+
+#include "slab.c" // The class table and its counters are static
+#include <stdlib.h>
+
+#define DEFAULT_ROUNDS 10000000UL
+#define BURST 16 // Objects held at once in the burst benchmark
+
+static unsigned long failures;
+
+#define CHECK(cond)                                                        \
+  do {                                                                     \
+    if (!(cond)) {                                                         \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,    \
+              #cond);                                                      \
+      failures++;                                                          \
+    }                                                                      \
+  } while (0)
+
+static uint64_t now_ns(void) {
+  XTime t;
+  XTime_GetTime(&t);
+  return t;
+}
+
+static int in_class(const void *obj, const slab_class_t *c) {
+  return (const u8_t *)obj >= c->base &&
+         (const u8_t *)obj < c->base + (u32_t)c->count * c->size &&
+         ((const u8_t *)obj - c->base) % c->size == 0;
+}
+
+static void test_counters(void) {
+  enum { TOTAL = SLAB_SMALL_COUNT + SLAB_MEDIUM_COUNT + SLAB_LARGE_COUNT };
+  static void *held[TOTAL];
+  slab_class_t *small = &slab_classes[0];
+  slab_class_t *medium = &slab_classes[1];
+  slab_class_t *large = &slab_classes[2];
+
+  slab_init();
+
+  // Small requests fill their own class before touching the next one
+  for (int i = 0; i < TOTAL; i++) {
+    held[i] = slab_alloc(40);
+    CHECK(held[i] != NULL);
+    const slab_class_t *want = i < SLAB_SMALL_COUNT ? small
+                               : i < SLAB_SMALL_COUNT + SLAB_MEDIUM_COUNT
+                                   ? medium
+                                   : large;
+    CHECK(in_class(held[i], want));
+    memset(held[i], 0xA5, 40); // Must not disturb the other free lists
+  }
+  CHECK(small->in_use == SLAB_SMALL_COUNT && small->spills == 0);
+  CHECK(medium->in_use == SLAB_MEDIUM_COUNT &&
+        medium->spills == SLAB_MEDIUM_COUNT);
+  CHECK(large->in_use == SLAB_LARGE_COUNT &&
+        large->spills == SLAB_LARGE_COUNT);
+  CHECK(small->failures == 0 && medium->failures == 0 &&
+        large->failures == 0);
+
+  // Exhaustion is a NULL charged to the class the request fits
+  CHECK(slab_alloc(1) == NULL && small->failures == 1);
+  CHECK(slab_alloc(SLAB_MEDIUM_SIZE) == NULL && medium->failures == 1);
+  CHECK(slab_alloc(SLAB_LARGE_SIZE) == NULL && large->failures == 1);
+  // Larger than any class: refused without a count
+  CHECK(slab_alloc(SLAB_LARGE_SIZE + 1) == NULL);
+  CHECK(small->failures + medium->failures + large->failures == 3);
+
+  // A freed spill object goes back to its own class, not the requester's
+  slab_free(held[SLAB_SMALL_COUNT]);
+  CHECK(medium->in_use == SLAB_MEDIUM_COUNT - 1 &&
+        small->in_use == SLAB_SMALL_COUNT);
+  CHECK(slab_alloc(SLAB_MEDIUM_SIZE) == held[SLAB_SMALL_COUNT]);
+  CHECK(medium->spills == SLAB_MEDIUM_COUNT); // Fit, not a spill
+
+  for (int i = 0; i < TOTAL; i++) {
+    slab_free(held[i]);
+  }
+  for (int i = 0; i < SLAB_CLASSES; i++) {
+    const slab_class_t *c = &slab_classes[i];
+    CHECK(c->in_use == 0 && c->allocs == c->frees && c->peak == c->count);
+  }
+
+  // Every object is reachable again once all are back
+  for (int i = 0; i < SLAB_SMALL_COUNT; i++) {
+    held[i] = slab_alloc(SLAB_SMALL_SIZE);
+    CHECK(in_class(held[i], small));
+  }
+  CHECK(small->spills == 0 && medium->spills == SLAB_MEDIUM_COUNT);
+  for (int i = 0; i < SLAB_SMALL_COUNT; i++) {
+    slab_free(held[i]);
+  }
+
+  // Foreign pointers are reported, not chained
+  int foreign;
+  u32_t frees = small->frees + medium->frees + large->frees;
+  printf("(expected) ");
+  slab_free(&foreign);
+  CHECK(small->frees + medium->frees + large->frees == frees);
+}
+
+static void bench(unsigned long rounds) {
+  static const u16_t sizes[SLAB_CLASSES] = {48, 200, 1024};
+  void *volatile sink; // Keeps malloc/free pairs from being elided
+  void *held[BURST];
+
+  slab_init();
+  for (int c = 0; c < SLAB_CLASSES; c++) {
+    u16_t size = sizes[c];
+
+    uint64_t start = now_ns();
+    for (unsigned long r = 0; r < rounds; r++) {
+      sink = slab_alloc(size);
+      slab_free(sink);
+    }
+    uint64_t slab_ns = now_ns() - start;
+
+    start = now_ns();
+    for (unsigned long r = 0; r < rounds; r++) {
+      sink = malloc(size);
+      free(sink);
+    }
+    uint64_t malloc_ns = now_ns() - start;
+
+    // Bursts hold several objects at once, as the send queue does
+    unsigned long bursts = rounds / BURST;
+    start = now_ns();
+    for (unsigned long r = 0; r < bursts; r++) {
+      for (int i = 0; i < BURST; i++) {
+        held[i] = slab_alloc(size);
+      }
+      sink = held[BURST - 1];
+      for (int i = BURST - 1; i >= 0; i--) {
+        slab_free(held[i]);
+      }
+    }
+    uint64_t slab_burst_ns = now_ns() - start;
+
+    start = now_ns();
+    for (unsigned long r = 0; r < bursts; r++) {
+      for (int i = 0; i < BURST; i++) {
+        held[i] = malloc(size);
+      }
+      sink = held[BURST - 1];
+      for (int i = BURST - 1; i >= 0; i--) {
+        free(held[i]);
+      }
+    }
+    uint64_t malloc_burst_ns = now_ns() - start;
+
+    unsigned long ops = bursts * BURST;
+    printf("%4dB: pair slab %.2f ns malloc %.2f ns | burst of %d slab "
+           "%.2f ns malloc %.2f ns (per alloc+free)\n",
+           size, (double)slab_ns / rounds, (double)malloc_ns / rounds, BURST,
+           ops ? (double)slab_burst_ns / ops : 0.0,
+           ops ? (double)malloc_burst_ns / ops : 0.0);
+  }
+  (void)sink;
+
+  for (int c = 0; c < SLAB_CLASSES; c++) {
+    CHECK(slab_classes[c].in_use == 0 && slab_classes[c].failures == 0);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  unsigned long rounds = argc > 1 ? strtoul(argv[1], NULL, 0) : DEFAULT_ROUNDS;
+
+  test_counters();
+  if (failures == 0 && rounds > 0) {
+    bench(rounds);
+  }
+  if (failures != 0) {
+    fprintf(stderr, "%lu checks failed\n", failures);
+    return 1;
+  }
+  return 0;
+}
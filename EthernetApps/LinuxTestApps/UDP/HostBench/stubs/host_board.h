@@ -0,0 +1,57 @@
+/*
+ * Host Board Stubs
+ * The few lwIP and Xilinx BSP types and calls that data_transfer.h pulls in,
+ * mapped onto the C library, so board modules that only use them (slab.c,
+ * crc32c.c) build and run on a Linux host. Every stub header includes this.
+ */
+
+#ifndef __HOST_BOARD_H_
+#define __HOST_BOARD_H_
+
+#define _POSIX_C_SOURCE 200809L // clock_gettime under -std=c11
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/* lwIP arch and xil_types */
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+typedef int8_t s8_t;
+typedef int16_t s16_t;
+typedef int32_t s32_t;
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int32_t s32;
+typedef int64_t s64;
+
+/* lwip/err.h, lwip/ip_addr.h, lwip/udp.h: declarations only */
+typedef s8_t err_t;
+#define ERR_OK 0
+#define ERR_MEM -1
+
+typedef struct {
+  u32_t addr;
+} ip_addr_t;
+#define ip_addr_cmp(a, b) ((a)->addr == (b)->addr)
+
+struct pbuf;
+struct udp_pcb;
+
+/* xil_printf.h */
+#define xil_printf printf
+
+/* xtime_l.h: a nanosecond clock */
+typedef uint64_t XTime;
+#define COUNTS_PER_SECOND 1000000000ULL
+
+static inline void XTime_GetTime(XTime *t) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  *t = (XTime)ts.tv_sec * COUNTS_PER_SECOND + (XTime)ts.tv_nsec;
+}
+
+#endif /* __HOST_BOARD_H_ */
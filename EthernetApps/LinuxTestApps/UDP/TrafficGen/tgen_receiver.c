@@ -0,0 +1,258 @@
+/*
+ * Traffic Generator Receiver
+ * Linux counterpart of the board's TGEN command: starts a generator run,
+ * receives the datagrams and reports goodput, loss and reordering.
+ *
+ * Build: gcc -O2 -Wall -o tgen_receiver tgen_receiver.c
+ * Usage: ./tgen_receiver <board_ip> [size] [count] [rate_pps] [port]
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Must match data_transfer.h / traffic_gen.h on the board */
+#define DATA_TRANSFER_PORT 8888
+#define MAX_DATA_SIZE 1024
+#define MSG_TYPE_COMMAND 0x02
+#define MSG_TYPE_RESPONSE 0x03
+#define MSG_TYPE_TGEN 0x05
+#define TGEN_MAGIC 0x4E454754
+
+#define IDLE_TIMEOUT_MS 2000
+
+typedef struct {
+  uint8_t msg_type;
+  uint8_t sequence;
+  uint16_t length;
+  uint8_t data[MAX_DATA_SIZE - 4];
+} data_message_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t run_id;
+  uint32_t sequence;
+  uint32_t count;
+  uint32_t tx_time_lo;
+  uint32_t tx_time_hi;
+} tgen_header_t;
+
+typedef struct {
+  uint32_t received;
+  uint32_t unique;
+  uint32_t duplicates;
+  uint32_t reordered;
+  uint64_t bytes;
+  int64_t highest_seq;
+  uint32_t count;
+  uint8_t *seen; // One bit per sequence number
+  uint64_t first_rx_ns;
+  uint64_t last_rx_ns;
+} rx_stats_t;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int send_command(int sock, const struct sockaddr_in *board,
+                        const char *text) {
+  data_message_t msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_type = MSG_TYPE_COMMAND;
+  msg.length = (uint16_t)snprintf((char *)msg.data, sizeof(msg.data), "%s", text);
+
+  /* The board only accepts full-size messages */
+  return sendto(sock, &msg, sizeof(msg), 0, (const struct sockaddr *)board,
+                sizeof(*board)) == (ssize_t)sizeof(msg)
+             ? 0
+             : -1;
+}
+
+static void account_packet(rx_stats_t *rx, const uint8_t *buf, ssize_t len,
+                           uint32_t run_id) {
+  tgen_header_t hdr;
+  if (len < (ssize_t)(4 + sizeof(hdr))) {
+    return;
+  }
+  memcpy(&hdr, buf + 4, sizeof(hdr));
+  if (hdr.magic != TGEN_MAGIC || (run_id != 0 && hdr.run_id != run_id)) {
+    return;
+  }
+
+  if (rx->seen == NULL) {
+    rx->count = hdr.count;
+    rx->seen = calloc((hdr.count + 7) / 8, 1);
+    if (rx->seen == NULL) {
+      fprintf(stderr, "Out of memory for %u sequence bits\n", hdr.count);
+      exit(1);
+    }
+  }
+  if (hdr.sequence >= rx->count) {
+    return;
+  }
+
+  uint64_t t = now_ns();
+  if (rx->received == 0) {
+    rx->first_rx_ns = t;
+  }
+  rx->last_rx_ns = t;
+  rx->received++;
+
+  uint8_t bit = (uint8_t)(1u << (hdr.sequence & 7));
+  if (rx->seen[hdr.sequence >> 3] & bit) {
+    rx->duplicates++;
+    return;
+  }
+  rx->seen[hdr.sequence >> 3] |= bit;
+  rx->unique++;
+  rx->bytes += (uint64_t)len;
+
+  if ((int64_t)hdr.sequence < rx->highest_seq) {
+    rx->reordered++;
+  } else {
+    rx->highest_seq = hdr.sequence;
+  }
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <board_ip> [size] [count] [rate_pps] [port]\n",
+            argv[0]);
+    return 1;
+  }
+
+  unsigned size = argc > 2 ? (unsigned)strtoul(argv[2], NULL, 0) : 1024;
+  unsigned count = argc > 3 ? (unsigned)strtoul(argv[3], NULL, 0) : 10000;
+  unsigned rate = argc > 4 ? (unsigned)strtoul(argv[4], NULL, 0) : 0;
+  unsigned port = argc > 5 ? (unsigned)strtoul(argv[5], NULL, 0)
+                           : DATA_TRANSFER_PORT;
+
+  struct sockaddr_in board;
+  memset(&board, 0, sizeof(board));
+  board.sin_family = AF_INET;
+  board.sin_port = htons((uint16_t)port);
+  if (inet_pton(AF_INET, argv[1], &board.sin_addr) != 1) {
+    fprintf(stderr, "Invalid board address: %s\n", argv[1]);
+    return 1;
+  }
+
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sock < 0) {
+    perror("socket");
+    return 1;
+  }
+
+  /* A deep receive buffer keeps kernel drops out of the measurement */
+  int rcvbuf = 8 * 1024 * 1024;
+  setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+  struct timeval tv = {0, 100 * 1000};
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  char command[64];
+  snprintf(command, sizeof(command), "TGEN %u %u %u", size, count, rate);
+  if (send_command(sock, &board, command) != 0) {
+    perror("sendto");
+    return 1;
+  }
+  printf("Sent '%s' to %s:%u\n", command, argv[1], port);
+
+  rx_stats_t rx;
+  memset(&rx, 0, sizeof(rx));
+  rx.highest_seq = -1;
+
+  uint32_t run_id = 0;
+  char board_report[MAX_DATA_SIZE] = "";
+  uint64_t last_activity = now_ns();
+  uint8_t buf[2048];
+
+  for (;;) {
+    ssize_t len = recv(sock, buf, sizeof(buf), 0);
+    if (len < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        perror("recv");
+        break;
+      }
+      if ((now_ns() - last_activity) / 1000000ull > IDLE_TIMEOUT_MS) {
+        printf("No traffic for %d ms, stopping\n", IDLE_TIMEOUT_MS);
+        break;
+      }
+      continue;
+    }
+    last_activity = now_ns();
+    if (len < 4) {
+      continue;
+    }
+
+    if (buf[0] == MSG_TYPE_TGEN) {
+      account_packet(&rx, buf, len, run_id);
+    } else if (buf[0] == MSG_TYPE_RESPONSE) {
+      char text[MAX_DATA_SIZE];
+      uint16_t text_len;
+      memcpy(&text_len, buf + 2, sizeof(text_len));
+      if (text_len > len - 4) {
+        text_len = (uint16_t)(len - 4);
+      }
+      if (text_len > sizeof(text) - 1) {
+        text_len = sizeof(text) - 1; // The datagram may exceed one frame
+      }
+      memcpy(text, buf + 4, text_len);
+      text[text_len] = '\0';
+      printf("Board: %s\n", text);
+
+      if (strncmp(text, "TGEN started run=", 17) == 0) {
+        run_id = (uint32_t)strtoul(text + 17, NULL, 10);
+      } else if (strncmp(text, "TGEN done", 9) == 0) {
+        snprintf(board_report, sizeof(board_report), "%s", text);
+        break;
+      } else if (strncmp(text, "TGEN error", 10) == 0 ||
+                 strncmp(text, "TGEN busy", 9) == 0) {
+        return 1;
+      }
+    }
+  }
+
+  /* Drain what is still queued in the socket after the report */
+  tv.tv_usec = 200 * 1000;
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  for (;;) {
+    ssize_t len = recv(sock, buf, sizeof(buf), 0);
+    if (len < 0) {
+      break;
+    }
+    if (len >= 4 && buf[0] == MSG_TYPE_TGEN) {
+      account_packet(&rx, buf, len, run_id);
+    }
+  }
+  close(sock);
+
+  uint32_t expected = rx.count ? rx.count : count;
+  uint32_t lost = expected - rx.unique;
+  double seconds = (double)(rx.last_rx_ns - rx.first_rx_ns) / 1e9;
+
+  printf("\n=== Receiver Results ===\n");
+  printf("Expected:    %u\n", expected);
+  printf("Received:    %u (unique %u, duplicates %u)\n", rx.received,
+         rx.unique, rx.duplicates);
+  printf("Lost:        %u (%.3f%%)\n", lost,
+         expected ? 100.0 * lost / expected : 0.0);
+  printf("Reordered:   %u\n", rx.reordered);
+  if (seconds > 0 && rx.unique > 1) {
+    printf("Duration:    %.3f s\n", seconds);
+    printf("Rate:        %.0f pps\n", (rx.unique - 1) / seconds);
+    printf("Goodput:     %.3f Mbit/s\n", rx.bytes * 8.0 / seconds / 1e6);
+  }
+  if (board_report[0] != '\0') {
+    printf("Board:       %s\n", board_report);
+  }
+
+  free(rx.seen);
+  return lost == 0 ? 0 : 2;
+}
@@ -5,12 +5,23 @@ CONFIG += c++17
 TARGET = ZynqDataTransferClient
 TEMPLATE = app
 
+# wire.h, the message framing shared with the Zynq firmware
+FIRMWARE_SRC_DIR = $$PWD/../../../../UDP/Freeflow_custom/UDP_echoServer/src
+INCLUDEPATH += $$FIRMWARE_SRC_DIR
+
 SOURCES += \
     main.cpp \
-    mainwindow.cpp
+    mainwindow.cpp \
+    crc32c.cpp \
+    fec.cpp \
+    rchan.cpp
 
 HEADERS += \
-    mainwindow.h
+    mainwindow.h \
+    crc32c.h \
+    fec.h \
+    rchan.h \
+    $$FIRMWARE_SRC_DIR/wire.h
 
 # Enable automatic MOC processing
 CONFIG += moc
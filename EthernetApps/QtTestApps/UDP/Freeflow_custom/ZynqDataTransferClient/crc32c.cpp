@@ -0,0 +1,143 @@
+#include "crc32c.h"
+#include <QtEndian>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||          \
+    defined(_M_IX86)
+#define CRC32C_X86
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+// Needs -march=armv8-a+crc (default on Apple silicon); otherwise the
+// tables below are used
+#define CRC32C_ARM
+#include <arm_acle.h>
+#endif
+
+namespace {
+
+const quint32 kPoly = 0x82F63B78; // Reflected Castagnoli polynomial
+
+// The three implementations work on the inverted CRC register
+using CrcFunction = quint32 (*)(quint32, const uchar *, qsizetype);
+
+// Slice-by-8 tables, as on the Zynq: 8 input bytes per step
+struct Tables {
+  quint32 t[8][256];
+
+  Tables() {
+    for (quint32 n = 0; n < 256; n++) {
+      quint32 crc = n;
+      for (int k = 0; k < 8; k++)
+        crc = (crc >> 1) ^ (kPoly & (0u - (crc & 1)));
+      t[0][n] = crc;
+    }
+    for (quint32 n = 0; n < 256; n++) {
+      for (int i = 1; i < 8; i++)
+        t[i][n] = (t[i - 1][n] >> 8) ^ t[0][t[i - 1][n] & 0xFF];
+    }
+  }
+};
+
+quint32 crcTables(quint32 crc, const uchar *p, qsizetype length) {
+  static const Tables tables;
+  const auto &t = tables.t;
+
+  while (length >= 8) {
+    quint32 lo = qFromLittleEndian<quint32>(p) ^ crc;
+    quint32 hi = qFromLittleEndian<quint32>(p + 4);
+    crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^
+          t[4][lo >> 24] ^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^
+          t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    p += 8;
+    length -= 8;
+  }
+  while (length-- > 0)
+    crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+  return crc;
+}
+
+#ifdef CRC32C_X86
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("sse4.2")))
+#endif
+quint32 crcSse42(quint32 crc, const uchar *p, qsizetype length) {
+#if defined(__x86_64__) || defined(_M_X64)
+  quint64 crc64 = crc;
+  while (length >= 8) {
+    quint64 word;
+    memcpy(&word, p, 8);
+    crc64 = _mm_crc32_u64(crc64, word);
+    p += 8;
+    length -= 8;
+  }
+  crc = static_cast<quint32>(crc64);
+#endif
+  while (length >= 4) {
+    quint32 word;
+    memcpy(&word, p, 4);
+    crc = _mm_crc32_u32(crc, word);
+    p += 4;
+    length -= 4;
+  }
+  while (length-- > 0)
+    crc = _mm_crc32_u8(crc, *p++);
+  return crc;
+}
+
+bool haveSse42() {
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 20)) != 0;
+#else
+  return __builtin_cpu_supports("sse4.2");
+#endif
+}
+#endif
+
+#ifdef CRC32C_ARM
+quint32 crcArmv8(quint32 crc, const uchar *p, qsizetype length) {
+  while (length >= 8) {
+    quint64 word;
+    memcpy(&word, p, 8);
+    crc = __crc32cd(crc, word);
+    p += 8;
+    length -= 8;
+  }
+  while (length-- > 0)
+    crc = __crc32cb(crc, *p++);
+  return crc;
+}
+#endif
+
+struct Implementation {
+  CrcFunction function;
+  const char *name;
+};
+
+// Picked once, on first use
+const Implementation &implementation() {
+  static const Implementation chosen = []() -> Implementation {
+#ifdef CRC32C_X86
+    if (haveSse42())
+      return {crcSse42, "SSE4.2"};
+#endif
+#ifdef CRC32C_ARM
+    return {crcArmv8, "ARMv8 CRC"};
+#endif
+    return {crcTables, "slice-by-8"};
+  }();
+  return chosen;
+}
+
+} // namespace
+
+quint32 crc32c(quint32 crc, const void *data, qsizetype length) {
+  return ~implementation().function(
+      ~crc, static_cast<const uchar *>(data), length);
+}
+
+const char *crc32cImplementation() { return implementation().name; }
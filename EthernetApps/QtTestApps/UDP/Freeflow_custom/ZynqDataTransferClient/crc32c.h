@@ -0,0 +1,15 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <QtGlobal>
+
+// CRC32C (Castagnoli), matching crc32c.c on the Zynq side. crc32c(0, ...)
+// starts a CRC; passing the result back in continues it over the next
+// buffer. Uses the SSE4.2 or ARMv8 CRC instruction when the CPU has it and
+// slice-by-8 tables otherwise.
+quint32 crc32c(quint32 crc, const void *data, qsizetype length);
+
+// Name of the implementation crc32c() picked on this machine
+const char *crc32cImplementation();
+
+#endif // CRC32C_H
@@ -0,0 +1,122 @@
+#include "fec.h"
+#include <utility>
+
+namespace {
+
+// GF(2^8) with polynomial 0x11d; exp is doubled so log sums need no
+// reduction
+struct Field {
+  quint8 exp[512];
+  quint8 log[256];
+
+  Field() {
+    int x = 1;
+    for (int i = 0; i < 255; i++) {
+      exp[i] = exp[i + 255] = static_cast<quint8>(x);
+      log[x] = static_cast<quint8>(i);
+      x <<= 1;
+      if (x & 0x100)
+        x ^= 0x11d;
+    }
+    log[0] = 0; // Never used: zero is handled before any lookup
+  }
+
+  quint8 mul(quint8 a, quint8 b) const {
+    return a == 0 || b == 0 ? 0 : exp[log[a] + log[b]];
+  }
+  quint8 inv(quint8 a) const { return exp[255 - log[a]]; }
+};
+
+const Field &field() {
+  static const Field f;
+  return f;
+}
+
+quint8 coefficient(int row, int index) {
+  const Field &f = field();
+  return f.mul(static_cast<quint8>(255 ^ index),
+               f.inv(static_cast<quint8>((255 - row) ^ index)));
+}
+
+// block ^= c * source over the first length bytes
+void accumulate(QByteArray *block, const QByteArray &source, quint8 c) {
+  const Field &f = field();
+  char *out = block->data();
+  int length = qMin(block->size(), source.size());
+  for (int n = 0; n < length; n++) {
+    out[n] = static_cast<char>(
+        static_cast<quint8>(out[n]) ^
+        f.mul(c, static_cast<quint8>(source.at(n))));
+  }
+}
+
+} // namespace
+
+bool fecRecover(QVector<QByteArray> *data,
+                const QMap<int, QByteArray> &parity) {
+  QVector<int> lost;
+  for (int i = 0; i < data->size(); i++) {
+    if (data->at(i).isEmpty())
+      lost.append(i);
+  }
+  int e = lost.size();
+  if (e == 0)
+    return true;
+  if (parity.size() < e)
+    return false;
+
+  // One equation per parity row used: the parity minus the contribution
+  // of every block that did arrive leaves a sum over the lost blocks only
+  QVector<int> rows;
+  QVector<QByteArray> syndromes;
+  for (auto it = parity.constBegin(); it != parity.constEnd() &&
+                                      rows.size() < e;
+       ++it) {
+    QByteArray s = it.value();
+    for (int i = 0; i < data->size(); i++) {
+      if (!data->at(i).isEmpty())
+        accumulate(&s, data->at(i), coefficient(it.key(), i));
+    }
+    rows.append(it.key());
+    syndromes.append(s);
+  }
+
+  // Invert the e x e matrix coef(rows[r], lost[c]) by Gauss-Jordan; any
+  // square Cauchy submatrix is invertible, so a pivot exists unless a row
+  // index was out of range
+  const Field &f = field();
+  QVector<QVector<quint8>> a(e, QVector<quint8>(2 * e, 0));
+  for (int r = 0; r < e; r++) {
+    for (int c = 0; c < e; c++)
+      a[r][c] = coefficient(rows[r], lost[c]);
+    a[r][e + r] = 1;
+  }
+  for (int c = 0; c < e; c++) {
+    int pivot = c;
+    while (pivot < e && a[pivot][c] == 0)
+      pivot++;
+    if (pivot == e)
+      return false;
+    std::swap(a[c], a[pivot]);
+    quint8 scale = f.inv(a[c][c]);
+    for (int k = 0; k < 2 * e; k++)
+      a[c][k] = f.mul(a[c][k], scale);
+    for (int r = 0; r < e; r++) {
+      quint8 factor = a[r][c];
+      if (r == c || factor == 0)
+        continue;
+      for (int k = 0; k < 2 * e; k++)
+        a[r][k] ^= f.mul(factor, a[c][k]);
+    }
+  }
+
+  // Lost block c is row c of the inverse applied to the syndromes
+  int length = syndromes.first().size();
+  for (int c = 0; c < e; c++) {
+    QByteArray block(length, '\0');
+    for (int r = 0; r < e; r++)
+      accumulate(&block, syndromes[r], a[c][e + r]);
+    (*data)[lost[c]] = block;
+  }
+  return true;
+}
@@ -0,0 +1,21 @@
+#ifndef FEC_H
+#define FEC_H
+
+#include <QByteArray>
+#include <QMap>
+#include <QVector>
+
+// Erasure decoding for the FEC groups of fec.c on the Zynq side: parity
+// row j of a group is the sum over i of coef(j, i) * data block i in
+// GF(2^8), blocks zero-padded to the longest, with the Cauchy coefficients
+// coef(j, i) = (255 ^ i) / ((255 - j) ^ i). Row 0 is plain XOR.
+
+// Rebuilds the lost blocks of a group: data holds its k data blocks, empty
+// where lost, parity the received parity blocks by row. Rebuilt blocks
+// come back parity-sized, padding included. Returns false, leaving data
+// untouched, if fewer parity blocks than lost data blocks arrived or the
+// rows they came on leave the system singular.
+bool fecRecover(QVector<QByteArray> *data,
+                const QMap<int, QByteArray> &parity);
+
+#endif // FEC_H
@@ -1,28 +1,212 @@
 #include "mainwindow.h"
+#include "crc32c.h"
+#include "fec.h"
+#include "wire.h"
 #include <QDateTime>
 #include <QNetworkDatagram>
+#include <QtEndian>
+#include <utility>
 
 
-// Message types (matching Zynq application)
-enum MessageType {
-  MSG_TYPE_DATA = 0x01,
-  MSG_TYPE_COMMAND = 0x02,
-  MSG_TYPE_RESPONSE = 0x03,
-  MSG_TYPE_HEARTBEAT = 0x04
-};
-
-// Data structure (matching Zynq application)
+// Message types and framing are shared with the Zynq side through wire.h.
+// A received message is a view: data points into the datagram, or into a
+// buffer of the caller, and is valid for the duration of the call only.
 struct DataMessage {
   quint8 msgType;
   quint8 sequence;
   quint16 length;
-  char data[1020]; // Total size minus header
+  const char *data;
 };
 
+static const int kHeaderSize = WIRE_V1_HEADER_SIZE;
+static const int kMaxData = WIRE_V1_MAX_DATA;
+
+// Protocol v2 send sequences, one per message type (proto.h on the Zynq side)
+static const int kV2Streams = 32;
+
+// Fragmentation (fragment.h on the Zynq side): u16 message id, u16 index,
+// u16 count, u8 msg type, u8 reserved, u32 total length and the CRC32C of
+// the whole message, then FRAGMENT_PAYLOAD bytes of it per fragment
+static const int kFragmentHeaderSize = 16;
+static const int kFragmentPayload = kMaxData - kFragmentHeaderSize;
+static const int kFragmentMaxMessage = 64 * 1024;
+static const int kFragmentSlots = 4; // Messages reassembled at the same time
+static const qint64 kFragmentTimeoutMs = 2000; // Without a new fragment
+
+// FEC groups (fec.h on the Zynq side): u16 group, u8 index, u8 parity flag,
+// u8 k, u8 m, u16 reserved, then the wrapped message or a parity block
+static const int kFecHeaderSize = 8;
+static const int kFecMaxK = 32;
+static const int kFecMaxM = 4; // Parity rows, FEC_MAX_M in fec.h
+static const qint64 kFecGroupTimeoutMs = 1000; // Parity no longer expected
+
+// Reliable channel services (rchan.h on the Zynq side)
+static const quint8 kServiceBlob = 1; // Test blobs, see blob.h
+static const int kBlobMax = 256 * 1024; // What the board accepts
+
+// Credit (credit.h on the Zynq side): u32 messages, u32 bytes, u8 flags and
+// 3 reserved bytes. Granted as read, a quarter window at a time, so the
+// board's streaming stops short of what the socket buffer holds.
+static const int kCreditSize = 12;
+static const quint8 kCreditFlagReset = 0x01;
+static const quint32 kCreditWindowMessages = 64;
+static const quint32 kCreditWindowBytes = 64 * 1024;
+static const int kCreditSocketBuffer = 256 * 1024; // Room for the window
+
+// Decodes an LZ4 block into dst; returns the decoded size, or -1 if the
+// block is malformed or would not fit in dstCapacity
+static int lz4Decompress(const uchar *src, int srcLength, char *dst,
+                         int dstCapacity) {
+  const uchar *ip = src;
+  const uchar *end = src + srcLength;
+  int op = 0;
+
+  while (ip < end) {
+    int token = *ip++;
+
+    // Literal run, its length continued in 255 steps
+    int literals = token >> 4;
+    if (literals == 15) {
+      int more;
+      do {
+        if (ip >= end)
+          return -1;
+        more = *ip++;
+        literals += more;
+      } while (more == 255);
+    }
+    if (literals > end - ip || literals > dstCapacity - op)
+      return -1;
+    memcpy(dst + op, ip, literals);
+    ip += literals;
+    op += literals;
+    if (ip == end)
+      return op; // A block ends after its last literals
+
+    // Match: offset back into the output, copied bytewise as it may overlap
+    if (end - ip < 2)
+      return -1;
+    int offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    int length = (token & 0x0F) + 4;
+    if ((token & 0x0F) == 15) {
+      int more;
+      do {
+        if (ip >= end)
+          return -1;
+        more = *ip++;
+        length += more;
+      } while (more == 255);
+    }
+    if (offset == 0 || offset > op || length > dstCapacity - op)
+      return -1;
+    for (int i = 0; i < length; i++, op++)
+      dst[op] = dst[op - offset];
+  }
+  return op;
+}
+
+// Appends one container sub-message: a v1 header whose length field
+// prefixes the payload (container.h on the Zynq side)
+static void appendSubMessage(QByteArray *container, quint8 msgType,
+                             quint8 sequence, const QByteArray &payload) {
+  uchar header[kHeaderSize];
+  wire_v1_encode(header, msgType, sequence,
+                 static_cast<quint16>(payload.size()));
+  container->append(reinterpret_cast<const char *>(header), kHeaderSize);
+  container->append(payload);
+}
+
+// Keepalive tuning (matching keepalive.h on the Zynq side)
+static const qint64 kKeepaliveIdleMs = 5000; // Silence before the first probe
+static const int kKeepaliveProbes = 3;       // Unanswered probes before timeout
+static const qint64 kInitialRtoMs = 1000;    // Until an RTT has been measured
+static const qint64 kMinRtoMs = 200;
+static const qint64 kMaxRtoMs = 5000;
+static const QByteArray kAckPrefix("ACK ");
+
+// Batch operations: text mnemonic, opcode and operand count (batch.h)
+struct BatchOp {
+  const char *mnemonic;
+  quint8 opcode;
+  int operands;
+};
+static const BatchOp kBatchOps[] = {
+    {"R", 0x01, 1}, // R addr
+    {"W", 0x02, 2}, // W addr value
+    {"M", 0x03, 3}, // M addr mask value
+    {"P", 0x04, 4}, // P addr mask value timeout_us
+    {"D", 0x05, 1}, // D delay_us
+};
+static const char *const kBatchStatus[] = {
+    "ok", "truncated", "bad opcode", "address not allowed", "poll timeout",
+    "busy budget exceeded"};
+
+// Encodes "R 0x43c00000; W 0x43c00004 1; ..." into the binary batch format
+static bool encodeBatch(const QString &script, QByteArray *ops,
+                        QStringList *steps, QString *error) {
+  const QStringList lines = script.split(';', Qt::SkipEmptyParts);
+  for (const QString &line : lines) {
+    const QStringList words = line.simplified().split(' ', Qt::SkipEmptyParts);
+    if (words.isEmpty())
+      continue;
+
+    const BatchOp *op = nullptr;
+    for (const BatchOp &candidate : kBatchOps) {
+      if (words.at(0).toUpper() == candidate.mnemonic)
+        op = &candidate;
+    }
+    if (op == nullptr || words.size() != 1 + op->operands) {
+      *error = QString("bad batch step \"%1\"").arg(line.trimmed());
+      return false;
+    }
+
+    ops->append(static_cast<char>(op->opcode));
+    for (int i = 1; i <= op->operands; i++) {
+      bool ok = false;
+      quint32 value = words.at(i).toUInt(&ok, 0);
+      if (!ok) {
+        *error = QString("bad number \"%1\"").arg(words.at(i));
+        return false;
+      }
+      quint32 le = qToLittleEndian(value);
+      ops->append(reinterpret_cast<const char *>(&le), sizeof(le));
+    }
+    steps->append(words.join(" "));
+  }
+
+  if (ops->size() > kMaxData) {
+    *error = QString("batch is %1 bytes, at most %2 fit")
+                 .arg(ops->size())
+                 .arg(kMaxData);
+    return false;
+  }
+  return true;
+}
+
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), udpSocket(nullptr), heartbeatTimer(nullptr),
+    : QMainWindow(parent), udpSocket(nullptr), keepaliveTimer(nullptr),
+      rchanTimer(nullptr),
       packetsReceived(0), packetsSent(0), bytesReceived(0), bytesSent(0),
-      sequenceNumber(0), connected(false), serverPort(8888) {
+      sequenceNumber(0), connected(false), serverPort(8888), lastReceivedMs(0),
+      probeSentMs(0), probeSequence(0), probesOutstanding(0),
+      boardResponding(true), srttMs(0), rttvarMs(0), rttSamples(0),
+      crcFailures(0), fragmentMessageId(0), fragmentedSent(0),
+      fragmentsReassembled(0), fragmentsDropped(0), fecRecovered(0),
+      fecUnrecoverable(0), blobCrc(0),
+      rchan(
+          [this](quint8 msgType, const QByteArray &payload) {
+            return sendMessage(msgType, 0, payload, false);
+          },
+          [this](quint8 service, const QByteArray &data, qint64 elapsedUs) {
+            deliverTransfer(service, data, elapsedUs);
+          },
+          [this](quint8 service, int bytes, qint64 elapsedUs, bool ok) {
+            transferDone(service, bytes, elapsedUs, ok);
+          }),
+      creditMessages(0), creditBytes(0), creditLimitMessages(0),
+      creditLimitBytes(0), creditProbes(0) {
+  memset(txStreamSequence, 0, sizeof(txStreamSequence));
   setupUI();
 
   // Initialize UDP socket
@@ -30,10 +214,18 @@ MainWindow::MainWindow(QWidget *parent)
   connect(udpSocket, &QUdpSocket::readyRead, this,
           &MainWindow::readPendingDatagrams);
 
-  // Initialize heartbeat timer
-  heartbeatTimer = new QTimer(this);
-  heartbeatTimer->setInterval(5000); // 5 seconds
-  connect(heartbeatTimer, &QTimer::timeout, this, &MainWindow::sendHeartbeat);
+  // Keepalive check: heartbeats are only sent once the link goes quiet
+  clock.start();
+  keepaliveTimer = new QTimer(this);
+  keepaliveTimer->setInterval(250);
+  connect(keepaliveTimer, &QTimer::timeout, this,
+          &MainWindow::updateConnectionStatus);
+
+  // Finer than the keepalive check: RTOs on a LAN are a few milliseconds
+  rchanTimer = new QTimer(this);
+  rchanTimer->setInterval(5);
+  connect(rchanTimer, &QTimer::timeout, this,
+          &MainWindow::pollReliableChannel);
 
   // Set default server IP
   serverIpEdit->setText("192.168.1.10");
@@ -82,8 +274,42 @@ void MainWindow::setupUI() {
           &MainWindow::disconnectFromServer);
   connectionLayout->addWidget(disconnectButton, 0, 5);
 
+  // v2 adds 32-bit per-stream sequences and send timestamps; the board
+  // answers in whichever version it last received
+  protocolV2Check = new QCheckBox("Protocol v2", this);
+  protocolV2Check->setChecked(true);
+  connectionLayout->addWidget(protocolV2Check, 0, 6);
+
+  // Asks the board for containers and packs pipelined commands the same way
+  packCheck = new QCheckBox("Pack", this);
+  connect(packCheck, &QCheckBox::toggled, this, &MainWindow::setPacking);
+  connectionLayout->addWidget(packCheck, 0, 7);
+
+  // v2 only: a CRC32C trailer on everything sent; the board adds one to its
+  // replies in turn
+  crcCheck = new QCheckBox("CRC32C", this);
+  connect(crcCheck, &QCheckBox::toggled, this, &MainWindow::benchmarkCrc);
+  connectionLayout->addWidget(crcCheck, 0, 8);
+
+  // v2 only: the board compresses text it sends whenever that saves bytes
+  lz4Check = new QCheckBox("LZ4", this);
+  connect(lz4Check, &QCheckBox::toggled, this, &MainWindow::setCompression);
+  connectionLayout->addWidget(lz4Check, 0, 9);
+
+  // Parity after every group of streaming messages; lost ones are rebuilt
+  // here instead of being resent
+  fecCheck = new QCheckBox("FEC", this);
+  connect(fecCheck, &QCheckBox::toggled, this, &MainWindow::setFec);
+  connectionLayout->addWidget(fecCheck, 0, 10);
+
+  // The board streams only as much as it has been granted, so a busy GUI
+  // thread holds it back instead of losing datagrams in the kernel
+  creditCheck = new QCheckBox("Credit", this);
+  connect(creditCheck, &QCheckBox::toggled, this, &MainWindow::setCredit);
+  connectionLayout->addWidget(creditCheck, 0, 11);
+
   statusLabel = new QLabel("Status: Disconnected", this);
-  connectionLayout->addWidget(statusLabel, 1, 0, 1, 6);
+  connectionLayout->addWidget(statusLabel, 1, 0, 1, 12);
 
   mainLayout->addWidget(connectionGroup);
 
@@ -135,6 +361,38 @@ void MainWindow::setupUI() {
   bytesSentLabel = new QLabel("0", this);
   statsLayout->addWidget(bytesSentLabel, 1, 3);
 
+  statsLayout->addWidget(new QLabel("RTT:"), 2, 0);
+  rttLabel = new QLabel("-", this);
+  statsLayout->addWidget(rttLabel, 2, 1);
+
+  statsLayout->addWidget(new QLabel("Commands Pending:"), 2, 2);
+  pendingLabel = new QLabel("0", this);
+  statsLayout->addWidget(pendingLabel, 2, 3);
+
+  statsLayout->addWidget(new QLabel("v2 Loss:"), 3, 0);
+  lossLabel = new QLabel("-", this);
+  statsLayout->addWidget(lossLabel, 3, 1, 1, 3);
+
+  statsLayout->addWidget(new QLabel("Status Frames:"), 4, 0);
+  frameLabel = new QLabel("-", this);
+  statsLayout->addWidget(frameLabel, 4, 1, 1, 3);
+
+  statsLayout->addWidget(new QLabel("Fragmented:"), 5, 0);
+  fragmentLabel = new QLabel("-", this);
+  statsLayout->addWidget(fragmentLabel, 5, 1, 1, 3);
+
+  statsLayout->addWidget(new QLabel("FEC:"), 6, 0);
+  fecLabel = new QLabel("-", this);
+  statsLayout->addWidget(fecLabel, 6, 1, 1, 3);
+
+  statsLayout->addWidget(new QLabel("Reliable:"), 7, 0);
+  rchanLabel = new QLabel("-", this);
+  statsLayout->addWidget(rchanLabel, 7, 1, 1, 3);
+
+  statsLayout->addWidget(new QLabel("Credit:"), 8, 0);
+  creditLabel = new QLabel("-", this);
+  statsLayout->addWidget(creditLabel, 8, 1, 1, 3);
+
   // Chat / Last Message Display
   QGroupBox *chatGroup = new QGroupBox("Last Message Received", this);
   QVBoxLayout *chatLayout = new QVBoxLayout(chatGroup);
@@ -196,17 +454,38 @@ void MainWindow::connectToServer() {
                  .arg(serverAddress.toString())
                  .arg(serverPort));
 
-  // Send initial heartbeat
+  // Send initial heartbeat, which also measures the first RTT
+  lastReceivedMs = clock.elapsed();
+  probesOutstanding = 0;
+  boardResponding = true;
+  pendingCommands.clear();
+  pendingBatches.clear();
+  pendingLabel->setText("0");
+  rxStreams.clear();
+  frameStreams.clear();
+  reassemblies.clear();
+  fecGroups.clear();
+  rchan.reset();
+  memset(txStreamSequence, 0, sizeof(txStreamSequence));
   sendHeartbeat();
-
-  // Start heartbeat timer
-  heartbeatTimer->start();
+  if (packCheck->isChecked())
+    setPacking(true);
+  if (lz4Check->isChecked())
+    setCompression(true);
+  if (fecCheck->isChecked())
+    setFec(true);
+  if (creditCheck->isChecked())
+    setCredit(true);
+
+  // Start keepalive checks
+  keepaliveTimer->start();
 }
 
 void MainWindow::disconnectFromServer() {
-  if (heartbeatTimer->isActive()) {
-    heartbeatTimer->stop();
+  if (keepaliveTimer->isActive()) {
+    keepaliveTimer->stop();
   }
+  rchanTimer->stop();
 
   connected = false;
   connectButton->setEnabled(true);
@@ -232,24 +511,8 @@ void MainWindow::sendData() {
     return;
   }
 
-  DataMessage msg;
-  msg.msgType = MSG_TYPE_DATA;
-  msg.sequence = static_cast<quint8>(sequenceNumber++);
-
-  QByteArray dataBytes = dataString.toUtf8();
-  msg.length = static_cast<quint16>(qMin(dataBytes.size(), 1020));
-  memcpy(msg.data, dataBytes.constData(), msg.length);
-
-  QByteArray packet(reinterpret_cast<const char *>(&msg), sizeof(msg));
-
-  qint64 bytesWritten =
-      udpSocket->writeDatagram(packet, serverAddress, serverPort);
-  if (bytesWritten == packet.size()) {
-    packetsSent++;
-    bytesSent += static_cast<int>(bytesWritten);
-    packetsSentLabel->setText(QString::number(packetsSent));
-    bytesSentLabel->setText(QString::number(bytesSent));
-
+  quint8 sequence = static_cast<quint8>(sequenceNumber++);
+  if (sendMessage(MSG_TYPE_DATA, sequence, dataString.toUtf8(), true)) {
     logMessage(QString("Sent data: %1").arg(dataString));
     dataLineEdit->clear();
   } else {
@@ -267,55 +530,261 @@ void MainWindow::sendCommand() {
     return;
   }
 
-  DataMessage msg;
-  msg.msgType = MSG_TYPE_COMMAND;
-  msg.sequence = static_cast<quint8>(sequenceNumber++);
+  // "BATCH <step>; <step>" runs on the board as one binary script
+  if (commandString.startsWith("BATCH ", Qt::CaseInsensitive)) {
+    if (sendBatch(commandString.mid(6)))
+      dataLineEdit->clear();
+    return;
+  }
 
-  QByteArray dataBytes = commandString.toUtf8();
-  msg.length = static_cast<quint16>(qMin(dataBytes.size(), 1020));
-  memcpy(msg.data, dataBytes.constData(), msg.length);
+  // "BLOB UPLOAD <bytes>" sends a test blob over the reliable channel
+  if (commandString.startsWith("BLOB UPLOAD", Qt::CaseInsensitive)) {
+    if (sendBlob(commandString.mid(11).trimmed().toInt()))
+      dataLineEdit->clear();
+    return;
+  }
 
-  QByteArray packet(reinterpret_cast<const char *>(&msg), sizeof(msg));
+  // The board's window only covers what it sends; match it for uploads
+  if (commandString.startsWith("RCHAN WINDOW ", Qt::CaseInsensitive))
+    rchan.setWindow(commandString.mid(13).trimmed().toInt());
 
-  qint64 bytesWritten =
-      udpSocket->writeDatagram(packet, serverAddress, serverPort);
-  if (bytesWritten == packet.size()) {
-    packetsSent++;
-    bytesSent += static_cast<int>(bytesWritten);
-    packetsSentLabel->setText(QString::number(packetsSent));
-    bytesSentLabel->setText(QString::number(bytesSent));
+  // "A; B; C" pipelines several commands without waiting for replies
+  const QStringList commands = commandString.split(';', Qt::SkipEmptyParts);
+  if (packCheck->isChecked() && commands.size() > 1) {
+    if (sendCommandsPacked(commands))
+      dataLineEdit->clear();
+    return;
+  }
+  for (const QString &command : commands) {
+    if (!command.trimmed().isEmpty() && !sendCommandMessage(command.trimmed()))
+      return;
+  }
+  dataLineEdit->clear();
+}
 
-    logMessage(QString("Sent command: %1").arg(commandString));
-    dataLineEdit->clear();
-  } else {
+bool MainWindow::sendCommandMessage(const QString &commandString) {
+  quint8 sequence = static_cast<quint8>(sequenceNumber++);
+  if (!sendMessage(MSG_TYPE_COMMAND, sequence, commandString.toUtf8(),
+                   true)) {
     logMessage("Failed to send command");
+    return false;
+  }
+
+  pendingCommands.insert(sequence, clock.elapsed());
+  pendingLabel->setText(QString::number(pendingCommands.size()));
+  logMessage(
+      QString("Sent command #%1: %2").arg(sequence).arg(commandString));
+  return true;
+}
+
+bool MainWindow::sendCommandsPacked(const QStringList &commands) {
+  QByteArray container;
+  int packed = 0;
+  for (const QString &command : commands) {
+    QByteArray text = command.trimmed().toUtf8().left(255);
+    if (text.isEmpty())
+      continue;
+
+    // A full container goes out before the next command starts a new one
+    if (container.size() + kHeaderSize + text.size() > kMaxData) {
+      if (!sendMessage(MSG_TYPE_CONTAINER,
+                       static_cast<quint8>(sequenceNumber++), container,
+                       false)) {
+        logMessage("Failed to send container");
+        return false;
+      }
+      container.clear();
+    }
+
+    quint8 sequence = static_cast<quint8>(sequenceNumber++);
+    appendSubMessage(&container, MSG_TYPE_COMMAND, sequence, text);
+    pendingCommands.insert(sequence, clock.elapsed());
+    logMessage(QString("Packed command #%1: %2")
+                   .arg(sequence)
+                   .arg(QString::fromUtf8(text)));
+    packed++;
+  }
+
+  if (!container.isEmpty() &&
+      !sendMessage(MSG_TYPE_CONTAINER, static_cast<quint8>(sequenceNumber++),
+                   container, false)) {
+    logMessage("Failed to send container");
+    return false;
+  }
+  pendingLabel->setText(QString::number(pendingCommands.size()));
+  logMessage(QString("Sent %1 commands packed").arg(packed));
+  return true;
+}
+
+void MainWindow::benchmarkCrc(bool enabled) {
+  if (!enabled)
+    return;
+
+  // Cost of the trailer on this machine, over 16 MB in 64 KB buffers
+  QByteArray buffer(64 * 1024, '\x5a');
+  volatile quint32 crc = 0; // Keeps the loop from being optimised away
+  QElapsedTimer timer;
+  timer.start();
+  for (int i = 0; i < 256; i++)
+    crc = crc32c(crc, buffer.constData(), buffer.size());
+  double nsPerKb = timer.nsecsElapsed() / (256.0 * 64);
+  logMessage(QString("CRC32C using %1: %2 ns per KB (check 0x%3)")
+                 .arg(crc32cImplementation())
+                 .arg(nsPerKb, 0, 'f', 1)
+                 .arg(crc32c(0, "123456789", 9), 8, 16, QChar('0')));
+}
+
+void MainWindow::setCompression(bool enabled) {
+  if (connected)
+    sendCommandMessage(enabled ? "PROTO LZ4 ON" : "PROTO LZ4 OFF");
+}
+
+void MainWindow::setFec(bool enabled) {
+  if (connected)
+    sendCommandMessage(enabled ? "FEC ON" : "FEC OFF");
+}
+
+void MainWindow::setCredit(bool enabled) {
+  if (!connected)
+    return;
+  if (enabled) {
+    udpSocket->setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption,
+                               kCreditSocketBuffer);
+    sendCreditGrant(true);
+  } else {
+    sendCommandMessage("CREDIT OFF");
+    creditLabel->setText("-");
   }
 }
 
+void MainWindow::setPacking(bool enabled) {
+  if (connected)
+    sendCommandMessage(enabled ? "PACK ON" : "PACK OFF");
+}
+
+bool MainWindow::sendBatch(const QString &script) {
+  QByteArray ops;
+  QStringList steps;
+  QString error;
+  if (!encodeBatch(script, &ops, &steps, &error) || ops.isEmpty()) {
+    logMessage(QString("Batch not sent: %1")
+                   .arg(error.isEmpty() ? QString("no steps") : error));
+    return false;
+  }
+
+  quint8 sequence = static_cast<quint8>(sequenceNumber++);
+  if (!sendMessage(MSG_TYPE_BATCH, sequence, ops, false)) {
+    logMessage("Failed to send batch");
+    return false;
+  }
+
+  pendingBatches.insert(sequence, steps);
+  pendingCommands.insert(sequence, clock.elapsed());
+  pendingLabel->setText(QString::number(pendingCommands.size()));
+  logMessage(QString("Sent batch #%1: %2 steps in %3 bytes")
+                 .arg(sequence)
+                 .arg(steps.size())
+                 .arg(ops.size()));
+  return true;
+}
+
 void MainWindow::sendHeartbeat() {
   if (!connected)
     return;
 
-  DataMessage msg;
-  msg.msgType = MSG_TYPE_HEARTBEAT;
-  msg.sequence = static_cast<quint8>(sequenceNumber++);
+  quint8 sequence = static_cast<quint8>(sequenceNumber++);
+  QString heartbeatData = QString("Heartbeat from Qt client %1").arg(sequence);
 
-  QString heartbeatData =
-      QString("Heartbeat from Qt client %1").arg(msg.sequence);
-  QByteArray dataBytes = heartbeatData.toUtf8();
-  msg.length = static_cast<quint16>(qMin(dataBytes.size(), 1020));
-  memcpy(msg.data, dataBytes.constData(), msg.length);
+  // Heartbeats carry only their text, not a full 1 KB frame
+  sendMessage(MSG_TYPE_HEARTBEAT, sequence, heartbeatData.toUtf8(), false);
 
-  QByteArray packet(reinterpret_cast<const char *>(&msg), sizeof(msg));
+  // The board echoes the probe; the answer times the round trip
+  probeSequence = sequence;
+  probeSentMs = clock.elapsed();
+  probesOutstanding++;
 
-  udpSocket->writeDatagram(packet, serverAddress, serverPort);
+  logMessage(QString("Sent heartbeat #%1").arg(sequence));
+}
 
+bool MainWindow::sendMessage(quint8 msgType, quint8 sequence,
+                             const QByteArray &payload, bool fullFrame) {
+  if (payload.size() > kMaxData)
+    return sendFragmented(msgType, sequence, payload);
+
+  int length = payload.size();
+  QByteArray packet;
+
+  if (protocolV2Check->isChecked()) {
+    // v2 is always trimmed to its payload
+    wire_v2_header_t hdr;
+    hdr.version = WIRE_V2_VERSION;
+    hdr.msg_type = msgType;
+    hdr.flags = crcCheck->isChecked() ? WIRE_FLAG_CRC : 0;
+    hdr.tag = sequence;
+    hdr.sequence = txStreamSequence[msgType % kV2Streams];
+    hdr.timestamp = static_cast<quint64>(clock.nsecsElapsed() / 1000);
+    hdr.stream_id = msgType;
+    hdr.length = static_cast<quint16>(length);
+    packet.resize(WIRE_V2_HEADER_SIZE);
+    wire_v2_encode(reinterpret_cast<uchar *>(packet.data()), &hdr);
+    packet.append(payload.constData(), length);
+    if (crcCheck->isChecked()) {
+      uchar trailer[WIRE_CRC_SIZE];
+      wire_put_u32(trailer, crc32c(0, packet.constData(), packet.size()));
+      packet.append(reinterpret_cast<const char *>(trailer), WIRE_CRC_SIZE);
+    }
+  } else {
+    // Older boards want everything but heartbeats as a full frame
+    packet.resize(kHeaderSize);
+    wire_v1_encode(reinterpret_cast<uchar *>(packet.data()), msgType,
+                   sequence, static_cast<quint16>(length));
+    packet.append(payload.constData(), length);
+    if (fullFrame)
+      packet.append(QByteArray(WIRE_V1_MAX_SIZE - packet.size(), '\0'));
+  }
+
+  qint64 bytesWritten =
+      udpSocket->writeDatagram(packet, serverAddress, serverPort);
+  if (bytesWritten != packet.size())
+    return false;
+
+  if (protocolV2Check->isChecked())
+    txStreamSequence[msgType % kV2Streams]++;
   packetsSent++;
-  bytesSent += static_cast<int>(packet.size());
+  bytesSent += static_cast<int>(bytesWritten);
   packetsSentLabel->setText(QString::number(packetsSent));
   bytesSentLabel->setText(QString::number(bytesSent));
+  return true;
+}
 
-  logMessage(QString("Sent heartbeat #%1").arg(msg.sequence));
+bool MainWindow::sendFragmented(quint8 msgType, quint8 sequence,
+                                const QByteArray &payload) {
+  if (payload.size() > kFragmentMaxMessage) {
+    logMessage(QString("Message of %1 bytes exceeds the %2 byte limit")
+                   .arg(payload.size())
+                   .arg(kFragmentMaxMessage));
+    return false;
+  }
+
+  // Every fragment carries the message's sequence, so replies match up
+  int count = (payload.size() + kFragmentPayload - 1) / kFragmentPayload;
+  char header[kFragmentHeaderSize];
+  qToLittleEndian(fragmentMessageId++, header);
+  qToLittleEndian(static_cast<quint16>(count), header + 4);
+  header[6] = static_cast<char>(msgType);
+  header[7] = 0;
+  qToLittleEndian(static_cast<quint32>(payload.size()), header + 8);
+  qToLittleEndian(crc32c(0, payload.constData(), payload.size()), header + 12);
+  for (int index = 0; index < count; index++) {
+    qToLittleEndian(static_cast<quint16>(index), header + 2);
+    QByteArray fragment(header, kFragmentHeaderSize);
+    fragment.append(payload.mid(index * kFragmentPayload, kFragmentPayload));
+    if (!sendMessage(MSG_TYPE_FRAGMENT, sequence, fragment, false))
+      return false;
+  }
+  fragmentedSent++;
+  updateFragmentLabel();
+  return true;
 }
 
 void MainWindow::readPendingDatagrams() {
@@ -324,23 +793,183 @@ void MainWindow::readPendingDatagrams() {
     processReceivedData(datagram.data(), datagram.senderAddress(),
                         datagram.senderPort());
   }
+
+  // Everything pending has been read: grant the room that made
+  if (connected && creditCheck->isChecked() &&
+      creditMessages + kCreditWindowMessages - creditLimitMessages >=
+          kCreditWindowMessages / 4)
+    sendCreditGrant(false);
+}
+
+void MainWindow::sendHeartbeatAck(quint8 sequence,
+                                  const QByteArray &probeText) {
+  sendMessage(MSG_TYPE_HEARTBEAT, sequence, kAckPrefix + probeText, false);
+}
+
+void MainWindow::addRttSample(qint64 rttMs) {
+  // Smoothed RTT and variation as in RFC 6298
+  if (rttSamples == 0) {
+    srttMs = rttMs;
+    rttvarMs = rttMs / 2.0;
+  } else {
+    rttvarMs = 0.75 * rttvarMs + 0.25 * qAbs(srttMs - rttMs);
+    srttMs = 0.875 * srttMs + 0.125 * rttMs;
+  }
+  rttSamples++;
+  rttLabel->setText(QString("%1 ms (timeout %2 ms)")
+                        .arg(srttMs, 0, 'f', 1)
+                        .arg(kKeepaliveIdleMs +
+                             kKeepaliveProbes * retransmitTimeoutMs()));
+}
+
+qint64 MainWindow::retransmitTimeoutMs() const {
+  if (rttSamples == 0) {
+    return kInitialRtoMs;
+  }
+  qint64 rto = static_cast<qint64>(srttMs + 4 * rttvarMs);
+  return qBound(kMinRtoMs, rto, kMaxRtoMs);
 }
 
 void MainWindow::processReceivedData(const QByteArray &data,
                                      const QHostAddress &sender, quint16 port) {
-  if (data.size() < static_cast<int>(sizeof(DataMessage))) {
-    logMessage("Received packet too small");
-    return;
+  // Both framings are decoded in place; only LZ4 data needs a buffer
+  const uchar *raw = reinterpret_cast<const uchar *>(data.constData());
+  char unpacked[kMaxData];
+  DataMessage storage;
+  const DataMessage *msg = &storage;
+  if (wire_is_v2(raw, data.size())) {
+    wire_v2_view_t v2;
+    if (wire_v2_decode(raw, data.size(), &v2) != WIRE_OK) {
+      logMessage("Received v2 packet with invalid length");
+      return;
+    }
+    if (v2.crc != nullptr &&
+        crc32c(0, raw, WIRE_V2_HEADER_SIZE + v2.hdr.length) !=
+            wire_get_u32(v2.crc)) {
+      crcFailures++;
+      logMessage(QString("Dropped v2 packet with bad CRC32C (%1 so far)")
+                     .arg(crcFailures));
+      return;
+    }
+    storage.msgType = v2.hdr.msg_type;
+    storage.sequence = v2.hdr.tag;
+    storage.length = v2.hdr.length;
+    storage.data = reinterpret_cast<const char *>(v2.data);
+    if (v2.hdr.flags & WIRE_FLAG_LZ4) {
+      int length = lz4Decompress(v2.data, v2.hdr.length, unpacked, kMaxData);
+      if (length < 0) {
+        logMessage("Dropped v2 packet with a malformed LZ4 block");
+        return;
+      }
+      storage.length = static_cast<quint16>(length);
+      storage.data = unpacked;
+    }
+    trackV2Stream(v2.hdr.stream_id, v2.hdr.sequence, v2.hdr.timestamp);
+  } else {
+    // Heartbeats arrive trimmed to their text; everything needs a header
+    wire_v1_view_t v1;
+    wire_status_t status = wire_v1_decode(raw, data.size(), &v1);
+    if (status != WIRE_OK) {
+      logMessage(status == WIRE_ERR_SHORT
+                     ? "Received packet too small"
+                     : "Received packet with invalid length");
+      return;
+    }
+    storage.msgType = v1.msg_type;
+    storage.sequence = v1.sequence;
+    storage.length = v1.length;
+    storage.data = reinterpret_cast<const char *>(v1.data);
   }
 
-  const DataMessage *msg =
-      reinterpret_cast<const DataMessage *>(data.constData());
+  // Any datagram from the board proves it is alive
+  qint64 now = clock.elapsed();
+  lastReceivedMs = now;
+  if (!boardResponding) {
+    boardResponding = true;
+    logMessage("Board responding again");
+  }
 
+  countCredit(msg);
   packetsReceived++;
   bytesReceived += data.size();
   packetsReceivedLabel->setText(QString::number(packetsReceived));
   bytesReceivedLabel->setText(QString::number(bytesReceived));
 
+  if (msg->msgType != MSG_TYPE_CONTAINER) {
+    processMessage(msg, sender, port, now);
+  } else {
+    // Each sub-message is handled as if it had arrived on its own
+    const uchar *packed = reinterpret_cast<const uchar *>(msg->data);
+    int offset = 0;
+    while (offset + kHeaderSize <= msg->length) {
+      wire_v1_view_t v1;
+      if (wire_v1_decode(packed + offset, msg->length - offset, &v1) !=
+              WIRE_OK ||
+          v1.msg_type == MSG_TYPE_CONTAINER) {
+        logMessage("Received malformed container");
+        break;
+      }
+      DataMessage sub = {v1.msg_type, v1.sequence, v1.length,
+                         reinterpret_cast<const char *>(v1.data)};
+      processMessage(&sub, sender, port, now);
+      offset += kHeaderSize + sub.length;
+    }
+  }
+  probesOutstanding = 0;
+}
+
+void MainWindow::processMessage(const DataMessage *msg,
+                                const QHostAddress &sender, quint16 port,
+                                qint64 now) {
+  if (msg->msgType == MSG_TYPE_FRAGMENT) {
+    processFragment(msg, sender, port, now);
+    return;
+  }
+  if (msg->msgType == MSG_TYPE_FEC) {
+    processFec(msg, sender, port, now);
+    return;
+  }
+  if (msg->msgType == MSG_TYPE_RCHAN_DATA ||
+      msg->msgType == MSG_TYPE_RCHAN_SACK) {
+    rchan.receive(msg->msgType, QByteArray(msg->data, msg->length),
+                  clock.nsecsElapsed() / 1000);
+    return;
+  }
+  if (msg->msgType == MSG_TYPE_CREDIT) {
+    processCreditProbe(msg);
+    return;
+  }
+
+  if (msg->msgType == MSG_TYPE_HEARTBEAT) {
+    QByteArray text(msg->data, msg->length);
+    if (text.startsWith(kAckPrefix)) {
+      // Only the outstanding probe gives an unambiguous sample
+      if (probesOutstanding > 0 && msg->sequence == probeSequence) {
+        addRttSample(now - probeSentMs);
+      }
+    } else {
+      sendHeartbeatAck(msg->sequence, text);
+    }
+  } else if ((msg->msgType == MSG_TYPE_RESPONSE ||
+              msg->msgType == MSG_TYPE_BATCH_RESULT) &&
+             pendingCommands.contains(msg->sequence)) {
+    addRttSample(now - pendingCommands.take(msg->sequence));
+    pendingLabel->setText(QString::number(pendingCommands.size()));
+  }
+
+  if (msg->msgType == MSG_TYPE_ACK_RANGE) {
+    processAckRanges(msg);
+    return;
+  }
+  if (msg->msgType == MSG_TYPE_BATCH_RESULT) {
+    processBatchResult(msg);
+    return;
+  }
+  if (msg->msgType == MSG_TYPE_STATUS_FRAME) {
+    processStatusFrame(msg);
+    return;
+  }
+
   QString messageType;
   switch (msg->msgType) {
   case MSG_TYPE_DATA:
@@ -376,9 +1005,611 @@ void MainWindow::processReceivedData(const QByteArray &data,
                  .arg(receivedData));
 }
 
+void MainWindow::trackV2Stream(quint16 streamId, quint32 sequence,
+                               quint64 timestampUs) {
+  RxStream &stream = rxStreams[streamId];
+  if (stream.received == 0 && stream.duplicates == 0) {
+    stream.highest = sequence;
+    stream.window = 1;
+  } else {
+    quint32 ahead = sequence - stream.highest;
+    if (ahead != 0 && ahead < 0x80000000u) {
+      // Newer than anything seen: skipped sequences count as lost for now
+      stream.lost += ahead - 1;
+      stream.window = ahead >= 32 ? 1 : (stream.window << ahead) | 1;
+      stream.highest = sequence;
+    } else {
+      // Late: fills a gap unless it was already seen
+      quint32 behind = stream.highest - sequence;
+      if (behind < 32 && ((stream.window >> behind) & 1)) {
+        stream.duplicates++;
+        return;
+      }
+      if (behind < 32)
+        stream.window |= 1u << behind;
+      stream.reordered++;
+      if (stream.lost > 0)
+        stream.lost--;
+    }
+  }
+
+  // RFC 3550 interarrival jitter; only the clock rates need to agree
+  qint64 transitUs = clock.nsecsElapsed() / 1000 -
+                     static_cast<qint64>(timestampUs);
+  if (stream.received > 0) {
+    qint64 d = qAbs(transitUs - stream.lastTransitUs);
+    stream.jitterUs += (d - stream.jitterUs) / 16.0;
+  }
+  stream.lastTransitUs = transitUs;
+  stream.received++;
+
+  quint32 received = 0, lost = 0, reordered = 0;
+  double jitterUs = 0;
+  for (auto it = rxStreams.begin(); it != rxStreams.end(); ++it) {
+    received += it.value().received;
+    lost += it.value().lost;
+    reordered += it.value().reordered;
+    jitterUs = qMax(jitterUs, it.value().jitterUs);
+  }
+  lossLabel->setText(QString("%1 lost / %2, %3 reordered, jitter %4 us")
+                         .arg(lost)
+                         .arg(received + lost)
+                         .arg(reordered)
+                         .arg(jitterUs, 0, 'f', 0));
+}
+
+void MainWindow::processFragment(const DataMessage *msg,
+                                 const QHostAddress &sender, quint16 port,
+                                 qint64 now) {
+  const uchar *data = reinterpret_cast<const uchar *>(msg->data);
+  if (msg->length < kFragmentHeaderSize) {
+    fragmentsDropped++;
+    return;
+  }
+  quint16 id = qFromLittleEndian<quint16>(data);
+  int index = qFromLittleEndian<quint16>(data + 2);
+  int count = qFromLittleEndian<quint16>(data + 4);
+  quint8 msgType = data[6];
+  quint32 total = qFromLittleEndian<quint32>(data + 8);
+  int length = msg->length - kFragmentHeaderSize;
+  qint64 offset = static_cast<qint64>(index) * kFragmentPayload;
+  if (total > static_cast<quint32>(kFragmentMaxMessage) ||
+      count != static_cast<int>((total + kFragmentPayload - 1) /
+                                kFragmentPayload) ||
+      index >= count ||
+      length != qMin<qint64>(kFragmentPayload, total - offset) ||
+      msgType == MSG_TYPE_FRAGMENT) {
+    logMessage("Received malformed fragment");
+    fragmentsDropped++;
+    return;
+  }
+
+  // Each message is collected in a buffer of its final size
+  auto it = reassemblies.find(id);
+  if (it == reassemblies.end()) {
+    int inProgress = 0;
+    for (const Reassembly &r : std::as_const(reassemblies))
+      inProgress += r.complete ? 0 : 1;
+    if (inProgress >= kFragmentSlots) {
+      fragmentsDropped++;
+      return;
+    }
+    Reassembly r;
+    r.data.resize(static_cast<int>(total));
+    r.received.fill(false, count);
+    r.msgType = msgType;
+    r.sequence = msg->sequence;
+    r.crc = qFromLittleEndian<quint32>(data + 12);
+    it = reassemblies.insert(id, r);
+  }
+  Reassembly &r = it.value();
+  r.lastProgressMs = now;
+  if (r.complete)
+    return; // Late duplicate of a delivered message
+  if (r.data.size() != static_cast<int>(total) || r.msgType != msgType) {
+    logMessage("Received fragment inconsistent with its message");
+    fragmentsDropped++;
+    return;
+  }
+  if (r.received.at(index))
+    return; // Duplicate
+  r.received[index] = true;
+  memcpy(r.data.data() + offset, data + kFragmentHeaderSize, length);
+  if (++r.arrived < count)
+    return;
+
+  // Complete: kept a while as a marker, so late duplicates are ignored
+  r.complete = true;
+  QByteArray whole = r.data;
+  r.data.clear();
+  if (crc32c(0, whole.constData(), whole.size()) != r.crc) {
+    logMessage(QString("Dropped fragmented message %1 with bad CRC32C")
+                   .arg(id));
+    fragmentsDropped++;
+    updateFragmentLabel();
+    return;
+  }
+  fragmentsReassembled++;
+  updateFragmentLabel();
+
+  // Whatever fits one message is handled as if it had arrived whole
+  if (whole.size() <= kMaxData) {
+    DataMessage single = {r.msgType, r.sequence,
+                          static_cast<quint16>(whole.size()),
+                          whole.constData()};
+    processMessage(&single, sender, port, now);
+    return;
+  }
+
+  if (r.msgType == MSG_TYPE_RESPONSE && pendingCommands.contains(r.sequence)) {
+    addRttSample(now - pendingCommands.take(r.sequence));
+    pendingLabel->setText(QString::number(pendingCommands.size()));
+  }
+  QString text = QString::fromUtf8(whole);
+  if (r.msgType == MSG_TYPE_DATA)
+    lastReceivedLabel->setText(text.left(200));
+  logMessage(QString("Received %1 bytes of type %2 in %3 fragments from "
+                     "%4:%5 (Seq:%6) - %7...")
+                 .arg(whole.size())
+                 .arg(r.msgType)
+                 .arg(count)
+                 .arg(sender.toString())
+                 .arg(port)
+                 .arg(r.sequence)
+                 .arg(text.left(200)));
+}
+
+void MainWindow::expireReassemblies(qint64 now) {
+  for (auto it = reassemblies.begin(); it != reassemblies.end();) {
+    if (now - it.value().lastProgressMs < kFragmentTimeoutMs) {
+      ++it;
+      continue;
+    }
+    if (!it.value().complete) {
+      logMessage(QString("Fragmented message %1 timed out with %2 of %3 "
+                         "fragments")
+                     .arg(it.key())
+                     .arg(it.value().arrived)
+                     .arg(it.value().received.size()));
+      fragmentsDropped++;
+    }
+    it = reassemblies.erase(it);
+  }
+  updateFragmentLabel();
+}
+
+void MainWindow::updateFragmentLabel() {
+  fragmentLabel->setText(QString("%1 sent, %2 reassembled, %3 dropped, "
+                                 "%4 in progress")
+                             .arg(fragmentedSent)
+                             .arg(fragmentsReassembled)
+                             .arg(fragmentsDropped)
+                             .arg(reassemblies.size()));
+}
+
+void MainWindow::processFec(const DataMessage *msg, const QHostAddress &sender,
+                            quint16 port, qint64 now) {
+  const uchar *data = reinterpret_cast<const uchar *>(msg->data);
+  if (msg->length < kFecHeaderSize || data[4] < 1 || data[4] > kFecMaxK) {
+    logMessage("Received malformed FEC message");
+    return;
+  }
+  quint16 id = qFromLittleEndian<quint16>(data);
+  int index = data[2];
+  bool parity = data[3] != 0;
+  int k = data[4];
+  QByteArray block(msg->data + kFecHeaderSize, msg->length - kFecHeaderSize);
+
+  FecGroup &group = fecGroups[id];
+  group.lastMs = now;
+  if (group.done)
+    return; // Arrived after the group was complete
+  if (parity) {
+    if (index >= kFecMaxM)
+      return; // No such parity row
+    // Final size of the group: lower than the data's k if the deadline
+    // closed it early
+    group.k = k;
+    group.kFinal = true;
+    group.parity.insert(index, block);
+  } else {
+    if (index >= k || !group.data.value(index).isEmpty())
+      return; // Out of range, or a duplicate
+    if (group.data.size() < k)
+      group.data.resize(k);
+    if (!group.kFinal)
+      group.k = k;
+    group.data[index] = block;
+
+    // Data is used right away; parity only matters if some went missing
+    deliverFecBlock(block, sender, port, now);
+  }
+  recoverFecGroup(&group, sender, port, now);
+}
+
+void MainWindow::recoverFecGroup(FecGroup *group, const QHostAddress &sender,
+                                 quint16 port, qint64 now) {
+  if (group->done || !group->kFinal)
+    return;
+  QVector<QByteArray> data = group->data;
+  data.resize(group->k);
+  int lost = 0;
+  for (const QByteArray &block : data)
+    lost += block.isEmpty() ? 1 : 0;
+  if (lost > 0 && !fecRecover(&data, group->parity))
+    return; // Maybe more parity is on its way
+
+  for (int i = 0; i < group->k; i++) {
+    if (i >= group->data.size() || group->data.at(i).isEmpty())
+      deliverFecBlock(data.at(i), sender, port, now);
+  }
+  fecRecovered += lost;
+  group->done = true;
+  group->data.clear();
+  group->parity.clear();
+  updateFecLabel();
+}
+
+void MainWindow::deliverFecBlock(const QByteArray &block,
+                                 const QHostAddress &sender, quint16 port,
+                                 qint64 now) {
+  // A v1 header and its data; rebuilt blocks carry zero padding after it
+  const uchar *raw = reinterpret_cast<const uchar *>(block.constData());
+  wire_v1_view_t v1;
+  if (wire_v1_decode(raw, block.size(), &v1) != WIRE_OK ||
+      v1.msg_type == MSG_TYPE_FEC) {
+    logMessage("Received malformed message in an FEC group");
+    return;
+  }
+  DataMessage inner = {v1.msg_type, v1.sequence, v1.length,
+                       reinterpret_cast<const char *>(v1.data)};
+  processMessage(&inner, sender, port, now);
+}
+
+void MainWindow::expireFecGroups(qint64 now) {
+  for (auto it = fecGroups.begin(); it != fecGroups.end();) {
+    const FecGroup &group = it.value();
+    if (now - group.lastMs < kFecGroupTimeoutMs) {
+      ++it;
+      continue;
+    }
+
+    // Without parity the group's size is unknown: only gaps below the
+    // highest index that arrived are certain losses
+    if (!group.done) {
+      int size = group.kFinal ? group.k : 0;
+      int arrived = 0;
+      for (int i = 0; i < group.data.size(); i++) {
+        if (!group.data.at(i).isEmpty()) {
+          arrived++;
+          if (!group.kFinal)
+            size = i + 1;
+        }
+      }
+      fecUnrecoverable += qMax(0, size - arrived);
+    }
+    it = fecGroups.erase(it);
+  }
+  updateFecLabel();
+}
+
+void MainWindow::updateFecLabel() {
+  fecLabel->setText(QString("%1 recovered, %2 unrecoverable, %3 groups open")
+                        .arg(fecRecovered)
+                        .arg(fecUnrecoverable)
+                        .arg(fecGroups.size()));
+}
+
+bool MainWindow::sendBlob(int bytes) {
+  if (bytes < 1 || bytes > kBlobMax) {
+    logMessage(QString("BLOB UPLOAD needs 1-%1 bytes").arg(kBlobMax));
+    return false;
+  }
+  if (rchan.busy()) {
+    logMessage("A reliable transfer is already running");
+    return false;
+  }
+
+  // xorshift32 bytes: nothing for LZ4 to shrink, and never all zeroes
+  QByteArray blob(bytes, '\0');
+  quint32 x = static_cast<quint32>(clock.nsecsElapsed()) | 1;
+  for (int i = 0; i < bytes; i++) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    blob[i] = static_cast<char>(x);
+  }
+  blobCrc = crc32c(0, blob.constData(), blob.size());
+  rchan.start(kServiceBlob, blob, clock.nsecsElapsed() / 1000);
+  rchanTimer->start();
+  logMessage(QString("Uploading a %1 byte blob, crc32c 0x%2")
+                 .arg(bytes)
+                 .arg(blobCrc, 8, 16, QChar('0')));
+  return true;
+}
+
+void MainWindow::pollReliableChannel() {
+  rchan.poll(clock.nsecsElapsed() / 1000);
+  if (!rchan.busy())
+    rchanTimer->stop();
+  updateRchanLabel();
+}
+
+void MainWindow::deliverTransfer(quint8 service, const QByteArray &data,
+                                 qint64 elapsedUs) {
+  QString rate = QString::number(
+      elapsedUs > 0 ? data.size() * 8000.0 / elapsedUs : 0.0, 'f', 0);
+  if (service == kServiceBlob) {
+    logMessage(QString("Blob of %1 bytes received in %2 ms (%3 kbit/s), "
+                       "crc32c 0x%4")
+                   .arg(data.size())
+                   .arg(elapsedUs / 1000)
+                   .arg(rate)
+                   .arg(crc32c(0, data.constData(), data.size()), 8, 16,
+                        QChar('0')));
+  } else {
+    logMessage(QString("Transfer of %1 bytes for unknown service %2")
+                   .arg(data.size())
+                   .arg(service));
+  }
+  updateRchanLabel();
+}
+
+void MainWindow::transferDone(quint8 service, int bytes, qint64 elapsedUs,
+                              bool ok) {
+  if (!ok) {
+    logMessage(QString("Upload of %1 bytes abandoned: the board stopped "
+                       "acknowledging")
+                   .arg(bytes));
+    return;
+  }
+  logMessage(QString("Uploaded %1 bytes in %2 ms (%3 kbit/s)")
+                 .arg(bytes)
+                 .arg(elapsedUs / 1000)
+                 .arg(QString::number(
+                     elapsedUs > 0 ? bytes * 8000.0 / elapsedUs : 0.0, 'f',
+                     0)));
+  // The board's BLOB reply carries its CRC of what arrived, to compare
+  if (service == kServiceBlob)
+    sendCommandMessage("BLOB");
+}
+
+void MainWindow::updateRchanLabel() {
+  const ReliableChannel::Stats &s = rchan.stats();
+  rchanLabel->setText(
+      QString("sent %1/%2 (%3 resent), received %4, srtt %5 ms, window %6")
+          .arg(s.txCompleted)
+          .arg(s.txTransfers)
+          .arg(s.txTimeouts + s.txFastResends)
+          .arg(s.rxCompleted)
+          .arg(rchan.srttUs() / 1000.0, 0, 'f', 2)
+          .arg(rchan.window()));
+}
+
+// Counts a datagram the way the board does: everything that left through its
+// send queue, by logical size. Bulk senders with their own pacing are not.
+void MainWindow::countCredit(const DataMessage *msg) {
+  switch (msg->msgType) {
+  case MSG_TYPE_TGEN:
+  case MSG_TYPE_FREC:
+  case MSG_TYPE_RCHAN_DATA:
+  case MSG_TYPE_RCHAN_SACK:
+  case MSG_TYPE_CREDIT:
+    return;
+  default:
+    creditMessages++;
+    creditBytes += kHeaderSize + msg->length;
+  }
+}
+
+void MainWindow::sendCreditGrant(bool reset) {
+  if (reset) {
+    creditMessages = 0;
+    creditBytes = 0;
+  }
+  creditLimitMessages = creditMessages + kCreditWindowMessages;
+  creditLimitBytes = creditBytes + kCreditWindowBytes;
+
+  char grant[kCreditSize];
+  qToLittleEndian(creditLimitMessages, grant);
+  qToLittleEndian(creditLimitBytes, grant + 4);
+  grant[8] = reset ? kCreditFlagReset : 0;
+  memset(grant + 9, 0, 3);
+  sendMessage(MSG_TYPE_CREDIT, 0, QByteArray(grant, kCreditSize), false);
+  creditLabel->setText(QString("granted to %1 messages / %2 bytes, %3 probes")
+                           .arg(creditLimitMessages)
+                           .arg(creditLimitBytes)
+                           .arg(creditProbes));
+}
+
+// A paused board sends its own counts. Whatever it sent before the probe has
+// been read or lost by now, so granting on top of them returns the credit
+// of lost datagrams that a count of our reads would keep back forever.
+void MainWindow::processCreditProbe(const DataMessage *msg) {
+  if (msg->length < kCreditSize || !creditCheck->isChecked())
+    return;
+  creditMessages = qFromLittleEndian<quint32>(msg->data);
+  creditBytes = qFromLittleEndian<quint32>(msg->data + 4);
+  creditProbes++;
+  sendCreditGrant(false);
+}
+
+void MainWindow::processAckRanges(const DataMessage *msg) {
+  // u8 range count, reserved byte, then {first, last} pairs; a run whose
+  // last id is below its first wrapped past 255
+  const quint8 *data = reinterpret_cast<const quint8 *>(msg->data);
+  int rangeCount = msg->length >= 2 ? data[0] : 0;
+  if (2 + 2 * rangeCount > msg->length) {
+    logMessage("Received malformed ack range");
+    return;
+  }
+
+  // Coalesced acks wait for the board's deadline, so they are not used as
+  // RTT samples
+  int ids = 0;
+  QStringList runs;
+  for (int i = 0; i < rangeCount; i++) {
+    quint8 first = data[2 + 2 * i];
+    quint8 last = data[3 + 2 * i];
+    int length = static_cast<quint8>(last - first) + 1;
+    for (int n = 0; n < length; n++) {
+      quint8 id = static_cast<quint8>(first + n);
+      pendingCommands.remove(id);
+      // A write-only batch that succeeded is acked instead of answered
+      if (pendingBatches.contains(id)) {
+        logMessage(QString("Batch %1 acked in range: %2 steps done")
+                       .arg(id)
+                       .arg(pendingBatches.take(id).size()));
+      }
+    }
+    ids += length;
+    runs.append(first == last ? QString::number(first)
+                              : QString("%1-%2").arg(first).arg(last));
+  }
+  pendingLabel->setText(QString::number(pendingCommands.size()));
+
+  logMessage(QString("Acked %1 commands (%2 pending) in one datagram: %3")
+                 .arg(ids)
+                 .arg(pendingCommands.size())
+                 .arg(runs.join(", ")));
+}
+
+void MainWindow::processStatusFrame(const DataMessage *msg) {
+  // u8 kind (0 key, 1 delta), u8 stream, u16 channels, u32 sequence; a
+  // keyframe then has one s32 per channel, a delta a change bitmap and the
+  // new value of each changed channel
+  const uchar *data = reinterpret_cast<const uchar *>(msg->data);
+  if (msg->length < 8) {
+    logMessage("Received malformed status frame");
+    return;
+  }
+  quint8 kind = data[0];
+  int channels = qFromLittleEndian<quint16>(data + 2);
+  quint32 sequence = qFromLittleEndian<quint32>(data + 4);
+  FrameStream &stream = frameStreams[data[1]];
+
+  if (kind == 0) {
+    if (msg->length != 8 + 4 * channels) {
+      logMessage("Received malformed status keyframe");
+      return;
+    }
+    stream.values.resize(channels);
+    for (int ch = 0; ch < channels; ch++)
+      stream.values[ch] = qFromLittleEndian<qint32>(data + 8 + 4 * ch);
+    stream.sequence = sequence;
+    stream.synced = true;
+    stream.keyRequested = false;
+    stream.keyframes++;
+    logMessage(QString("Status keyframe #%1: %2 channels")
+                   .arg(sequence)
+                   .arg(channels));
+  } else {
+    // A delta only applies on top of the frame right before it
+    if (!stream.synced || sequence != stream.sequence + 1 ||
+        channels != stream.values.size()) {
+      stream.synced = false;
+      if (!stream.keyRequested) {
+        stream.keyRequested = true;
+        stream.resyncs++;
+        logMessage(QString("Status frame #%1 does not follow #%2, "
+                           "requesting keyframe")
+                       .arg(sequence)
+                       .arg(stream.sequence));
+        sendCommandMessage("FRAME KEY");
+      }
+      return;
+    }
+
+    int bitmapSize = (channels + 7) / 8;
+    int changed = 0;
+    if (msg->length >= 8 + bitmapSize) {
+      for (int ch = 0; ch < channels; ch++) {
+        if (data[8 + ch / 8] & (1 << (ch % 8)))
+          changed++;
+      }
+    }
+    if (msg->length != 8 + bitmapSize + 4 * changed) {
+      logMessage("Received malformed status delta");
+      return;
+    }
+    const uchar *values = data + 8 + bitmapSize;
+    for (int ch = 0; ch < channels; ch++) {
+      if (data[8 + ch / 8] & (1 << (ch % 8))) {
+        stream.values[ch] = qFromLittleEndian<qint32>(values);
+        values += 4;
+      }
+    }
+    stream.sequence = sequence;
+    stream.lastChanged = changed;
+  }
+
+  frameLabel->setText(QString("#%1, %2 channels, %3 changed, %4 keyframes, "
+                              "%5 resyncs")
+                          .arg(stream.sequence)
+                          .arg(stream.values.size())
+                          .arg(stream.lastChanged)
+                          .arg(stream.keyframes)
+                          .arg(stream.resyncs));
+}
+
+void MainWindow::processBatchResult(const DataMessage *msg) {
+  // u8 status, u8 steps done, u16 reserved, u32 busy_us, then one u32 per
+  // step (plus the last read of a timed-out poll)
+  const uchar *data = reinterpret_cast<const uchar *>(msg->data);
+  if (msg->length < 8 || (msg->length - 8) % 4 != 0) {
+    logMessage("Received malformed batch result");
+    return;
+  }
+  quint8 status = data[0];
+  int done = data[1];
+  quint32 busyUs = qFromLittleEndian<quint32>(data + 4);
+  int results = (msg->length - 8) / 4;
+  QStringList steps = pendingBatches.take(msg->sequence);
+
+  const char *statusText =
+      status < sizeof(kBatchStatus) / sizeof(kBatchStatus[0])
+          ? kBatchStatus[status]
+          : "unknown";
+  logMessage(QString("Batch #%1: %2, %3/%4 steps, %5 us waiting")
+                 .arg(msg->sequence)
+                 .arg(statusText)
+                 .arg(done)
+                 .arg(steps.isEmpty() ? results : steps.size())
+                 .arg(busyUs));
+  for (int i = 0; i < results; i++) {
+    quint32 value = qFromLittleEndian<quint32>(data + 8 + 4 * i);
+    logMessage(QString("  %1 -> 0x%2")
+                   .arg(i < steps.size() ? steps.at(i) : QString::number(i))
+                   .arg(value, 8, 16, QChar('0')));
+  }
+}
+
 void MainWindow::updateConnectionStatus() {
-  // This could be used to check connection health
-  // For now, it's a placeholder for future enhancements
+  if (!connected)
+    return;
+
+  qint64 now = clock.elapsed();
+  expireReassemblies(now);
+  expireFecGroups(now);
+  if (probesOutstanding == 0) {
+    if (now - lastReceivedMs < kKeepaliveIdleMs)
+      return; // Traffic is flowing, no heartbeat needed
+  } else if (now - probeSentMs < retransmitTimeoutMs()) {
+    return; // Still waiting for the answer to the last probe
+  }
+
+  if (probesOutstanding >= kKeepaliveProbes) {
+    if (boardResponding) {
+      boardResponding = false;
+      logMessage(QString("Board not responding for %1 ms")
+                     .arg(now - lastReceivedMs));
+    }
+    probesOutstanding = 0; // Keep probing at the idle interval
+    lastReceivedMs = now;
+    return;
+  }
+
+  sendHeartbeat();
 }
 
 void MainWindow::logMessage(const QString &message) {
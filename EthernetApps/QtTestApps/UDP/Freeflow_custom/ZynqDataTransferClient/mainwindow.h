@@ -1,20 +1,29 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include "rchan.h"
+#include <QCheckBox>
+#include <QElapsedTimer>
 #include <QGridLayout>
 #include <QGroupBox>
 #include <QHBoxLayout>
+#include <QHash>
 #include <QLabel>
 #include <QLineEdit>
+#include <QMap>
 #include <QMainWindow>
 #include <QMessageBox>
 #include <QPushButton>
 #include <QSpinBox>
+#include <QStringList>
 #include <QTextEdit>
 #include <QTimer>
 #include <QUdpSocket>
+#include <QVector>
 #include <QVBoxLayout>
 
+struct DataMessage;
+
 class MainWindow : public QMainWindow {
   Q_OBJECT
 
@@ -30,15 +39,56 @@ private slots:
   void sendHeartbeat();
   void readPendingDatagrams();
   void updateConnectionStatus();
+  void setPacking(bool enabled);
+  void benchmarkCrc(bool enabled);
+  void setCompression(bool enabled);
+  void setFec(bool enabled);
+  void pollReliableChannel();
+  void setCredit(bool enabled);
 
 private:
   void setupUI();
   void logMessage(const QString &message);
   void processReceivedData(const QByteArray &data, const QHostAddress &sender,
                            quint16 port);
+  void processMessage(const DataMessage *msg, const QHostAddress &sender,
+                      quint16 port, qint64 now);
+  bool sendMessage(quint8 msgType, quint8 sequence, const QByteArray &payload,
+                   bool fullFrame);
+  bool sendFragmented(quint8 msgType, quint8 sequence,
+                      const QByteArray &payload);
+  bool sendCommandMessage(const QString &commandString);
+  bool sendCommandsPacked(const QStringList &commands);
+  bool sendBatch(const QString &script);
+  void processAckRanges(const DataMessage *msg);
+  void processBatchResult(const DataMessage *msg);
+  void processStatusFrame(const DataMessage *msg);
+  void processFragment(const DataMessage *msg, const QHostAddress &sender,
+                       quint16 port, qint64 now);
+  void expireReassemblies(qint64 now);
+  void updateFragmentLabel();
+  void processFec(const DataMessage *msg, const QHostAddress &sender,
+                  quint16 port, qint64 now);
+  void deliverFecBlock(const QByteArray &block, const QHostAddress &sender,
+                       quint16 port, qint64 now);
+  void expireFecGroups(qint64 now);
+  void updateFecLabel();
+  bool sendBlob(int bytes);
+  void deliverTransfer(quint8 service, const QByteArray &data,
+                       qint64 elapsedUs);
+  void transferDone(quint8 service, int bytes, qint64 elapsedUs, bool ok);
+  void updateRchanLabel();
+  void countCredit(const DataMessage *msg);
+  void sendCreditGrant(bool reset);
+  void processCreditProbe(const DataMessage *msg);
+  void trackV2Stream(quint16 streamId, quint32 sequence, quint64 timestampUs);
+  void sendHeartbeatAck(quint8 sequence, const QByteArray &probeText);
+  void addRttSample(qint64 rttMs);
+  qint64 retransmitTimeoutMs() const;
 
   QUdpSocket *udpSocket;
-  QTimer *heartbeatTimer;
+  QTimer *keepaliveTimer;
+  QTimer *rchanTimer; // Drives resends while a transfer is running
 
   // UI Components
   QTextEdit *logTextEdit;
@@ -56,6 +106,20 @@ private:
   QLabel *bytesReceivedLabel;
   QLabel *bytesSentLabel;
   QLabel *lastReceivedLabel;
+  QLabel *rttLabel;
+  QLabel *pendingLabel;
+  QLabel *lossLabel;
+  QLabel *frameLabel;
+  QLabel *fragmentLabel;
+  QLabel *fecLabel;
+  QLabel *rchanLabel;
+  QLabel *creditLabel;
+  QCheckBox *protocolV2Check;
+  QCheckBox *packCheck;
+  QCheckBox *crcCheck;
+  QCheckBox *lz4Check;
+  QCheckBox *fecCheck;
+  QCheckBox *creditCheck;
 
   // Statistics
   int packetsReceived;
@@ -66,6 +130,90 @@ private:
   bool connected;
   QHostAddress serverAddress;
   quint16 serverPort;
+
+  // Keepalive: probes only after the board has been quiet for a while
+  QElapsedTimer clock;
+  qint64 lastReceivedMs;
+  qint64 probeSentMs;
+  quint8 probeSequence;
+  int probesOutstanding;
+  bool boardResponding;
+  double srttMs;
+  double rttvarMs;
+  int rttSamples;
+  QHash<quint8, qint64> pendingCommands; // Sequence -> send time, for RTT
+  QHash<quint8, QStringList> pendingBatches; // Sequence -> steps sent
+
+  // Protocol v2 sequences: sent per message type, received per stream
+  struct RxStream {
+    quint32 highest = 0;
+    quint32 window = 0; // Bit n set: highest - n has been received
+    quint32 received = 0;
+    quint32 lost = 0;
+    quint32 reordered = 0;
+    quint32 duplicates = 0;
+    qint64 lastTransitUs = 0;
+    double jitterUs = 0;
+  };
+  quint32 txStreamSequence[32];
+  QHash<quint16, RxStream> rxStreams;
+  int crcFailures;
+
+  // Status frames: channel values rebuilt from keyframes and deltas
+  struct FrameStream {
+    QVector<qint32> values;
+    quint32 sequence = 0;
+    bool synced = false;
+    bool keyRequested = false; // FRAME KEY sent, waiting for the keyframe
+    int lastChanged = 0;
+    int keyframes = 0;
+    int resyncs = 0;
+  };
+  QHash<quint8, FrameStream> frameStreams;
+
+  // Messages larger than one datagram, by fragment message id
+  struct Reassembly {
+    QByteArray data; // Final size from the first fragment, filled in place
+    QVector<bool> received;
+    int arrived = 0;
+    quint8 msgType = 0;
+    quint8 sequence = 0;
+    quint32 crc = 0;
+    qint64 lastProgressMs = 0;
+    bool complete = false; // Delivered, kept to recognise late duplicates
+  };
+  quint16 fragmentMessageId;
+  QHash<quint16, Reassembly> reassemblies;
+  int fragmentedSent;
+  int fragmentsReassembled;
+  int fragmentsDropped;
+
+  // FEC groups of streaming messages, by group id
+  struct FecGroup {
+    QVector<QByteArray> data; // By index, empty until it arrives
+    QMap<int, QByteArray> parity;
+    int k = 0;
+    bool kFinal = false; // k from a parity message rather than the data's
+    bool done = false;   // Complete or rebuilt; kept to ignore latecomers
+    qint64 lastMs = 0;
+  };
+  void recoverFecGroup(FecGroup *group, const QHostAddress &sender,
+                       quint16 port, qint64 now);
+  QHash<quint16, FecGroup> fecGroups;
+  int fecRecovered;
+  int fecUnrecoverable;
+
+  // Reliable channel transfers, in both directions
+  quint32 blobCrc; // CRC32C of the blob being uploaded
+  ReliableChannel rchan;
+
+  // Credit: what the board has sent us by its own count, as far as we have
+  // read it, and the limits last granted on top of that
+  quint32 creditMessages;
+  quint32 creditBytes;
+  quint32 creditLimitMessages;
+  quint32 creditLimitBytes;
+  int creditProbes;
 };
 
 #endif // MAINWINDOW_H
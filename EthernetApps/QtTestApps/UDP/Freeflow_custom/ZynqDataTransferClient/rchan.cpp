@@ -0,0 +1,287 @@
+#include "rchan.h"
+#include <QtEndian>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+const qint64 kInitialRtoUs = 200000;
+const qint64 kMinRtoUs = 5000;
+const qint64 kMaxRtoUs = 2000000;
+const qint64 kGiveUpUs = 5000000; // Transfer abandoned without progress
+const int kDupThresh = 3;         // Later segments acked before a resend
+
+int segmentCount(qint64 length) {
+  return static_cast<int>((length + ReliableChannel::kSegment - 1) /
+                          ReliableChannel::kSegment);
+}
+
+int segmentLength(qint64 length, int segment) {
+  return static_cast<int>(
+      qMin<qint64>(ReliableChannel::kSegment,
+                   length - static_cast<qint64>(segment) *
+                                ReliableChannel::kSegment));
+}
+
+} // namespace
+
+ReliableChannel::ReliableChannel(SendFunction send, DeliverFunction deliver,
+                                 DoneFunction done)
+    : sendMessage(std::move(send)), deliverTransfer(std::move(deliver)),
+      transferDone(std::move(done)), rto(kInitialRtoUs) {
+  tx.sentUs.resize(kMaxWindow);
+  tx.sends.resize(kMaxWindow);
+  tx.acked.resize(kMaxWindow);
+}
+
+void ReliableChannel::setWindow(int segments) {
+  windowSize = qBound(1, segments, kMaxWindow);
+}
+
+void ReliableChannel::reset() {
+  tx.active = false;
+  tx.data.clear();
+  rx.active = false;
+  rx.data.clear();
+}
+
+bool ReliableChannel::start(quint8 service, const QByteArray &data,
+                            qint64 nowUs) {
+  if (tx.active || data.isEmpty() || data.size() > kMaxTransfer)
+    return false;
+
+  tx.active = true;
+  tx.transfer = nextTransfer++;
+  tx.service = service;
+  tx.data = data;
+  tx.count = segmentCount(data.size());
+  tx.base = 0;
+  tx.next = 0;
+  tx.startedUs = nowUs;
+  tx.lastProgressUs = nowUs;
+  counters.txTransfers++;
+
+  // The first window goes out right away, the rest is ack-clocked
+  pump(nowUs);
+  return true;
+}
+
+bool ReliableChannel::sendSegment(int segment, qint64 nowUs) {
+  char header[kDataHeaderSize];
+  qToLittleEndian(tx.transfer, header);
+  header[2] = static_cast<char>(tx.service);
+  header[3] = 0;
+  qToLittleEndian(static_cast<quint32>(segment), header + 4);
+  qToLittleEndian(static_cast<quint32>(tx.data.size()), header + 8);
+  QByteArray payload(header, kDataHeaderSize);
+  payload.append(tx.data.constData() +
+                     static_cast<qint64>(segment) * kSegment,
+                 segmentLength(tx.data.size(), segment));
+  if (!sendMessage(kDataType, payload))
+    return false;
+
+  int slot = segment % kMaxWindow;
+  tx.sentUs[slot] = nowUs;
+  tx.sends[slot]++;
+  counters.txSegments++;
+  return true;
+}
+
+void ReliableChannel::pump(qint64 nowUs) {
+  for (int s = tx.base; s < tx.next; s++) {
+    int slot = s % kMaxWindow;
+    if (tx.acked.at(slot) || nowUs - tx.sentUs.at(slot) < rto)
+      continue;
+    if (!sendSegment(s, nowUs))
+      return;
+    counters.txTimeouts++;
+    // Back off once per expiry of the oldest segment, RFC 6298 style
+    if (s == tx.base)
+      rto = qMin(2 * rto, kMaxRtoUs);
+  }
+
+  while (tx.next < tx.count && tx.next < tx.base + windowSize) {
+    int slot = tx.next % kMaxWindow;
+    tx.sends[slot] = 0;
+    tx.acked[slot] = false;
+    if (!sendSegment(tx.next, nowUs))
+      return;
+    tx.next++;
+  }
+}
+
+void ReliableChannel::rttSample(qint64 rttUs) {
+  if (rttSamples == 0) {
+    srtt = rttUs;
+    rttvar = rttUs / 2;
+  } else {
+    rttvar = (3 * rttvar + qAbs(rttUs - srtt)) / 4;
+    srtt = (7 * srtt + rttUs) / 8;
+  }
+  rttSamples++;
+  rto = qBound(kMinRtoUs, srtt + 4 * rttvar, kMaxRtoUs);
+}
+
+void ReliableChannel::poll(qint64 nowUs) {
+  if (!tx.active)
+    return;
+  if (nowUs - tx.lastProgressUs > kGiveUpUs) {
+    tx.active = false;
+    counters.txAborted++;
+    transferDone(tx.service, tx.data.size(), nowUs - tx.startedUs, false);
+    return;
+  }
+  pump(nowUs);
+}
+
+void ReliableChannel::receive(quint8 msgType, const QByteArray &payload,
+                              qint64 nowUs) {
+  if (msgType == kSackType)
+    onSack(payload, nowUs);
+  else if (msgType == kDataType)
+    onData(payload, nowUs);
+}
+
+void ReliableChannel::onSack(const QByteArray &payload, qint64 nowUs) {
+  if (payload.size() < kSackSize) {
+    counters.rxInvalid++;
+    return;
+  }
+  const char *p = payload.constData();
+  quint16 transfer = qFromLittleEndian<quint16>(p);
+  quint32 cumulative = qFromLittleEndian<quint32>(p + 4);
+  quint32 trigger = qFromLittleEndian<quint32>(p + 8);
+  quint64 bitmap = qFromLittleEndian<quint64>(p + 12);
+  if (!tx.active || transfer != tx.transfer)
+    return; // Late SACK of a finished or abandoned transfer
+  if (cumulative > static_cast<quint32>(tx.next)) {
+    counters.rxInvalid++;
+    return;
+  }
+  if (cumulative < static_cast<quint32>(tx.base))
+    return; // Overtaken by a later SACK
+
+  // Karn: a resent segment's ack cannot tell which copy it answers
+  if (trigger >= static_cast<quint32>(tx.base) &&
+      trigger < static_cast<quint32>(tx.next)) {
+    int slot = trigger % kMaxWindow;
+    if (tx.sends.at(slot) == 1 && !tx.acked.at(slot))
+      rttSample(nowUs - tx.sentUs.at(slot));
+  }
+
+  if (static_cast<int>(cumulative) > tx.base) {
+    tx.base = static_cast<int>(cumulative);
+    tx.lastProgressUs = nowUs;
+  }
+  if (tx.base == tx.count) {
+    tx.active = false;
+    counters.txCompleted++;
+    transferDone(tx.service, tx.data.size(), nowUs - tx.startedUs, true);
+    return;
+  }
+
+  int highest = tx.base;
+  for (int n = 0; n < 64; n++) {
+    int s = static_cast<int>(cumulative) + 1 + n;
+    if (s >= tx.next)
+      break;
+    if (bitmap & (Q_UINT64_C(1) << n)) {
+      tx.acked[s % kMaxWindow] = true;
+      highest = s;
+    }
+  }
+
+  // A hole kDupThresh segments below the highest acked one is taken as
+  // lost, resent at most once per smoothed RTT
+  for (int s = tx.base; s + kDupThresh <= highest; s++) {
+    int slot = s % kMaxWindow;
+    if (tx.acked.at(slot) || nowUs - tx.sentUs.at(slot) <= srtt)
+      continue;
+    if (!sendSegment(s, nowUs))
+      break;
+    counters.txFastResends++;
+  }
+
+  pump(nowUs);
+}
+
+void ReliableChannel::onData(const QByteArray &payload, qint64 nowUs) {
+  if (payload.size() < kDataHeaderSize) {
+    counters.rxInvalid++;
+    return;
+  }
+  const char *p = payload.constData();
+  quint16 transfer = qFromLittleEndian<quint16>(p);
+  quint8 service = static_cast<quint8>(p[2]);
+  quint32 segment = qFromLittleEndian<quint32>(p + 4);
+  quint32 total = qFromLittleEndian<quint32>(p + 8);
+  int length = payload.size() - kDataHeaderSize;
+  if (total == 0 || total > static_cast<quint32>(kMaxTransfer) ||
+      segment >= static_cast<quint32>(segmentCount(total)) ||
+      length != segmentLength(total, static_cast<int>(segment))) {
+    counters.rxInvalid++;
+    return;
+  }
+
+  if (!rx.active || rx.transfer != transfer || rx.service != service ||
+      rx.data.size() != static_cast<int>(total)) {
+    // One transfer at a time; a stalled one is replaced
+    if (rx.active && !rx.complete &&
+        nowUs - rx.lastProgressUs < kGiveUpUs) {
+      counters.rxInvalid++;
+      return;
+    }
+    rx.active = true;
+    rx.complete = false;
+    rx.transfer = transfer;
+    rx.service = service;
+    rx.data = QByteArray(static_cast<int>(total), '\0');
+    rx.received.fill(false, segmentCount(total));
+    rx.cumulative = 0;
+    rx.startedUs = nowUs;
+    counters.rxTransfers++;
+  }
+
+  int s = static_cast<int>(segment);
+  if (rx.received.at(s)) {
+    counters.rxDuplicates++;
+  } else {
+    rx.received[s] = true;
+    memcpy(rx.data.data() + static_cast<qint64>(s) * kSegment,
+           p + kDataHeaderSize, length);
+    while (rx.cumulative < rx.received.size() &&
+           rx.received.at(rx.cumulative))
+      rx.cumulative++;
+    rx.lastProgressUs = nowUs;
+    counters.rxSegments++;
+  }
+
+  // Duplicates are acked too: they mean an earlier SACK was lost
+  sendSack(s);
+
+  if (rx.cumulative == rx.received.size() && !rx.complete) {
+    rx.complete = true;
+    counters.rxCompleted++;
+    deliverTransfer(rx.service, rx.data, nowUs - rx.startedUs);
+  }
+}
+
+void ReliableChannel::sendSack(int trigger) {
+  quint64 bitmap = 0;
+  for (int n = 0; n < 64; n++) {
+    int s = rx.cumulative + 1 + n;
+    if (s >= rx.received.size())
+      break;
+    if (rx.received.at(s))
+      bitmap |= Q_UINT64_C(1) << n;
+  }
+
+  char sack[kSackSize];
+  qToLittleEndian(rx.transfer, sack);
+  sack[2] = static_cast<char>(rx.service);
+  sack[3] = 0;
+  qToLittleEndian(static_cast<quint32>(rx.cumulative), sack + 4);
+  qToLittleEndian(static_cast<quint32>(trigger), sack + 8);
+  qToLittleEndian(bitmap, sack + 12);
+  sendMessage(kSackType, QByteArray(sack, kSackSize)); // The next one covers
+}
@@ -0,0 +1,118 @@
+#ifndef RCHAN_H
+#define RCHAN_H
+
+#include "wire.h"
+#include <QByteArray>
+#include <QVector>
+#include <functional>
+
+// Reliable channel, the client end of rchan.c on the Zynq side. A transfer
+// is cut into kSegment byte segments behind a 12-byte header (u16 transfer,
+// u8 service, u8 reserved, u32 segment, u32 total length) and up to a
+// window of them are in flight. Every segment is answered by a SACK: u16
+// transfer, u8 service, u8 reserved, u32 cumulative, u32 trigger and a
+// 64-bit bitmap of the segments after cumulative. One transfer each way at
+// a time. The owner routes both message types to receive() and calls
+// poll() every few milliseconds while busy(), so expired segments are
+// resent. Times are in microseconds of the owner's clock.
+class ReliableChannel {
+public:
+  static constexpr quint8 kDataType = MSG_TYPE_RCHAN_DATA;
+  static constexpr quint8 kSackType = MSG_TYPE_RCHAN_SACK;
+  static constexpr int kDataHeaderSize = 12;
+  static constexpr int kSackSize = 20;
+  static constexpr int kSegment = WIRE_V1_MAX_DATA - kDataHeaderSize;
+  static constexpr int kMaxWindow = 64; // The SACK bitmap size
+  static constexpr int kDefaultWindow = 32;
+  static constexpr int kMaxTransfer = 16 * 1024 * 1024;
+
+  // Sends one message; false if the socket refused it
+  using SendFunction =
+      std::function<bool(quint8 msgType, const QByteArray &payload)>;
+  // A transfer from the board arrived whole
+  using DeliverFunction = std::function<void(
+      quint8 service, const QByteArray &data, qint64 elapsedUs)>;
+  // A transfer to the board was acked whole, or abandoned
+  using DoneFunction = std::function<void(quint8 service, int bytes,
+                                          qint64 elapsedUs, bool ok)>;
+
+  struct Stats {
+    int txTransfers = 0;
+    int txCompleted = 0;
+    int txAborted = 0;
+    int txSegments = 0;
+    int txTimeouts = 0;    // Resent after the RTO expired
+    int txFastResends = 0; // Resent on SACK evidence
+    int rxTransfers = 0;
+    int rxCompleted = 0;
+    int rxSegments = 0;
+    int rxDuplicates = 0;
+    int rxInvalid = 0;
+  };
+
+  ReliableChannel(SendFunction send, DeliverFunction deliver,
+                  DoneFunction done);
+
+  // Starts sending data to the board's service; false while busy()
+  bool start(quint8 service, const QByteArray &data, qint64 nowUs);
+  void receive(quint8 msgType, const QByteArray &payload, qint64 nowUs);
+  void poll(qint64 nowUs);
+  // Drops both transfers without callbacks, e.g. on reconnect
+  void reset();
+
+  bool busy() const { return tx.active; }
+  void setWindow(int segments);
+  int window() const { return windowSize; }
+  qint64 srttUs() const { return srtt; }
+  qint64 rtoUs() const { return rto; }
+  const Stats &stats() const { return counters; }
+
+private:
+  struct TxTransfer {
+    bool active = false;
+    quint16 transfer = 0;
+    quint8 service = 0;
+    QByteArray data;
+    int count = 0;
+    int base = 0; // Lowest segment not yet acked
+    int next = 0; // Lowest segment never sent
+    qint64 startedUs = 0;
+    qint64 lastProgressUs = 0;
+    QVector<qint64> sentUs; // Per window slot, segment % kMaxWindow
+    QVector<int> sends;
+    QVector<bool> acked;
+  };
+  struct RxTransfer {
+    bool active = false;
+    bool complete = false; // Delivered, kept to ack late duplicates
+    quint16 transfer = 0;
+    quint8 service = 0;
+    QByteArray data;
+    QVector<bool> received;
+    int cumulative = 0; // Lowest segment not yet received
+    qint64 startedUs = 0;
+    qint64 lastProgressUs = 0;
+  };
+
+  bool sendSegment(int segment, qint64 nowUs);
+  void pump(qint64 nowUs);
+  void rttSample(qint64 rttUs);
+  void onSack(const QByteArray &payload, qint64 nowUs);
+  void onData(const QByteArray &payload, qint64 nowUs);
+  void sendSack(int trigger);
+
+  SendFunction sendMessage;
+  DeliverFunction deliverTransfer;
+  DoneFunction transferDone;
+  TxTransfer tx;
+  RxTransfer rx;
+  quint16 nextTransfer = 0;
+  int windowSize = kDefaultWindow;
+  qint64 srtt = 0;
+  qint64 rttvar = 0;
+  int rttSamples = 0;
+  qint64 rto; // Doubled on timeouts until the next RTT sample
+  Stats counters;
+};
+
+#endif // RCHAN_H
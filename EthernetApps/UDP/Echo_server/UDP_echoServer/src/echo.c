@@ -17,13 +17,60 @@
  */
 
 
+#include <string.h>
+
 #include "lwip/udp.h"
 #include "lwip/sys.h"
+#include "lwip/ip.h"
+#include "lwip/stats.h"
 #include "lwipopts.h"
+#include "xtime_l.h"
 #ifdef __arm__
 #include "xil_printf.h"
 #endif
 
+/* TWAMP-light reflector (RFC 5357 unauthenticated mode) */
+#define TWAMP_PORT		862
+#define TWAMP_SENDER_LEN	14	/* seq(4) timestamp(8) error estimate(2) */
+#define TWAMP_REFLECT_LEN	41	/* reflector header up to sender TTL */
+#define TWAMP_ERROR_ESTIMATE	0x0001	/* unsynchronized, multiplier 1 */
+
+static u32_t twamp_sequence;
+static u32_t twamp_reflected;
+static u32_t twamp_too_short;
+static u32_t twamp_send_errors;
+
+/*
+ * Burst echo: clients tag each datagram with a 16-byte big endian header
+ * (magic, burst id, index in burst, burst length, global sequence). Packets
+ * are reflected unchanged and in arrival order; the board keeps per-burst
+ * receive accounting and counts reflections that failed inside the board.
+ */
+#define BURST_PORT		7007
+#define BURST_MAGIC		0x42525354	/* "BRST" */
+#define BURST_HDR_LEN		16
+
+struct burst_stats {
+	u32_t rx_packets;
+	u32_t rx_untagged;	/* datagrams without a burst header */
+	u32_t rx_out_of_order;	/* index went backwards within a burst */
+	u32_t reflected;
+	u32_t tx_err_mem;	/* ERR_MEM: TX descriptor ring or pbufs exhausted */
+	u32_t tx_err_other;
+	u32_t bursts;		/* bursts closed so far */
+	u32_t bursts_incomplete;
+	u32_t burst_missing;	/* packets a closed burst announced but never sent us */
+	u32_t burst_tx_failed;	/* bursts with at least one failed reflection */
+};
+
+static struct burst_stats burst;
+static u32_t burst_current_id;
+static u16_t burst_current_len;
+static u16_t burst_current_rx;
+static u16_t burst_last_index;
+static u32_t burst_current_tx_errors;
+static int burst_open;
+
 int transfer_data() {
 	return 0;
 }
@@ -32,6 +79,10 @@ void print_app_header()
 {
 	xil_printf("\n\r\n\r-----lwIP UDP echo server ------\n\r");
 	xil_printf("UDP packets sent to port 7 will be echoed back\n\r");
+	xil_printf("TWAMP-light test packets sent to port %d are reflected with "
+			"receive/transmit timestamps\n\r", TWAMP_PORT);
+	xil_printf("Burst-tagged packets sent to port %d are echoed with per-burst "
+			"accounting, send \"STATS\" for counters\n\r", BURST_PORT);
 }
 
 void udp_echo_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
@@ -45,6 +96,187 @@ void udp_echo_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr
 }
 
 
+/* Board time since boot in NTP 32.32 fixed point, from the global timer */
+static void twamp_put_timestamp(u8_t *dst, XTime ticks)
+{
+	u32_t secs = (u32_t)(ticks / COUNTS_PER_SECOND);
+	u32_t frac = (u32_t)(((ticks % COUNTS_PER_SECOND) << 32) / COUNTS_PER_SECOND);
+
+	dst[0] = secs >> 24; dst[1] = secs >> 16; dst[2] = secs >> 8; dst[3] = secs;
+	dst[4] = frac >> 24; dst[5] = frac >> 16; dst[6] = frac >> 8; dst[7] = frac;
+}
+
+static void twamp_put_u32(u8_t *dst, u32_t value)
+{
+	dst[0] = value >> 24; dst[1] = value >> 16; dst[2] = value >> 8; dst[3] = value;
+}
+
+/*
+ * Turn the sender's test packet into a reflector packet in place, so the
+ * received pbuf is sent straight back like in udp_echo_recv.
+ */
+void udp_twamp_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+	XTime rx_time, tx_time;
+	u8_t sender[TWAMP_SENDER_LEN];
+	u8_t *pkt;
+
+	XTime_GetTime(&rx_time);
+
+	if (p == NULL)
+		return;
+
+	/* reflector fields must live in the first, contiguous pbuf */
+	if (p->len < TWAMP_REFLECT_LEN) {
+		twamp_too_short++;
+		pbuf_free(p);
+		return;
+	}
+
+	pkt = (u8_t *)p->payload;
+	memcpy(sender, pkt, TWAMP_SENDER_LEN);
+
+	twamp_put_u32(&pkt[0], twamp_sequence++);
+	pkt[12] = TWAMP_ERROR_ESTIMATE >> 8;
+	pkt[13] = TWAMP_ERROR_ESTIMATE & 0xFF;
+	pkt[14] = 0;
+	pkt[15] = 0;
+	twamp_put_timestamp(&pkt[16], rx_time);
+	memcpy(&pkt[24], sender, TWAMP_SENDER_LEN);	/* seq, timestamp, error */
+	pkt[38] = 0;
+	pkt[39] = 0;
+	pkt[40] = IPH_TTL(ip4_current_header());
+
+	/* stamp as late as possible, right before handing the pbuf to lwIP */
+	XTime_GetTime(&tx_time);
+	twamp_put_timestamp(&pkt[4], tx_time);
+
+	if (udp_sendto(pcb, p, addr, port) == ERR_OK)
+		twamp_reflected++;
+	else
+		twamp_send_errors++;
+
+	pbuf_free(p);
+}
+
+static u32_t burst_get_u32(const u8_t *src)
+{
+	return ((u32_t)src[0] << 24) | ((u32_t)src[1] << 16) |
+			((u32_t)src[2] << 8) | src[3];
+}
+
+static void burst_close(void)
+{
+	if (!burst_open)
+		return;
+
+	burst.bursts++;
+	if (burst_current_rx < burst_current_len) {
+		burst.bursts_incomplete++;
+		burst.burst_missing += burst_current_len - burst_current_rx;
+	}
+	if (burst_current_tx_errors)
+		burst.burst_tx_failed++;
+	burst_open = 0;
+}
+
+static void burst_send_stats(struct udp_pcb *pcb, const ip_addr_t *addr, u16_t port)
+{
+	char text[384];
+	u32_t link_drop = 0, link_memerr = 0;
+	struct pbuf *reply;
+	int len;
+
+#if LINK_STATS
+	link_drop = lwip_stats.link.drop;
+	link_memerr = lwip_stats.link.memerr;
+#endif
+	len = snprintf(text, sizeof(text),
+			"rx=%lu untagged=%lu ooo=%lu reflected=%lu tx_err_mem=%lu "
+			"tx_err_other=%lu bursts=%lu incomplete=%lu missing=%lu "
+			"tx_failed_bursts=%lu link_drop=%lu link_memerr=%lu "
+			"twamp_reflected=%lu twamp_short=%lu twamp_tx_err=%lu",
+			(unsigned long)burst.rx_packets, (unsigned long)burst.rx_untagged,
+			(unsigned long)burst.rx_out_of_order, (unsigned long)burst.reflected,
+			(unsigned long)burst.tx_err_mem, (unsigned long)burst.tx_err_other,
+			(unsigned long)burst.bursts, (unsigned long)burst.bursts_incomplete,
+			(unsigned long)burst.burst_missing, (unsigned long)burst.burst_tx_failed,
+			(unsigned long)link_drop, (unsigned long)link_memerr,
+			(unsigned long)twamp_reflected, (unsigned long)twamp_too_short,
+			(unsigned long)twamp_send_errors);
+
+	reply = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+	if (reply == NULL)
+		return;
+	memcpy(reply->payload, text, len);
+	udp_sendto(pcb, reply, addr, port);
+	pbuf_free(reply);
+}
+
+void udp_burst_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+	const u8_t *pkt;
+	u32_t id;
+	u16_t index;
+	err_t err;
+
+	if (p == NULL)
+		return;
+
+	pkt = (const u8_t *)p->payload;
+
+	/* control requests: "STATS" reports, "RESET" clears the counters */
+	if (p->len >= 5 && memcmp(pkt, "STATS", 5) == 0) {
+		burst_close();
+		burst_send_stats(pcb, addr, port);
+		pbuf_free(p);
+		return;
+	}
+	if (p->len >= 5 && memcmp(pkt, "RESET", 5) == 0) {
+		memset(&burst, 0, sizeof(burst));
+		burst_open = 0;
+		pbuf_free(p);
+		return;
+	}
+
+	burst.rx_packets++;
+
+	if (p->len >= BURST_HDR_LEN && burst_get_u32(pkt) == BURST_MAGIC) {
+		id = burst_get_u32(&pkt[4]);
+		index = (pkt[8] << 8) | pkt[9];
+
+		if (!burst_open || id != burst_current_id) {
+			burst_close();
+			burst_open = 1;
+			burst_current_id = id;
+			burst_current_len = (pkt[10] << 8) | pkt[11];
+			burst_current_rx = 0;
+			burst_current_tx_errors = 0;
+		} else if (index < burst_last_index) {
+			burst.rx_out_of_order++;
+		}
+		burst_last_index = index;
+		burst_current_rx++;
+	} else {
+		burst.rx_untagged++;
+	}
+
+	/* reflect right away, so per-packet order is preserved */
+	err = udp_sendto(pcb, p, addr, port);
+	if (err == ERR_OK) {
+		burst.reflected++;
+	} else {
+		if (err == ERR_MEM)
+			burst.tx_err_mem++;
+		else
+			burst.tx_err_other++;
+		if (burst_open)
+			burst_current_tx_errors++;
+	}
+
+	pbuf_free(p);
+}
+
 int start_application()
 {
 
@@ -73,5 +305,39 @@ int start_application()
 
 	xil_printf("UDP echo server started @ port %d\n\r", port);
 
+	/* TWAMP-light reflector on its own port */
+	pcb = udp_new();
+	if (!pcb) {
+		xil_printf("Error creating TWAMP PCB. Out of Memory\n\r");
+		return -1;
+	}
+
+	err = udp_bind(pcb, IP_ADDR_ANY, TWAMP_PORT);
+	if (err != 0) {
+		xil_printf("Unable to bind to port %d: err = %d\n\r", TWAMP_PORT, err);
+		return -2;
+	}
+
+	udp_recv(pcb, udp_twamp_recv, NULL);
+
+	xil_printf("TWAMP-light reflector started @ port %d\n\r", TWAMP_PORT);
+
+	/* burst-aware echo with drop accounting */
+	pcb = udp_new();
+	if (!pcb) {
+		xil_printf("Error creating burst echo PCB. Out of Memory\n\r");
+		return -1;
+	}
+
+	err = udp_bind(pcb, IP_ADDR_ANY, BURST_PORT);
+	if (err != 0) {
+		xil_printf("Unable to bind to port %d: err = %d\n\r", BURST_PORT, err);
+		return -2;
+	}
+
+	udp_recv(pcb, udp_burst_recv, NULL);
+
+	xil_printf("Burst echo server started @ port %d\n\r", BURST_PORT);
+
 	return 0;
 }
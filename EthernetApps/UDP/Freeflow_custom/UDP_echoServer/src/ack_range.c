@@ -0,0 +1,163 @@
+/*
+ * Ack Range Implementation
+ * With ACKMODE RANGE a pipelining client no longer gets one RESPONSE per
+ * command. Commands whose reply is only an acknowledgement are held as runs
+ * of sequence numbers and sent in one MSG_TYPE_ACK_RANGE datagram once enough
+ * ids are held or the oldest has waited out the deadline. That covers
+ * actions that succeeded (handlers return no text for them) and write-only
+ * BATCH scripts. Queries and errors still answer with their own RESPONSE.
+ */
+
+#include "ack_range.h"
+#include "send_queue.h"
+#include <stdlib.h>
+#include <string.h>
+
+static u8_t ack_mode = ACK_MODE_EACH;
+static ip_addr_t ack_dest_ip;
+static u16_t ack_dest_port;
+static u16_t ack_count_limit = ACK_RANGE_DEFAULT_COUNT;
+static u32_t ack_deadline_ms = ACK_RANGE_DEFAULT_DEADLINE_MS;
+
+/* Ids held for the next datagram */
+static ack_range_t ack_ranges[ACK_RANGE_MAX_RANGES];
+static u8_t ack_range_count;
+static u16_t ack_held;
+static XTime ack_first_held;
+
+static ack_range_stats_t ack_stats;
+
+int ack_range_active(const ip_addr_t *addr, u16_t port) {
+  return ack_mode == ACK_MODE_RANGE && ack_dest_port == port &&
+         ip_addr_cmp(&ack_dest_ip, addr);
+}
+
+/* Returns 0 if the datagram could not be queued; the ids stay held */
+static int ack_range_flush(void) {
+  if (ack_range_count == 0) {
+    return 1;
+  }
+
+  data_message_t msg;
+  msg.msg_type = MSG_TYPE_ACK_RANGE;
+  msg.sequence = sequence_counter++;
+  msg.data[0] = ack_range_count;
+  msg.data[1] = 0;
+  memcpy(&msg.data[2], ack_ranges, ack_range_count * sizeof(ack_range_t));
+  msg.length = 2 + ack_range_count * sizeof(ack_range_t);
+
+  if (sendq_submit(&msg, SENDQ_RELIABLE, &ack_dest_ip, ack_dest_port) !=
+      ERR_OK) {
+    ack_stats.send_failures++;
+    return 0;
+  }
+
+  ack_stats.ids += ack_held;
+  ack_stats.datagrams++;
+  ack_range_count = 0;
+  ack_held = 0;
+  return 1;
+}
+
+static int ack_range_contains(const ack_range_t *r, u8_t sequence) {
+  return (u8_t)(sequence - r->first) <= (u8_t)(r->last - r->first);
+}
+
+void ack_range_add(const ip_addr_t *addr, u16_t port, u8_t sequence) {
+  if (!ack_range_active(addr, port)) {
+    return;
+  }
+
+  /* A retransmitted command already held is acked by the pending range */
+  for (u8_t i = 0; i < ack_range_count; i++) {
+    if (ack_range_contains(&ack_ranges[i], sequence)) {
+      return;
+    }
+  }
+
+  /* In-order pipelining extends the last run; gaps start a new one */
+  ack_range_t *last =
+      ack_range_count > 0 ? &ack_ranges[ack_range_count - 1] : NULL;
+  if (last != NULL && sequence == (u8_t)(last->last + 1)) {
+    last->last = sequence;
+  } else {
+    if (ack_range_count == ACK_RANGE_MAX_RANGES && !ack_range_flush()) {
+      return; // Not acked; the retransmit is answered via the reply cache
+    }
+    ack_ranges[ack_range_count].first = sequence;
+    ack_ranges[ack_range_count].last = sequence;
+    ack_range_count++;
+  }
+
+  if (ack_held == 0) {
+    XTime_GetTime(&ack_first_held);
+  }
+  ack_held++;
+
+  if (ack_held >= ack_count_limit && ack_range_flush()) {
+    ack_stats.count_flushes++;
+  }
+}
+
+void ack_range_poll(void) {
+  if (ack_held == 0) {
+    return;
+  }
+
+  XTime now;
+  XTime_GetTime(&now);
+  if (now - ack_first_held >=
+          (XTime)ack_deadline_ms * (COUNTS_PER_SECOND / 1000) &&
+      ack_range_flush()) {
+    ack_stats.deadline_flushes++;
+  }
+}
+
+u16_t ack_range_command(const char *args, const ip_addr_t *addr, u16_t port,
+                        u8_t sequence, char *reply, u16_t reply_size) {
+  if (strncmp(args, "EACH", 4) == 0) {
+    ack_range_flush();
+    ack_mode = ACK_MODE_EACH;
+    return 0;
+  } else if (strncmp(args, "RANGE", 5) == 0) {
+    /* ACKMODE RANGE [count] [deadline_ms] */
+    char *end;
+    const char *cursor = args + 5;
+    u32_t count = strtoul(cursor, &end, 0);
+    if (end != cursor) {
+      cursor = end;
+      u32_t deadline = strtoul(cursor, &end, 0);
+      if (count == 0 || count > 255 || (end != cursor && deadline == 0)) {
+        return snprintf(reply, reply_size,
+                        "ACKMODE error: usage ACKMODE EACH | RANGE "
+                        "[count 1-255] [deadline_ms >= 1]");
+      }
+      ack_count_limit = (u16_t)count;
+      if (end != cursor) {
+        ack_deadline_ms = deadline;
+      }
+    }
+
+    /* Held ids belong to the previous destination */
+    if (!ack_range_active(addr, port) && !ack_range_flush()) {
+      ack_range_count = 0;
+      ack_held = 0;
+    }
+    ack_dest_ip = *addr;
+    ack_dest_port = port;
+    ack_mode = ACK_MODE_RANGE;
+    return 0;
+  }
+
+  return snprintf(reply, reply_size,
+                  "ACKMODE %s count=%d deadline_ms=%lu held=%d ids=%lu "
+                  "datagrams=%lu count_flushes=%lu deadline_flushes=%lu "
+                  "send_failures=%lu",
+                  ack_mode == ACK_MODE_RANGE ? "range" : "each",
+                  ack_count_limit, (unsigned long)ack_deadline_ms, ack_held,
+                  (unsigned long)ack_stats.ids,
+                  (unsigned long)ack_stats.datagrams,
+                  (unsigned long)ack_stats.count_flushes,
+                  (unsigned long)ack_stats.deadline_flushes,
+                  (unsigned long)ack_stats.send_failures);
+}
@@ -0,0 +1,44 @@
+/*
+ * Ack Range Header
+ * Coalesced acknowledgements: one datagram acks a set of command ids
+ */
+
+#ifndef __ACK_RANGE_H_
+#define __ACK_RANGE_H_
+
+#include "data_transfer.h"
+
+/* Coalescing limits */
+#define ACK_RANGE_MAX_RANGES 32          // Disjoint id runs per datagram
+#define ACK_RANGE_DEFAULT_COUNT 64       // Flush once this many ids are held
+#define ACK_RANGE_DEFAULT_DEADLINE_MS 20 // Oldest held id waits at most this
+
+/* One inclusive run of command sequence numbers; last < first wraps at 255.
+ * A MSG_TYPE_ACK_RANGE data field is a u8 range count, a reserved byte and
+ * that many ranges. */
+typedef struct {
+  u8_t first;
+  u8_t last;
+} ack_range_t;
+
+typedef enum {
+  ACK_MODE_EACH = 0, // One RESPONSE per command, as before
+  ACK_MODE_RANGE     // Plain acks held and sent as MSG_TYPE_ACK_RANGE
+} ack_mode_t;
+
+typedef struct {
+  u32_t ids;       // Command ids acknowledged through ranges
+  u32_t datagrams; // MSG_TYPE_ACK_RANGE messages sent
+  u32_t count_flushes;
+  u32_t deadline_flushes;
+  u32_t send_failures;
+} ack_range_stats_t;
+
+/* Function prototypes */
+int ack_range_active(const ip_addr_t *addr, u16_t port);
+void ack_range_add(const ip_addr_t *addr, u16_t port, u8_t sequence);
+void ack_range_poll(void);
+u16_t ack_range_command(const char *args, const ip_addr_t *addr, u16_t port,
+                        u8_t sequence, char *reply, u16_t reply_size);
+
+#endif /* __ACK_RANGE_H_ */
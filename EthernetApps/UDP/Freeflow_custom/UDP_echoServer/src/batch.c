@@ -0,0 +1,234 @@
+/*
+ * Batch Implementation
+ * Runs a MSG_TYPE_BATCH list of register reads, writes, masked writes, polls
+ * and delays in order and answers with every result in one
+ * MSG_TYPE_BATCH_RESULT, so bringing up a peripheral costs one round trip
+ * instead of one per access. Only the regions below may be touched.
+ */
+
+#include "batch.h"
+#include "ack_range.h"
+#include "reply_cache.h"
+#include "send_queue.h"
+#include <string.h>
+
+static const batch_region_t batch_regions[] = {
+    {0x40000000, 0x80000000, "M_AXI_GP0"}, // PL peripherals
+    {0x80000000, 0xC0000000, "M_AXI_GP1"},
+    {0xE000A000, 0xE000B000, "GPIO"},      // PS GPIO, as used by i2c_access
+};
+
+static batch_stats_t batch_stats;
+
+static int batch_address_allowed(u32_t addr) {
+  if (addr & 3) {
+    return 0;
+  }
+  for (u16_t i = 0; i < sizeof(batch_regions) / sizeof(batch_regions[0]);
+       i++) {
+    if (addr >= batch_regions[i].base && addr < batch_regions[i].end) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static u32_t batch_elapsed_us(XTime since) {
+  XTime now;
+  XTime_GetTime(&now);
+  return (u32_t)((now - since) / (COUNTS_PER_SECOND / 1000000));
+}
+
+/* Waits are refused up front if they could push the batch over budget */
+static int batch_budget_ok(u32_t busy_us, u32_t wait_us) {
+  return busy_us <= BATCH_MAX_BUSY_US &&
+         wait_us <= BATCH_MAX_BUSY_US - busy_us;
+}
+
+/* Operand count for each opcode, 0 for unknown ones */
+static u8_t batch_operands(u8_t op) {
+  switch (op) {
+  case BATCH_OP_READ:
+  case BATCH_OP_DELAY:
+    return 1;
+  case BATCH_OP_WRITE:
+    return 2;
+  case BATCH_OP_MODIFY:
+    return 3;
+  case BATCH_OP_POLL:
+    return 4;
+  default:
+    return 0;
+  }
+}
+
+/* True if the batch only writes, modifies and waits: its results then tell
+ * the client nothing it did not send, apart from success */
+static int batch_writes_only(const wire_v1_view_t *msg, u16_t data_len) {
+  u16_t pos = 0;
+  while (pos < data_len) {
+    u8_t op = msg->data[pos];
+    if (op != BATCH_OP_WRITE && op != BATCH_OP_MODIFY && op != BATCH_OP_DELAY) {
+      return 0;
+    }
+    pos += 1 + batch_operands(op) * 4;
+  }
+  return 1;
+}
+
+/* A successful write-only batch is acked with the commands in ACKMODE
+ * RANGE; anything else answers with its BATCH_RESULT */
+static void batch_reply(const wire_v1_view_t *msg, u16_t data_len,
+                        const data_message_t *out, const ip_addr_t *addr,
+                        u16_t port) {
+  if (out->data[0] == BATCH_OK && ack_range_active(addr, port) &&
+      batch_writes_only(msg, data_len)) {
+    batch_stats.coalesced++;
+    ack_range_add(addr, port, msg->sequence);
+    return;
+  }
+  sendq_submit(out, SENDQ_RELIABLE, addr, port);
+}
+
+void batch_execute(const wire_v1_view_t *msg, u16_t data_len,
+                   const ip_addr_t *addr, u16_t port) {
+  data_message_t out;
+  batch_result_header_t hdr = {BATCH_OK, 0, 0, 0};
+  u8_t *results = &out.data[sizeof(hdr)];
+  u32_t busy_us = 0;
+  u16_t pos = 0;
+
+  /* A retransmit after a lost result must not write the registers again */
+  const reply_cache_entry_t *cached =
+      reply_cache_lookup(addr, port, msg, data_len);
+  if (cached != NULL) {
+    xil_printf("[UART] Duplicate batch %d, replying from cache\r\n",
+               msg->sequence);
+    out.msg_type = cached->reply_type;
+    out.sequence = msg->sequence;
+    out.length = cached->reply_len;
+    memcpy(out.data, cached->reply, cached->reply_len);
+    batch_reply(msg, data_len, &out, addr, port);
+    return;
+  }
+
+  while (pos < data_len && hdr.status == BATCH_OK) {
+    u8_t op = msg->data[pos];
+    u8_t operands = batch_operands(op);
+    u32_t arg[4];
+
+    if (operands == 0) {
+      hdr.status = BATCH_ERR_OPCODE;
+      break;
+    }
+    if (pos + 1 + operands * 4 > data_len) {
+      hdr.status = BATCH_ERR_TRUNCATED;
+      break;
+    }
+    memcpy(arg, &msg->data[pos + 1], operands * 4);
+    if (op != BATCH_OP_DELAY && !batch_address_allowed(arg[0])) {
+      hdr.status = BATCH_ERR_ADDRESS;
+      break;
+    }
+
+    u32_t result = 0;
+    switch (op) {
+    case BATCH_OP_READ:
+      result = Xil_In32(arg[0]);
+      break;
+    case BATCH_OP_WRITE:
+      Xil_Out32(arg[0], arg[1]);
+      result = arg[1];
+      break;
+    case BATCH_OP_MODIFY:
+      result = (Xil_In32(arg[0]) & ~arg[1]) | (arg[2] & arg[1]);
+      Xil_Out32(arg[0], result);
+      break;
+    case BATCH_OP_POLL: {
+      if (!batch_budget_ok(busy_us, arg[3])) {
+        hdr.status = BATCH_ERR_BUDGET;
+        break;
+      }
+      XTime start;
+      XTime_GetTime(&start);
+      u32_t waited;
+      for (;;) {
+        result = Xil_In32(arg[0]);
+        waited = batch_elapsed_us(start);
+        if ((result & arg[1]) == (arg[2] & arg[1])) {
+          break;
+        }
+        if (waited >= arg[3]) {
+          hdr.status = BATCH_ERR_POLL_TIMEOUT;
+          break;
+        }
+      }
+      busy_us += waited;
+      break;
+    }
+    case BATCH_OP_DELAY: {
+      if (!batch_budget_ok(busy_us, arg[0])) {
+        hdr.status = BATCH_ERR_BUDGET;
+        break;
+      }
+      XTime start;
+      XTime_GetTime(&start);
+      while (batch_elapsed_us(start) < arg[0]) {
+      }
+      busy_us += arg[0];
+      break;
+    }
+    }
+
+    /* A timed-out poll still reports the last value it read */
+    if (hdr.status == BATCH_OK || hdr.status == BATCH_ERR_POLL_TIMEOUT) {
+      memcpy(&results[hdr.ops_done * 4], &result, 4);
+    }
+    if (hdr.status == BATCH_OK) {
+      hdr.ops_done++;
+      pos += 1 + operands * 4;
+    }
+  }
+
+  batch_stats.batches++;
+  batch_stats.ops += hdr.ops_done;
+  batch_stats.last_status = hdr.status;
+  if (hdr.status != BATCH_OK) {
+    batch_stats.failures++;
+    xil_printf("[ERROR] Batch %d stopped at operation %d: status %d\r\n",
+               msg->sequence, hdr.ops_done, hdr.status);
+  }
+
+  /* Results of completed operations, plus the failing poll's last read */
+  hdr.busy_us = busy_us;
+  u16_t result_count =
+      hdr.ops_done + (hdr.status == BATCH_ERR_POLL_TIMEOUT ? 1 : 0);
+  out.msg_type = MSG_TYPE_BATCH_RESULT;
+  out.sequence = msg->sequence;
+  out.length = sizeof(hdr) + result_count * 4;
+  memcpy(out.data, &hdr, sizeof(hdr));
+  reply_cache_store(addr, port, msg, data_len, out.msg_type, out.data,
+                    out.length);
+  batch_reply(msg, data_len, &out, addr, port);
+}
+
+u16_t batch_command(const char *args, const ip_addr_t *addr, u16_t port,
+                    u8_t sequence, char *reply, u16_t reply_size) {
+  int len = snprintf(reply, reply_size,
+                     "BATCH batches=%lu ops=%lu failures=%lu coalesced=%lu "
+                     "last_status=%d max_busy_us=%d regions:",
+                     (unsigned long)batch_stats.batches,
+                     (unsigned long)batch_stats.ops,
+                     (unsigned long)batch_stats.failures,
+                     (unsigned long)batch_stats.coalesced,
+                     batch_stats.last_status, BATCH_MAX_BUSY_US);
+  for (u16_t i = 0; i < sizeof(batch_regions) / sizeof(batch_regions[0]) &&
+                    len < reply_size;
+       i++) {
+    len += snprintf(reply + len, reply_size - len, " %s=0x%08lx-0x%08lx",
+                    batch_regions[i].name,
+                    (unsigned long)batch_regions[i].base,
+                    (unsigned long)(batch_regions[i].end - 1));
+  }
+  return len < reply_size ? len : reply_size - 1;
+}
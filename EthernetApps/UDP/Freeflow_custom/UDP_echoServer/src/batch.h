@@ -0,0 +1,70 @@
+/*
+ * Batch Header
+ * Register operation scripts executed on the board in one round trip
+ */
+
+#ifndef __BATCH_H_
+#define __BATCH_H_
+
+#include "data_transfer.h"
+#include "xil_io.h"
+
+/* Total poll and delay time per batch. Polls and delays busy-wait inside
+ * the lwIP receive callback, so for that long nothing is received, the
+ * GEM ring can overrun and no timer runs. The cap stays far below the
+ * 200 ms minimum keepalive RTO and the client's 5 s heartbeat; longer
+ * bring-up sequences are split across batches. */
+#define BATCH_MAX_BUSY_US 20000
+
+/* Operations in a MSG_TYPE_BATCH data field, back to back, each an opcode
+ * byte followed by little-endian u32 operands */
+typedef enum {
+  BATCH_OP_READ = 0x01,   // addr                          -> value
+  BATCH_OP_WRITE = 0x02,  // addr, value                   -> value
+  BATCH_OP_MODIFY = 0x03, // addr, mask, value             -> value written
+  BATCH_OP_POLL = 0x04,   // addr, mask, value, timeout_us -> last value read
+  BATCH_OP_DELAY = 0x05   // delay_us                      -> 0
+} batch_op_t;
+
+typedef enum {
+  BATCH_OK = 0,
+  BATCH_ERR_TRUNCATED,    // Operands run past the end of the message
+  BATCH_ERR_OPCODE,
+  BATCH_ERR_ADDRESS,      // Unaligned or outside the allowed regions
+  BATCH_ERR_POLL_TIMEOUT,
+  BATCH_ERR_BUDGET        // Waits would exceed BATCH_MAX_BUSY_US
+} batch_status_t;
+
+/* Start of the MSG_TYPE_BATCH_RESULT data field; one u32 result per
+ * executed operation follows. Execution stops at the first failing
+ * operation, whose index is ops_done. The shortest operation is 5 bytes,
+ * so the results of a full request always fit in the reply. */
+typedef struct {
+  u8_t status; // batch_status_t
+  u8_t ops_done;
+  u16_t reserved;
+  u32_t busy_us; // Time spent in polls and delays
+} batch_result_header_t;
+
+/* Register windows a batch may touch */
+typedef struct {
+  UINTPTR base;
+  UINTPTR end; // Exclusive
+  const char *name;
+} batch_region_t;
+
+typedef struct {
+  u32_t batches;
+  u32_t ops;
+  u32_t failures;
+  u32_t coalesced; // Write-only batches acked through ACKMODE RANGE
+  u8_t last_status;
+} batch_stats_t;
+
+/* Function prototypes */
+void batch_execute(const wire_v1_view_t *msg, u16_t data_len,
+                   const ip_addr_t *addr, u16_t port);
+u16_t batch_command(const char *args, const ip_addr_t *addr, u16_t port,
+                    u8_t sequence, char *reply, u16_t reply_size);
+
+#endif /* __BATCH_H_ */
@@ -0,0 +1,65 @@
+/*
+ * Blob Service Implementation
+ * Blobs from the client are checked with CRC32C and dropped; BLOB SEND
+ * sends one of pseudo-random bytes back. Both CRCs are in the BLOB reply,
+ * so the client can compare them with its own end to end.
+ */
+
+#include "blob.h"
+#include "crc32c.h"
+#include <stdlib.h>
+#include <string.h>
+
+static u8_t blob_tx[BLOB_MAX]; // Read by the channel until the send ends
+static blob_stats_t blob_stats;
+
+void blob_deliver(const u8_t *data, u32_t length, const ip_addr_t *addr,
+                  u16_t port) {
+  blob_stats.rx_blobs++;
+  blob_stats.rx_length = length;
+  blob_stats.rx_crc = crc32c(0, data, length);
+  xil_printf("[INFO] Blob of %lu bytes received from %s:%d, crc32c "
+             "0x%08lx\r\n",
+             (unsigned long)length, inet_ntoa(*addr), port,
+             (unsigned long)blob_stats.rx_crc);
+}
+
+u16_t blob_command(const char *args, const ip_addr_t *addr, u16_t port,
+                   u8_t sequence, char *reply, u16_t reply_size) {
+  if (strncmp(args, "SEND", 4) == 0) {
+    /* BLOB SEND <bytes> */
+    u32_t length = strtoul(args + 4, NULL, 0);
+    if (length == 0 || length > BLOB_MAX) {
+      return snprintf(reply, reply_size, "BLOB error: SEND needs 1-%d bytes",
+                      BLOB_MAX);
+    }
+    if (rchan_tx_busy()) {
+      return snprintf(reply, reply_size,
+                      "BLOB error: a reliable transfer is running");
+    }
+
+    /* xorshift32, seeded per blob so consecutive ones differ */
+    u32_t x = 0x9E3779B9u ^ (blob_stats.tx_blobs + 1);
+    for (u32_t i = 0; i < length; i++) {
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      blob_tx[i] = (u8_t)x;
+    }
+    blob_stats.tx_blobs++;
+    blob_stats.tx_length = length;
+    blob_stats.tx_crc = crc32c(0, blob_tx, length);
+    rchan_send(RCHAN_SERVICE_BLOB, blob_tx, length, addr, port);
+    return 0;
+  }
+
+  return snprintf(reply, reply_size,
+                  "BLOB rx_blobs=%lu rx_length=%lu rx_crc=0x%08lx "
+                  "tx_blobs=%lu tx_length=%lu tx_crc=0x%08lx",
+                  (unsigned long)blob_stats.rx_blobs,
+                  (unsigned long)blob_stats.rx_length,
+                  (unsigned long)blob_stats.rx_crc,
+                  (unsigned long)blob_stats.tx_blobs,
+                  (unsigned long)blob_stats.tx_length,
+                  (unsigned long)blob_stats.tx_crc);
+}
@@ -0,0 +1,28 @@
+/*
+ * Blob Service Header
+ * Test transfers over the reliable channel, in both directions
+ */
+
+#ifndef __BLOB_H_
+#define __BLOB_H_
+
+#include "rchan.h"
+
+#define BLOB_MAX RCHAN_RX_MAX // Largest blob sent by BLOB SEND
+
+typedef struct {
+  u32_t rx_blobs;
+  u32_t rx_length; // Last blob received
+  u32_t rx_crc;
+  u32_t tx_blobs;
+  u32_t tx_length; // Last blob sent
+  u32_t tx_crc;
+} blob_stats_t;
+
+/* Function prototypes */
+void blob_deliver(const u8_t *data, u32_t length, const ip_addr_t *addr,
+                  u16_t port);
+u16_t blob_command(const char *args, const ip_addr_t *addr, u16_t port,
+                   u8_t sequence, char *reply, u16_t reply_size);
+
+#endif /* __BLOB_H_ */
@@ -0,0 +1,181 @@
+/*
+ * Container Implementation
+ * With PACK ON, small messages for the client that asked (UART lines, acks,
+ * heartbeats, telemetry records) are not sent one datagram each. They are
+ * appended to an open container that goes out when the next message no
+ * longer fits or the oldest one has waited out the deadline, so the packet
+ * rate, and the per-packet lwIP, GEM and client overhead, drops several-fold
+ * for the same message rate.
+ */
+
+#include "container.h"
+#include "send_queue.h"
+#include <stdlib.h>
+#include <string.h>
+
+static u8_t pack_enabled;
+static ip_addr_t pack_dest_ip;
+static u16_t pack_dest_port;
+static u32_t pack_deadline_ms = CONTAINER_DEFAULT_DEADLINE_MS;
+
+/* Container being filled */
+static data_message_t pack_msg;
+static u8_t pack_count;
+static u8_t pack_reliable; // Any reliable sub-message makes it reliable
+static XTime pack_first;
+
+static container_stats_t pack_stats;
+
+/* Returns 0 if the container could not be queued; its contents stay held */
+static int container_flush(void) {
+  if (pack_count == 0) {
+    return 1;
+  }
+
+  pack_msg.msg_type = MSG_TYPE_CONTAINER;
+  pack_msg.sequence = sequence_counter++;
+  if (sendq_submit(&pack_msg,
+                   pack_reliable ? SENDQ_RELIABLE : SENDQ_TELEMETRY,
+                   &pack_dest_ip, pack_dest_port) != ERR_OK) {
+    pack_stats.send_failures++;
+    return 0;
+  }
+
+  pack_stats.containers++;
+  pack_msg.length = 0;
+  pack_count = 0;
+  pack_reliable = 0;
+  return 1;
+}
+
+/* Takes msg into the open container; returns 0 if it must be sent alone */
+int container_add(const data_message_t *msg, u8_t reliable,
+                  const ip_addr_t *addr, u16_t port) {
+  if (!pack_enabled || pack_dest_port != port ||
+      !ip_addr_cmp(&pack_dest_ip, addr) ||
+      msg->msg_type == MSG_TYPE_CONTAINER || msg->msg_type == MSG_TYPE_FEC) {
+    return 0; // FEC messages need a datagram each to be lost independently
+  }
+
+  /* A message sent alone goes behind what is already packed, so the
+   * client sees both in the order they were submitted */
+  u16_t size = DATA_HEADER_SIZE + msg->length;
+  if (size > CONTAINER_MAX_SUB_SIZE) {
+    if (pack_count > 0 && container_flush()) {
+      pack_stats.order_flushes++;
+    }
+    pack_stats.bypassed++;
+    return 0;
+  }
+  if (pack_msg.length + size > sizeof(pack_msg.data)) {
+    if (!container_flush()) {
+      pack_stats.bypassed++;
+      return 0;
+    }
+    pack_stats.full_flushes++;
+  }
+
+  if (pack_count == 0) {
+    XTime_GetTime(&pack_first);
+  }
+  wire_v1_encode(&pack_msg.data[pack_msg.length], msg->msg_type,
+                 msg->sequence, msg->length);
+  memcpy(&pack_msg.data[pack_msg.length + DATA_HEADER_SIZE], msg->data,
+         msg->length);
+  pack_msg.length += size;
+  pack_count++;
+  pack_reliable |= reliable;
+  pack_stats.messages++;
+  return 1;
+}
+
+void container_poll(void) {
+  if (pack_count == 0) {
+    return;
+  }
+
+  XTime now;
+  XTime_GetTime(&now);
+  if (now - pack_first >=
+          (XTime)pack_deadline_ms * (COUNTS_PER_SECOND / 1000) &&
+      container_flush()) {
+    pack_stats.deadline_flushes++;
+  }
+}
+
+/* Points sub at the sub-message at offset and returns the offset of the
+ * next one, or 0 once the container is exhausted or malformed */
+u16_t container_next(const wire_v1_view_t *container, u16_t offset,
+                     wire_v1_view_t *sub) {
+  if (offset == 0) {
+    pack_stats.rx_containers++;
+  }
+  if (offset + DATA_HEADER_SIZE > container->length) {
+    return 0;
+  }
+
+  if (wire_v1_decode(&container->data[offset], container->length - offset,
+                     sub) != WIRE_OK ||
+      sub->msg_type == MSG_TYPE_CONTAINER) {
+    xil_printf("[ERROR] Malformed container sub-message at offset %d\r\n",
+               offset);
+    pack_stats.rx_errors++;
+    return 0;
+  }
+  pack_stats.rx_messages++;
+  return offset + DATA_HEADER_SIZE + sub->length;
+}
+
+u16_t container_command(const char *args, const ip_addr_t *addr, u16_t port,
+                        u8_t sequence, char *reply, u16_t reply_size) {
+  if (strncmp(args, "OFF", 3) == 0) {
+    container_flush();
+    pack_enabled = 0;
+    return 0;
+  } else if (strncmp(args, "ON", 2) == 0) {
+    /* PACK ON [deadline_ms] */
+    char *end;
+    u32_t deadline = strtoul(args + 2, &end, 0);
+    if (end != args + 2) {
+      if (deadline == 0) {
+        return snprintf(reply, reply_size,
+                        "PACK error: usage PACK ON [deadline_ms >= 1] | OFF");
+      }
+      pack_deadline_ms = deadline;
+    }
+
+    /* Packed messages belong to the previous destination */
+    if (pack_enabled && (pack_dest_port != port ||
+                         !ip_addr_cmp(&pack_dest_ip, addr)) &&
+        !container_flush()) {
+      pack_msg.length = 0;
+      pack_count = 0;
+      pack_reliable = 0;
+    }
+    pack_dest_ip = *addr;
+    pack_dest_port = port;
+    pack_enabled = 1;
+    return 0;
+  }
+
+  return snprintf(
+      reply, reply_size,
+      "PACK %s deadline_ms=%lu open=%d containers=%lu messages=%lu "
+      "per_container=%lu full_flushes=%lu deadline_flushes=%lu "
+      "order_flushes=%lu bypassed=%lu send_failures=%lu rx_containers=%lu "
+      "rx_messages=%lu rx_errors=%lu",
+      pack_enabled ? "on" : "off", (unsigned long)pack_deadline_ms,
+      pack_count, (unsigned long)pack_stats.containers,
+      (unsigned long)pack_stats.messages,
+      (unsigned long)(pack_stats.containers
+                          ? pack_stats.messages / pack_stats.containers
+                          : 0),
+      (unsigned long)pack_stats.full_flushes,
+      (unsigned long)pack_stats.deadline_flushes,
+      (unsigned long)pack_stats.order_flushes,
+      (unsigned long)pack_stats.bypassed,
+      (unsigned long)pack_stats.send_failures,
+      (unsigned long)pack_stats.rx_containers,
+      (unsigned long)pack_stats.rx_messages,
+      (unsigned long)pack_stats.rx_errors);
+}
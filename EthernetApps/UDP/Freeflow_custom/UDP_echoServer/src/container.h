@@ -0,0 +1,42 @@
+/*
+ * Container Header
+ * Several small messages packed into one MSG_TYPE_CONTAINER datagram
+ */
+
+#ifndef __CONTAINER_H_
+#define __CONTAINER_H_
+
+#include "data_transfer.h"
+
+/* Packing limits */
+#define CONTAINER_MAX_SUB_SIZE 256      // Larger messages are sent on their own
+#define CONTAINER_DEFAULT_DEADLINE_MS 5 // Oldest packed message waits at most
+
+/* A MSG_TYPE_CONTAINER data field is a run of sub-messages, each a v1
+ * header (msg_type, sequence, u16 length) followed by exactly length bytes,
+ * so the header's length field prefixes every payload. Containers do not
+ * nest. */
+
+typedef struct {
+  u32_t containers;   // MSG_TYPE_CONTAINER datagrams sent
+  u32_t messages;     // Sub-messages packed into them
+  u32_t full_flushes; // Flushed because the next message did not fit
+  u32_t deadline_flushes;
+  u32_t order_flushes; // Flushed so a larger message cannot overtake it
+  u32_t bypassed;     // Too large, or the full container could not be sent
+  u32_t send_failures;
+  u32_t rx_containers;
+  u32_t rx_messages;
+  u32_t rx_errors;    // Sub-messages that ran past the container's end
+} container_stats_t;
+
+/* Function prototypes */
+int container_add(const data_message_t *msg, u8_t reliable,
+                  const ip_addr_t *addr, u16_t port);
+void container_poll(void);
+u16_t container_next(const wire_v1_view_t *container, u16_t offset,
+                     wire_v1_view_t *sub);
+u16_t container_command(const char *args, const ip_addr_t *addr, u16_t port,
+                        u8_t sequence, char *reply, u16_t reply_size);
+
+#endif /* __CONTAINER_H_ */
@@ -0,0 +1,87 @@
+/*
+ * CRC32C Implementation
+ * Slice-by-8: eight 256-entry tables let each step fold 8 input bytes with
+ * eight lookups instead of one lookup per byte. The Cortex-A9 has neither
+ * CRC instructions nor a 64-bit carry-less multiply, so NEON cannot beat
+ * the tables here. crc32c(0, ...) starts a CRC; passing the result back in
+ * continues it over the next buffer.
+ */
+
+#include "crc32c.h"
+#include <stdint.h>
+#include <string.h>
+
+static u32_t crc32c_table[8][256]; // Filled by crc32c_init
+static u32_t crc32c_bench_ns;      // Last CRC BENCH result, per KB
+
+void crc32c_init(void) {
+  for (u32_t n = 0; n < 256; n++) {
+    u32_t crc = n;
+    for (int k = 0; k < 8; k++) {
+      crc = (crc >> 1) ^ (CRC32C_POLY & (0u - (crc & 1)));
+    }
+    crc32c_table[0][n] = crc;
+  }
+  for (u32_t n = 0; n < 256; n++) {
+    for (int t = 1; t < 8; t++) {
+      u32_t prev = crc32c_table[t - 1][n];
+      crc32c_table[t][n] = (prev >> 8) ^ crc32c_table[0][prev & 0xFF];
+    }
+  }
+}
+
+u32_t crc32c(u32_t crc, const void *buf, u32_t len) {
+  const u8_t *p = (const u8_t *)buf;
+  crc = ~crc;
+
+  /* Bytewise up to an 8-byte boundary, then 8 bytes per step */
+  while (len > 0 && ((uintptr_t)p & 7) != 0) {
+    crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *p++) & 0xFF];
+    len--;
+  }
+  while (len >= 8) {
+    u32_t lo, hi;
+    memcpy(&lo, p, 4); // Little-endian on the Zynq
+    memcpy(&hi, p + 4, 4);
+    lo ^= crc;
+    crc = crc32c_table[7][lo & 0xFF] ^ crc32c_table[6][(lo >> 8) & 0xFF] ^
+          crc32c_table[5][(lo >> 16) & 0xFF] ^ crc32c_table[4][lo >> 24] ^
+          crc32c_table[3][hi & 0xFF] ^ crc32c_table[2][(hi >> 8) & 0xFF] ^
+          crc32c_table[1][(hi >> 16) & 0xFF] ^ crc32c_table[0][hi >> 24];
+    p += 8;
+    len -= 8;
+  }
+  while (len > 0) {
+    crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *p++) & 0xFF];
+    len--;
+  }
+
+  return ~crc;
+}
+
+u16_t crc32c_command(const char *args, const ip_addr_t *addr, u16_t port,
+                     u8_t sequence, char *reply, u16_t reply_size) {
+  /* CRC BENCH: cost of one KB, measured over a full data_message_t */
+  if (strncmp(args, "BENCH", 5) == 0) {
+    static u8_t bench_buf[CRC32C_BENCH_BYTES];
+    for (u32_t i = 0; i < sizeof(bench_buf); i++) {
+      bench_buf[i] = (u8_t)(i * 7);
+    }
+    volatile u32_t sink = 0;
+    XTime start, end;
+    XTime_GetTime(&start);
+    for (int r = 0; r < CRC32C_BENCH_ROUNDS; r++) {
+      sink = crc32c(sink, bench_buf, sizeof(bench_buf));
+    }
+    XTime_GetTime(&end);
+    crc32c_bench_ns = (u32_t)((end - start) * 1000000000ULL /
+                              COUNTS_PER_SECOND / CRC32C_BENCH_ROUNDS);
+  }
+
+  /* The standard check value: crc32c("123456789") == 0xE3069283 */
+  return snprintf(reply, reply_size,
+                  "CRC crc32c slice-by-8 check=0x%08lx ns_per_kb=%lu%s",
+                  (unsigned long)crc32c(0, "123456789", 9),
+                  (unsigned long)crc32c_bench_ns,
+                  crc32c_bench_ns == 0 ? " (run CRC BENCH)" : "");
+}
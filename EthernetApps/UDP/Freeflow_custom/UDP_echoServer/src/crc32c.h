@@ -0,0 +1,22 @@
+/*
+ * CRC32C Header
+ * Castagnoli CRC for message trailers, computed slice-by-8
+ */
+
+#ifndef __CRC32C_H_
+#define __CRC32C_H_
+
+#include "data_transfer.h"
+
+#define CRC32C_POLY 0x82F63B78 // Reflected Castagnoli polynomial
+#define CRC32C_SIZE 4          // Trailer bytes, little-endian
+#define CRC32C_BENCH_BYTES 1024
+#define CRC32C_BENCH_ROUNDS 256
+
+/* Function prototypes */
+void crc32c_init(void);
+u32_t crc32c(u32_t crc, const void *buf, u32_t len);
+u16_t crc32c_command(const char *args, const ip_addr_t *addr, u16_t port,
+                     u8_t sequence, char *reply, u16_t reply_size);
+
+#endif /* __CRC32C_H_ */
@@ -0,0 +1,148 @@
+/*
+ * Credit Implementation
+ * A client whose GUI thread stalls stops reading its socket, and the kernel
+ * drops whatever no longer fits, unseen by the board. With credit the client
+ * grants room as it reads: streaming messages beyond the grant stay in the
+ * send queue, where the oldest give way to newer ones and are counted, and
+ * go out as soon as more credit arrives. Responses and other reliable
+ * messages spend credit but never wait for it.
+ */
+
+#include "credit.h"
+#include "keepalive.h"
+#include "proto.h"
+#include <string.h>
+
+static u8_t credit_enabled;
+static ip_addr_t credit_dest_ip;
+static u16_t credit_dest_port;
+static u32_t credit_sent_messages;
+static u32_t credit_sent_bytes;
+static u32_t credit_limit_messages;
+static u32_t credit_limit_bytes;
+static u8_t credit_paused;
+static u8_t credit_probe_due;
+static XTime credit_last_probe;
+
+static credit_stats_t credit_stats;
+
+static int credit_for(const ip_addr_t *addr, u16_t port) {
+  return credit_enabled && credit_dest_port == port &&
+         ip_addr_cmp(&credit_dest_ip, addr);
+}
+
+static u16_t credit_size(const data_message_t *msg) {
+  return DATA_HEADER_SIZE + msg->length;
+}
+
+/* True if a streaming msg must wait for more credit. Counts wrap, so they
+ * are compared by their difference. */
+int credit_blocked(const data_message_t *msg, u8_t reliable,
+                   const ip_addr_t *addr, u16_t port) {
+  if (reliable || !credit_for(addr, port)) {
+    return 0;
+  }
+  if ((s32_t)(credit_limit_messages - credit_sent_messages) >= 1 &&
+      (s32_t)(credit_limit_bytes - credit_sent_bytes) >=
+          (s32_t)credit_size(msg)) {
+    return 0;
+  }
+  if (!credit_paused) {
+    credit_paused = 1;
+    credit_stats.pauses++;
+    credit_probe_due = 1; // Probe on the next poll
+  }
+  return 1;
+}
+
+void credit_spend(const data_message_t *msg, const ip_addr_t *addr,
+                  u16_t port) {
+  if (credit_for(addr, port)) {
+    credit_sent_messages++;
+    credit_sent_bytes += credit_size(msg);
+  }
+}
+
+/* Counts a streaming message that waits in the send queue for credit */
+void credit_held(void) { credit_stats.held++; }
+
+/* Takes a grant from the client; a RESET grant turns credit on for it */
+void credit_receive(const wire_v1_view_t *msg, const ip_addr_t *addr,
+                    u16_t port) {
+  credit_msg_t grant;
+  if (msg->length < sizeof(grant)) {
+    return;
+  }
+  memcpy(&grant, msg->data, sizeof(grant));
+
+  if (grant.flags & CREDIT_FLAG_RESET) {
+    credit_enabled = 1;
+    credit_dest_ip = *addr;
+    credit_dest_port = port;
+    credit_sent_messages = 0;
+    credit_sent_bytes = 0;
+  } else if (!credit_for(addr, port)) {
+    return;
+  }
+  credit_limit_messages = grant.messages;
+  credit_limit_bytes = grant.bytes;
+  credit_paused = 0;
+  credit_stats.grants++;
+}
+
+/* While paused, asks the client for a grant once per RTO, in case the grant
+ * that would have resumed the stream was lost */
+void credit_poll(void) {
+  if (!credit_enabled || !credit_paused) {
+    return;
+  }
+
+  XTime now;
+  XTime_GetTime(&now);
+  if (!credit_probe_due &&
+      now - credit_last_probe <
+          (XTime)keepalive_rto_ms() * (COUNTS_PER_SECOND / 1000)) {
+    return;
+  }
+
+  data_message_t msg;
+  credit_msg_t probe;
+  probe.messages = credit_sent_messages;
+  probe.bytes = credit_sent_bytes;
+  probe.flags = 0;
+  memset(probe.reserved, 0, sizeof(probe.reserved));
+  msg.msg_type = MSG_TYPE_CREDIT;
+  msg.sequence = 0;
+  msg.length = sizeof(probe);
+  memcpy(msg.data, &probe, sizeof(probe));
+
+  /* Straight to the wire: the probe must not wait behind what it unblocks */
+  if (proto_sendto(&msg, &credit_dest_ip, credit_dest_port) == ERR_OK) {
+    credit_stats.probes++;
+    credit_probe_due = 0;
+    credit_last_probe = now;
+  }
+}
+
+u16_t credit_command(const char *args, const ip_addr_t *addr, u16_t port,
+                     u8_t sequence, char *reply, u16_t reply_size) {
+  if (strncmp(args, "OFF", 3) == 0) {
+    credit_enabled = 0;
+    credit_paused = 0;
+    return 0;
+  }
+
+  return snprintf(reply, reply_size,
+                  "CREDIT %s%s sent=%lu/%lu bytes=%lu/%lu grants=%lu "
+                  "probes=%lu pauses=%lu held=%lu",
+                  credit_enabled ? "on" : "off",
+                  credit_paused ? " paused" : "",
+                  (unsigned long)credit_sent_messages,
+                  (unsigned long)credit_limit_messages,
+                  (unsigned long)credit_sent_bytes,
+                  (unsigned long)credit_limit_bytes,
+                  (unsigned long)credit_stats.grants,
+                  (unsigned long)credit_stats.probes,
+                  (unsigned long)credit_stats.pauses,
+                  (unsigned long)credit_stats.held);
+}
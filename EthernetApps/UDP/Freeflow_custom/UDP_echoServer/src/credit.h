@@ -0,0 +1,46 @@
+/*
+ * Credit Header
+ * Receiver-granted flow control: the client grants message and byte credit,
+ * and streaming messages to it wait on the board once that runs out
+ */
+
+#ifndef __CREDIT_H_
+#define __CREDIT_H_
+
+#include "data_transfer.h"
+
+#define CREDIT_FLAG_RESET 0x01 // Grant: start counting from zero
+
+/* MSG_TYPE_CREDIT data, both ways. From the client it is a grant: the board
+ * may send while its counts stay below the limits. From a paused board it
+ * is a probe carrying the counts themselves; the client answers with a
+ * grant based on them, which also returns the credit of lost datagrams.
+ * Counts cover every message sent through the send queue to the client:
+ * one per datagram, and DATA_HEADER_SIZE + length bytes for each. */
+typedef struct {
+  u32_t messages; // Grant: limit; probe: sent so far
+  u32_t bytes;
+  u8_t flags;
+  u8_t reserved[3];
+} credit_msg_t;
+
+typedef struct {
+  u32_t grants;
+  u32_t probes;
+  u32_t pauses;   // Times the stream ran out of credit
+  u32_t held;     // Streaming messages that had to wait for credit
+} credit_stats_t;
+
+/* Function prototypes */
+int credit_blocked(const data_message_t *msg, u8_t reliable,
+                   const ip_addr_t *addr, u16_t port);
+void credit_spend(const data_message_t *msg, const ip_addr_t *addr,
+                  u16_t port);
+void credit_held(void);
+void credit_receive(const wire_v1_view_t *msg, const ip_addr_t *addr,
+                    u16_t port);
+void credit_poll(void);
+u16_t credit_command(const char *args, const ip_addr_t *addr, u16_t port,
+                     u8_t sequence, char *reply, u16_t reply_size);
+
+#endif /* __CREDIT_H_ */
@@ -4,6 +4,28 @@
  */
 
 #include "data_transfer.h"
+#include "ack_range.h"
+#include "batch.h"
+#include "blob.h"
+#include "container.h"
+#include "crc32c.h"
+#include "credit.h"
+#include "deferred_work.h"
+#include "fec.h"
+#include "flight_recorder.h"
+#include "fragment.h"
+#include "keepalive.h"
+#include "proto.h"
+#include "rchan.h"
+#include "reply_cache.h"
+#include "rx_sink.h"
+#include "rx_watchdog.h"
+#include "send_queue.h"
+#include "slab.h"
+#include "status_frame.h"
+#include "telemetry.h"
+#include "traffic_gen.h"
+#include <stdlib.h>
 #include <string.h>
 
 /* Global variables */
@@ -14,12 +36,92 @@ u16_t qt_client_port = 0;
 u8_t sequence_counter = 0;
 // u32_t last_send_time = 0; // Removed - using counter instead
 
-/* Sample data to send */
-static const char *sample_data[] = {"Hello from Zynq!", "Temperature: 45.2°C",
-                                    "Voltage: 3.3V",    "Status: Running",
-                                    "Memory: 85% used", "Network: Connected",
-                                    "CPU Load: 67%",    "System Time: Active"};
-static u8_t sample_data_index = 0;
+/* Channels sent by exception: on change beyond the deadband or after the
+ * maximum silence. Counter channels are refreshed from stats before each
+ * check, the others are set through report_channel_set(). */
+static report_channel_t report_channels[REPORT_CHANNELS] = {
+    {"Temperature", "°C", 1, 452, 5, REPORT_DEFAULT_SILENCE_MS},
+    {"Voltage", "V", 2, 330, 5, REPORT_DEFAULT_SILENCE_MS},
+    {"Memory", "% used", 0, 85, 2, REPORT_DEFAULT_SILENCE_MS},
+    {"CPU Load", "%", 0, 67, 5, REPORT_DEFAULT_SILENCE_MS},
+    {"Packets RX", "", 0, 0, 100, REPORT_DEFAULT_SILENCE_MS},
+    {"Packets TX", "", 0, 0, 100, REPORT_DEFAULT_SILENCE_MS}};
+static u8_t report_enabled = 0; // Off until a client asks, keeps chat quiet
+static u32_t report_sent;
+static u32_t report_suppressed;
+
+static u16_t workq_command(const char *args, const ip_addr_t *addr,
+                           u16_t port, u8_t sequence, char *reply,
+                           u16_t reply_size) {
+  deferred_work_stats_t ws;
+  deferred_work_get_stats(&ws);
+  return snprintf(reply, reply_size,
+                  "WORKQ posted=%lu executed=%lu overflows=%lu max_depth=%lu",
+                  (unsigned long)ws.posted, (unsigned long)ws.executed,
+                  (unsigned long)ws.overflows, (unsigned long)ws.max_depth);
+}
+
+static u16_t rxwd_command(const char *args, const ip_addr_t *addr,
+                          u16_t port, u8_t sequence, char *reply,
+                          u16_t reply_size) {
+  if (strncmp(args, "EXPECT", 6) == 0) {
+    rx_watchdog_set_expected((u32_t)strtoul(args + 6, NULL, 0));
+    return 0;
+  }
+
+  const rxwd_stats_t *wd = rx_watchdog_stats();
+  int len = snprintf(reply, reply_size,
+                     "RXWD polls=%lu resets=%lu busy_stops=%lu frames=%lu "
+                     "rx_errors=%lu ewma=%lu expect_fps=%lu",
+                     (unsigned long)wd->polls, (unsigned long)wd->resets,
+                     (unsigned long)wd->busy_stops, (unsigned long)wd->frames,
+                     (unsigned long)wd->rx_errors,
+                     (unsigned long)(wd->frames_ewma >> 4),
+                     (unsigned long)wd->expect_fps);
+
+  /* Most recent resets first, as ms since boot and trigger reason */
+  u32_t logged = wd->resets < RXWD_LOG_SIZE ? wd->resets : RXWD_LOG_SIZE;
+  for (u32_t i = 0; i < logged && len < reply_size; i++) {
+    const rxwd_event_t *ev = &wd->log[(wd->resets - 1 - i) % RXWD_LOG_SIZE];
+    len += snprintf(reply + len, reply_size - len, " reset@%lums/r%d",
+                    (unsigned long)(ev->time / (COUNTS_PER_SECOND / 1000)),
+                    ev->reason);
+  }
+  return len < reply_size ? len : reply_size - 1;
+}
+
+static u16_t report_command(const char *args, const ip_addr_t *addr,
+                            u16_t port, u8_t sequence, char *reply,
+                            u16_t reply_size);
+
+/* Commands accepted in MSG_TYPE_COMMAND messages, matched on the first word.
+ * The flag marks commands that can change state: their replies are cached,
+ * so a retransmit gets the first reply instead of a second run. Pure
+ * queries are never cached and always answer with fresh values. */
+static const command_entry_t command_table[] = {
+    {"TGEN", tgen_command, 1},
+    {"SINK", sink_command, 1},
+    {"WORKQ", workq_command, 0},
+    {"RXWD", rxwd_command, 1},
+    {"QUEUE", sendq_command, 1},
+    {"AGG", agg_command, 1},
+    {"FREC", frec_command, 1},
+    {"REPORT", report_command, 1},
+    {"RCACHE", reply_cache_command, 1},
+    {"KEEPALIVE", keepalive_command, 0},
+    {"ACKMODE", ack_range_command, 1},
+    {"BATCH", batch_command, 0},
+    {"SLAB", slab_command, 0},
+    {"PROTO", proto_command, 1},
+    {"PACK", container_command, 1},
+    {"CRC", crc32c_command, 0},
+    {"FRAME", status_frame_command, 1},
+    {"FRAG", fragment_command, 1},
+    {"FEC", fec_command, 1},
+    {"RCHAN", rchan_command, 1},
+    {"BLOB", blob_command, 1},
+    {"CREDIT", credit_command, 1},
+};
 
 void print_app_header(void) {
   xil_printf("\r\n=== Data Transfer Application ===\r\n");
@@ -37,10 +139,13 @@ static void reset_statistics(void) {
   stats.last_sequence_received = 0;
   stats.last_packet_time = 0;
   stats.connection_timeout_counter = 0;
+  stats.resets++;
 }
 
 void init_data_transfer(void) {
   reset_statistics();
+  slab_init();
+  crc32c_init();
   IP4_ADDR(&qt_client_ip, 0, 0, 0, 0); // Will be set when first packet received
   qt_client_port = 0;
   sequence_counter = 0;
@@ -55,6 +160,7 @@ static void udp_data_recv(void *arg, struct udp_pcb *tpcb, struct pbuf *p,
       // First client connection
       qt_client_ip = *addr;
       qt_client_port = port;
+      keepalive_reset();
       xil_printf("[INFO] Qt client connected: %s:%d\r\n", inet_ntoa(*addr),
                  port);
     } else if (!ip_addr_cmp(&qt_client_ip, addr) || qt_client_port != port) {
@@ -64,6 +170,7 @@ static void udp_data_recv(void *arg, struct udp_pcb *tpcb, struct pbuf *p,
                  qt_client_port);
       qt_client_ip = *addr;
       qt_client_port = port;
+      keepalive_reset();
     }
 
     process_received_data(p, addr, port);
@@ -71,29 +178,71 @@ static void udp_data_recv(void *arg, struct udp_pcb *tpcb, struct pbuf *p,
   }
 }
 
-void process_received_data(struct pbuf *p, const ip_addr_t *addr, u16_t port) {
-  if (p->tot_len < sizeof(data_message_t)) {
-    xil_printf("[ERROR] Received packet too small: %d bytes\r\n", p->tot_len);
+/* Reply for commands without a handler; it carries nothing but the ack */
+static void plain_ack(u8_t sequence, char *reply, u16_t reply_size) {
+  snprintf(reply, reply_size, "Command %d processed", sequence);
+}
+
+/* Looks up the handler of a NUL-terminated command and where its arguments
+ * start; NULL for text that is not a known command */
+static const command_entry_t *find_command(const char *cmd,
+                                           const char **args) {
+  for (u16_t i = 0; i < sizeof(command_table) / sizeof(command_table[0]);
+       i++) {
+    size_t name_len = strlen(command_table[i].name);
+    if (strncmp(cmd, command_table[i].name, name_len) == 0 &&
+        (cmd[name_len] == ' ' || cmd[name_len] == '\0')) {
+      *args = &cmd[name_len];
+      while (**args == ' ') {
+        (*args)++;
+      }
+      return &command_table[i];
+    }
+  }
+  return NULL;
+}
+
+static void process_reassembled(const fragment_message_t *whole,
+                                const ip_addr_t *addr, u16_t port);
+
+static void process_message(const wire_v1_view_t *msg, const ip_addr_t *addr,
+                            u16_t port) {
+  u16_t data_len = msg->length;
+
+  // Any message proves the client is alive; heartbeats are answered here
+  keepalive_on_rx(msg, data_len, addr, port);
+
+  // Fragments are collected quietly; the message is handled once complete
+  if (msg->msg_type == MSG_TYPE_FRAGMENT) {
+    const fragment_message_t *whole = fragment_receive(msg, addr, port);
+    if (whole != NULL) {
+      process_reassembled(whole, addr, port);
+    }
     return;
   }
 
-  data_message_t *msg = (data_message_t *)p->payload;
+  // Reliable channel segments and SACKs are binary and far too many to print
+  if (msg->msg_type == MSG_TYPE_RCHAN_DATA ||
+      msg->msg_type == MSG_TYPE_RCHAN_SACK) {
+    rchan_receive(msg, addr, port);
+    return;
+  }
 
-  // Update statistics
-  stats.packets_received++;
-  stats.bytes_received += p->tot_len;
-  stats.last_packet_time = 0; // Simplified for now
-  stats.connection_timeout_counter =
-      0; // Reset timeout counter on received data
+  // Credit grants are taken in silence, like the datagrams they pace
+  if (msg->msg_type == MSG_TYPE_CREDIT) {
+    credit_receive(msg, addr, port);
+    return;
+  }
 
   // Display received data on UART terminal
   xil_printf("\r\n[UART] Received from %s:%d\r\n", inet_ntoa(*addr), port);
   xil_printf("[UART] Type: %d, Seq: %d, Len: %d\r\n", msg->msg_type,
              msg->sequence, msg->length);
 
-  if (msg->length > 0 && msg->length <= sizeof(msg->data)) {
+  // Batches are binary; everything else prints as text
+  if (data_len > 0 && msg->msg_type != MSG_TYPE_BATCH) {
     xil_printf("[UART] Data: ");
-    for (u16_t i = 0; i < msg->length; i++) {
+    for (u16_t i = 0; i < data_len; i++) {
       xil_printf("%c", msg->data[i]);
     }
     xil_printf("\r\n");
@@ -113,95 +262,295 @@ void process_received_data(struct pbuf *p, const ip_addr_t *addr, u16_t port) {
   case MSG_TYPE_HEARTBEAT:
     xil_printf("[UART] Heartbeat received\r\n");
     break;
+  case MSG_TYPE_BATCH:
+    xil_printf("[UART] Batch of %d bytes received\r\n", data_len);
+    batch_execute(msg, data_len, addr, port);
+    return;
   default:
     xil_printf("[UART] Unknown message type: %d\r\n", msg->msg_type);
     break;
   }
 
-  // Send acknowledgment if needed
+  // Run the command and send its reply
   if (msg->msg_type == MSG_TYPE_COMMAND) {
-    data_message_t ack_msg;
-    ack_msg.msg_type = MSG_TYPE_RESPONSE;
-    ack_msg.sequence = msg->sequence;
-    ack_msg.length = snprintf((char *)ack_msg.data, sizeof(ack_msg.data),
-                              "Command %d processed", msg->sequence);
-
-    struct pbuf *ack_pbuf =
-        pbuf_alloc(PBUF_TRANSPORT, sizeof(data_message_t), PBUF_RAM);
-    if (ack_pbuf != NULL) {
-      memcpy(ack_pbuf->payload, &ack_msg, sizeof(data_message_t));
-      udp_sendto(data_pcb, ack_pbuf, addr, port);
-      pbuf_free(ack_pbuf);
-
-      stats.packets_sent++;
-      stats.bytes_sent += sizeof(data_message_t);
+    char cmd[128];
+    u16_t cmd_len = data_len < sizeof(cmd) - 1 ? data_len : sizeof(cmd) - 1;
+    memcpy(cmd, msg->data, cmd_len);
+    cmd[cmd_len] = '\0';
+    const char *args = NULL;
+    const command_entry_t *entry = find_command(cmd, &args);
+    int cacheable = entry != NULL && entry->cached;
+
+    // A retransmit after a lost ack gets the stored reply, not a second run.
+    // Replies may run past one datagram and are fragmented on send.
+    static char reply[COMMAND_REPLY_SIZE];
+    const reply_cache_entry_t *cached =
+        cacheable ? reply_cache_lookup(addr, port, msg, data_len) : NULL;
+    u16_t text_len = 0;
+    if (cached != NULL) {
+      xil_printf("[UART] Duplicate command %d, replying from cache\r\n",
+                 msg->sequence);
+      text_len = cached->reply_len;
+      memcpy(reply, cached->reply, text_len);
+      reply[text_len] = '\0';
+    } else if (entry != NULL) {
+      if (entry->handler(args, addr, port, msg->sequence, reply,
+                         sizeof(reply)) > 0) {
+        text_len = strlen(reply); // snprintf reports untruncated lengths
+      }
+      if (cacheable) {
+        reply_cache_store(addr, port, msg, data_len, MSG_TYPE_RESPONSE, reply,
+                          text_len);
+      }
+    }
+
+    // Unknown commands and actions that succeeded get a plain acknowledgment
+    int has_text = text_len > 0;
+    if (!has_text) {
+      plain_ack(msg->sequence, reply, sizeof(reply));
+    }
+
+    // Pipelining clients in ACKMODE RANGE get plain acks coalesced
+    if (!has_text && ack_range_active(addr, port)) {
+      ack_range_add(addr, port, msg->sequence);
+      return;
+    }
+
+    if (send_text_message(MSG_TYPE_RESPONSE, msg->sequence, reply, addr,
+                          port) == ERR_OK) {
       xil_printf("[UART] Sent acknowledgment\r\n");
     }
   }
 }
 
-void send_data_to_qt(void) {
-  if (qt_client_port == 0) {
-    return; // No client connected
+static void process_reassembled(const fragment_message_t *whole,
+                                const ip_addr_t *addr, u16_t port) {
+  xil_printf("\r\n[UART] Reassembled type %d, %lu bytes\r\n", whole->msg_type,
+             (unsigned long)whole->length);
+
+  // Whatever fits one message is handled as if it had arrived whole
+  if (whole->length <= WIRE_V1_MAX_DATA) {
+    wire_v1_view_t msg = {whole->msg_type, whole->sequence,
+                          (u16_t)whole->length, whole->data};
+    process_message(&msg, addr, port);
+    return;
   }
 
-  data_message_t msg;
-  msg.msg_type = MSG_TYPE_DATA;
-  msg.sequence = sequence_counter++;
+  // Larger ones can only be data; the UART gets the start of it
+  if (whole->msg_type != MSG_TYPE_DATA) {
+    xil_printf("[ERROR] Type %d cannot exceed %d bytes\r\n", whole->msg_type,
+               WIRE_V1_MAX_DATA);
+    return;
+  }
+  xil_printf("[UART] Data: ");
+  for (u16_t i = 0; i < 256; i++) {
+    xil_printf("%c", whole->data[i]);
+  }
+  xil_printf("... (%lu more)\r\n", (unsigned long)(whole->length - 256));
+}
 
-  // Prepare sample data
-  const char *data_str = sample_data[sample_data_index];
-  sample_data_index =
-      (sample_data_index + 1) % (sizeof(sample_data) / sizeof(sample_data[0]));
+void process_received_data(struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+  // v1 or v2 framing, whichever the client speaks
+  wire_v1_view_t msg;
+  if (proto_decode(p, addr, port, &msg) != ERR_OK) {
+    return;
+  }
 
-  msg.length = snprintf((char *)msg.data, sizeof(msg.data), "%s [Seq:%d]",
-                        data_str, msg.sequence);
+  // Update statistics
+  stats.packets_received++;
+  stats.bytes_received += p->tot_len;
+  stats.last_packet_time = 0; // Simplified for now
 
-  // Create packet buffer
-  struct pbuf *pbuf =
-      pbuf_alloc(PBUF_TRANSPORT, sizeof(data_message_t), PBUF_RAM);
-  if (pbuf == NULL) {
-    xil_printf("[ERROR] Failed to allocate pbuf for sending\r\n");
+  if (msg.msg_type != MSG_TYPE_CONTAINER) {
+    process_message(&msg, addr, port);
     return;
   }
 
-  // Copy message to buffer
-  memcpy(pbuf->payload, &msg, sizeof(data_message_t));
+  // Containers are unpacked and each sub-message handled as if sent alone
+  wire_v1_view_t sub;
+  u16_t offset = 0;
+  xil_printf("\r\n[UART] Container of %d bytes received\r\n", msg.length);
+  while ((offset = container_next(&msg, offset, &sub)) != 0) {
+    process_message(&sub, addr, port);
+  }
+}
 
-  // Send packet
-  err_t err = udp_sendto(data_pcb, pbuf, &qt_client_ip, qt_client_port);
-  if (err == ERR_OK) {
-    stats.packets_sent++;
-    stats.bytes_sent += sizeof(data_message_t);
-    xil_printf("[SENT] Data to Qt: %s\r\n", data_str);
-  } else {
-    xil_printf("[ERROR] Failed to send data: %d\r\n", err);
+void report_channel_set(u8_t channel, s32_t value) {
+  if (channel < REPORT_CHANNELS) {
+    report_channels[channel].value = value;
   }
+}
 
-  pbuf_free(pbuf);
+static int report_channel_due(const report_channel_t *ch, XTime now) {
+  if (!ch->reported) {
+    return 1;
+  }
+  s32_t change = ch->value - ch->sent_value;
+  if (change < 0) {
+    change = -change;
+  }
+  if (change > ch->deadband || (ch->deadband == 0 && change != 0)) {
+    return 1;
+  }
+  return ch->max_silence_ms != 0 &&
+         now - ch->sent_time >=
+             (XTime)ch->max_silence_ms * (COUNTS_PER_SECOND / 1000);
 }
 
-void send_heartbeat(void) {
+void send_data_to_qt(void) {
   if (qt_client_port == 0) {
     return; // No client connected
   }
 
+  report_channels[REPORT_PACKETS_RX].value = (s32_t)stats.packets_received;
+  report_channels[REPORT_PACKETS_TX].value = (s32_t)stats.packets_sent;
+
+  XTime now;
+  XTime_GetTime(&now);
+
+  for (u8_t i = 0; i < REPORT_CHANNELS; i++) {
+    report_channel_t *ch = &report_channels[i];
+    if (!report_channel_due(ch, now)) {
+      report_suppressed++;
+      continue;
+    }
+
+    data_message_t msg;
+    msg.msg_type = MSG_TYPE_DATA;
+    msg.sequence = sequence_counter++;
+
+    // Fixed-point value printed with its decimals, e.g. 452/1 -> "45.2"
+    s32_t div = 1;
+    for (u8_t d = 0; d < ch->decimals; d++) {
+      div *= 10;
+    }
+    s32_t whole = ch->value / div;
+    s32_t frac = ch->value % div;
+    if (frac < 0) {
+      frac = -frac;
+    }
+    if (ch->decimals > 0) {
+      msg.length = snprintf((char *)msg.data, sizeof(msg.data),
+                            "%s: %s%ld.%0*ld%s [Seq:%d]", ch->name,
+                            (ch->value < 0 && whole == 0) ? "-" : "",
+                            (long)whole, ch->decimals, (long)frac, ch->unit,
+                            msg.sequence);
+    } else {
+      msg.length = snprintf((char *)msg.data, sizeof(msg.data),
+                            "%s: %ld%s [Seq:%d]", ch->name, (long)ch->value,
+                            ch->unit, msg.sequence);
+    }
+
+    // Queue behind anything still waiting for this client
+    err_t err =
+        sendq_submit(&msg, SENDQ_TELEMETRY, &qt_client_ip, qt_client_port);
+    if (err != ERR_OK) {
+      xil_printf("[ERROR] Failed to send data: %d\r\n", err);
+      continue; // Not marked as reported, retried on the next check
+    }
+    ch->sent_value = ch->value;
+    ch->sent_time = now;
+    ch->reported = 1;
+    report_sent++;
+  }
+}
+
+static u16_t report_command(const char *args, const ip_addr_t *addr,
+                            u16_t port, u8_t sequence, char *reply,
+                            u16_t reply_size) {
+  if (strncmp(args, "ON", 2) == 0) {
+    report_enabled = 1;
+    return 0;
+  } else if (strncmp(args, "OFF", 3) == 0) {
+    report_enabled = 0;
+    return 0;
+  } else if (strncmp(args, "REFRESH", 7) == 0) {
+    // Full snapshot on the next check, whatever changed
+    for (u8_t i = 0; i < REPORT_CHANNELS; i++) {
+      report_channels[i].reported = 0;
+    }
+    return 0;
+  } else if (*args != '\0') {
+    // REPORT <channel> <deadband> [max_silence_ms]
+    char *end;
+    u32_t channel = strtoul(args, &end, 0);
+    if (end == args || channel >= REPORT_CHANNELS) {
+      return snprintf(reply, reply_size,
+                      "REPORT error: usage REPORT ON|OFF|REFRESH | "
+                      "<channel 0-%d> <deadband> [max_silence_ms]",
+                      REPORT_CHANNELS - 1);
+    }
+    const char *cursor = end;
+    report_channels[channel].deadband = (s32_t)strtol(cursor, &end, 0);
+    if (end != cursor) {
+      cursor = end;
+      u32_t silence = strtoul(cursor, &end, 0);
+      if (end != cursor) {
+        report_channels[channel].max_silence_ms = silence;
+      }
+    }
+    return 0;
+  }
+
+  int len = snprintf(reply, reply_size, "REPORT %s sent=%lu suppressed=%lu",
+                     report_enabled ? "on" : "off", (unsigned long)report_sent,
+                     (unsigned long)report_suppressed);
+  for (u8_t i = 0; i < REPORT_CHANNELS && len < reply_size; i++) {
+    const report_channel_t *ch = &report_channels[i];
+    len += snprintf(reply + len, reply_size - len,
+                    " | %d:%s deadband=%ld silence=%lums", i, ch->name,
+                    (long)ch->deadband, (unsigned long)ch->max_silence_ms);
+  }
+  return len < reply_size ? len : reply_size - 1;
+}
+
+u8_t send_heartbeat(void) {
   data_message_t msg;
   msg.msg_type = MSG_TYPE_HEARTBEAT;
   msg.sequence = sequence_counter++;
   msg.length = snprintf((char *)msg.data, sizeof(msg.data), "Heartbeat %d",
                         msg.sequence);
 
-  struct pbuf *pbuf =
-      pbuf_alloc(PBUF_TRANSPORT, sizeof(data_message_t), PBUF_RAM);
-  if (pbuf != NULL) {
-    memcpy(pbuf->payload, &msg, sizeof(data_message_t));
-    udp_sendto(data_pcb, pbuf, &qt_client_ip, qt_client_port);
-    pbuf_free(pbuf);
+  if (qt_client_port != 0) {
+    sendq_submit(&msg, SENDQ_TELEMETRY, &qt_client_ip, qt_client_port);
+  }
+  return msg.sequence;
+}
 
-    stats.packets_sent++;
-    stats.bytes_sent += sizeof(data_message_t);
+u16_t message_wire_size(const data_message_t *msg) {
+  // Heartbeats and the message types added with ack ranges go out trimmed;
+  // everything else keeps the full frame that older clients require
+  if (msg->msg_type == MSG_TYPE_HEARTBEAT ||
+      msg->msg_type >= MSG_TYPE_ACK_RANGE) {
+    return DATA_HEADER_SIZE + msg->length;
+  }
+  return sizeof(data_message_t);
+}
+
+err_t send_text_message(u8_t msg_type, u8_t sequence, const char *text,
+                        const ip_addr_t *addr, u16_t port) {
+  // Longer text goes out in fragments rather than cut short
+  size_t len = strlen(text);
+  if (len > sizeof(((data_message_t *)0)->data)) {
+    err_t err = fragment_send(msg_type, sequence, text, len, addr, port);
+    if (err != ERR_OK) {
+      // The client hears that its reply was lost instead of waiting on it
+      char note[64];
+      snprintf(note, sizeof(note), "ERROR: %lu-byte reply dropped (%d)",
+               (unsigned long)len, err);
+      send_text_message(msg_type, sequence, note, addr, port);
+    }
+    return err;
   }
+
+  data_message_t msg;
+  msg.msg_type = msg_type;
+  msg.sequence = sequence;
+  msg.length = len;
+  memcpy(msg.data, text, len);
+
+  // Responses wait out transient pbuf shortages instead of being lost
+  return sendq_submit(&msg, SENDQ_RELIABLE, addr, port);
 }
 
 void display_statistics(void) {
@@ -242,6 +591,9 @@ int start_application(void) {
   udp_recv(data_pcb, udp_data_recv, NULL);
 
   xil_printf("[INFO] Data transfer server started successfully\r\n");
+
+  /* Discard port for receive-rate measurements */
+  start_rx_sink();
   return 0;
 }
 
@@ -263,35 +615,12 @@ void send_uart_data_to_qt(char *data_str) {
     return;
   }
 
-  data_message_t msg;
-  msg.msg_type = MSG_TYPE_DATA;
-  msg.sequence = sequence_counter++;
-
-  msg.length = snprintf((char *)msg.data, sizeof(msg.data), "%s", data_str);
-
-  // Create packet buffer
-  struct pbuf *pbuf =
-      pbuf_alloc(PBUF_TRANSPORT, sizeof(data_message_t), PBUF_RAM);
-  if (pbuf == NULL) {
-    xil_printf("[ERROR] Failed to allocate pbuf for sending\r\n");
-    return;
-  }
-
-  // Copy message to buffer
-  memcpy(pbuf->payload, &msg, sizeof(data_message_t));
-
-  // Send packet
-  err_t err = udp_sendto(data_pcb, pbuf, &qt_client_ip, qt_client_port);
-  if (err == ERR_OK) {
-    stats.packets_sent++;
-    stats.bytes_sent += sizeof(data_message_t);
-    // xil_printf("[SENT] Data to Qt: %s\r\n", data_str); // Optional: don't
-    // echo own send to avoid clutter
-  } else {
+  // Typed console text is not resent by anyone, so it is queued as reliable
+  err_t err = send_text_message(MSG_TYPE_DATA, sequence_counter++, data_str,
+                                &qt_client_ip, qt_client_port);
+  if (err != ERR_OK) {
     xil_printf("[ERROR] Failed to send data: %d\r\n", err);
   }
-
-  pbuf_free(pbuf);
 }
 
 void check_uart_input(void) {
@@ -336,14 +665,47 @@ void check_uart_input(void) {
 
 int transfer_data(void) {
   static u32_t counter = 0;
+  static XTime next_report_check = 0;
 
   /* Check for UART input every cycle */
   check_uart_input();
 
-  // Check for connection timeout (if no data received for 5000 iterations)
-  if (qt_client_port != 0 &&
-      stats.connection_timeout_counter >
-          500000) { // Increased timeout for manual typing
+  /* Retry messages held back by earlier pbuf or TX ring shortages */
+  sendq_flush();
+
+  /* Keep the traffic generator running between RX passes */
+  tgen_poll();
+
+  /* Sample telemetry streams and send due summaries */
+  telemetry_poll();
+
+  /* Send the status frame when its period is up */
+  status_frame_poll();
+
+  /* Record every stream and stream out a frozen window */
+  frec_poll();
+
+  /* Send coalesced command acks whose deadline has passed */
+  ack_range_poll();
+
+  /* Send the packed container once its oldest message is due */
+  container_poll();
+
+  /* Next fragments of a large message; expire stalled reassemblies */
+  fragment_poll();
+
+  /* Close an FEC group whose deadline has passed */
+  fec_poll();
+
+  /* Resend expired reliable channel segments and fill the window */
+  rchan_poll();
+
+  /* Ask a client that left the stream without credit for a fresh grant */
+  credit_poll();
+
+  // Probe an idle client; drop it once probes go unanswered for the
+  // RTT-derived timeout
+  if (keepalive_poll()) {
     xil_printf("[INFO] Client connection timeout - resetting client info\r\n");
     qt_client_ip.addr = 0;
     qt_client_port = 0;
@@ -351,13 +713,15 @@ int transfer_data(void) {
     reset_statistics();
   }
 
-  // Send sample data periodically (optional, keep for heartbeat/alive check)
-  // Reduced frequency to not interfere with chat
-  if (counter % 50000 == 0 && qt_client_port != 0) {
-    // send_data_to_qt(); // Disable auto-sending sample data to focus on chat
-
-    // Send heartbeat
-    send_heartbeat();
+  // Report channels that changed; static ones stay quiet, so this does not
+  // interfere with chat once enabled by REPORT ON
+  if (report_enabled && qt_client_port != 0) {
+    XTime now;
+    XTime_GetTime(&now);
+    if (now >= next_report_check) {
+      next_report_check = now + REPORT_CHECK_MS * (COUNTS_PER_SECOND / 1000);
+      send_data_to_qt();
+    }
   }
 
   // Display statistics every ~10 seconds
@@ -366,11 +730,6 @@ int transfer_data(void) {
     // for chat
   }
 
-  // Increment timeout counter if no client connected
-  if (qt_client_port != 0) {
-    stats.connection_timeout_counter++;
-  }
-
   counter++;
   return 0;
 }
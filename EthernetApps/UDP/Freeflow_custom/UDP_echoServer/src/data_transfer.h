@@ -13,19 +13,17 @@
 #include "lwip/inet.h"
 #include "xil_printf.h"
 #include "platform.h"
+#include "xtime_l.h"
+#include "wire.h"
 
 /* Data transfer configuration */
 #define DATA_TRANSFER_PORT 8888
-#define MAX_DATA_SIZE 1024
+#define MAX_DATA_SIZE WIRE_V1_MAX_SIZE
+#define DATA_HEADER_SIZE WIRE_V1_HEADER_SIZE // msg_type, sequence, length
 #define SEND_INTERVAL_MS 1000  // Send data every 1 second
-
-/* Message types for protocol */
-typedef enum {
-    MSG_TYPE_DATA = 0x01,
-    MSG_TYPE_COMMAND = 0x02,
-    MSG_TYPE_RESPONSE = 0x03,
-    MSG_TYPE_HEARTBEAT = 0x04
-} msg_type_t;
+#define REPORT_CHECK_MS 100    // How often channels are checked for changes
+#define REPORT_DEFAULT_SILENCE_MS 600000 // Resend unchanged channels (10 min)
+#define COMMAND_REPLY_SIZE 8192 // Longest reply text, fragmented past a frame
 
 /* Data structure for messages */
 typedef struct {
@@ -35,6 +33,13 @@ typedef struct {
     u8_t data[MAX_DATA_SIZE - 4]; // Total size minus header
 } data_message_t;
 
+/* Holds one full v1 frame; proto.c converts with the wire.h codec */
+WIRE_STATIC_ASSERT(sizeof(data_message_t) == WIRE_V1_MAX_SIZE,
+                   "data_message_t must be one full v1 frame");
+WIRE_STATIC_ASSERT(offsetof(data_message_t, length) == WIRE_V1_LENGTH_OFFSET &&
+                       offsetof(data_message_t, data) == WIRE_V1_HEADER_SIZE,
+                   "data_message_t must match the v1 header");
+
 /* Statistics structure */
 typedef struct {
     u32_t packets_sent;
@@ -43,9 +48,48 @@ typedef struct {
     u32_t bytes_received;
     u32_t last_sequence_received;
     u32_t last_packet_time;
-    u32_t connection_timeout_counter;
+    u32_t connection_timeout_counter; // Unanswered keepalive probes
+    u32_t resets; // reset_statistics() calls: the counters restarted from 0
 } transfer_stats_t;
 
+/* Report-by-exception channel sent by send_data_to_qt */
+typedef struct {
+    const char *name;
+    const char *unit;
+    u8_t decimals;        // value is in units of 10^-decimals
+    s32_t value;
+    s32_t deadband;       // Change since the last report that forces a new one
+    u32_t max_silence_ms; // Report unchanged values after this long, 0 = never
+    s32_t sent_value;
+    XTime sent_time;
+    u8_t reported;        // Cleared by REPORT REFRESH to resend everything
+} report_channel_t;
+
+/* Command handler: parses args, writes a reply string, returns its length.
+ * Queries and errors reply with text; an action that succeeded returns 0
+ * and is acknowledged like a plain command, so ACKMODE RANGE can coalesce
+ * it. */
+typedef u16_t (*command_handler_t)(const char *args, const ip_addr_t *addr,
+                                   u16_t port, u8_t sequence, char *reply,
+                                   u16_t reply_size);
+
+typedef struct {
+    const char *name;
+    command_handler_t handler;
+    u8_t cached; // Can change state: the reply is kept for retransmits
+} command_entry_t;
+
+/* Report channels, the first argument of report_channel_set() */
+typedef enum {
+    REPORT_TEMPERATURE = 0,
+    REPORT_VOLTAGE,
+    REPORT_MEMORY,
+    REPORT_CPU_LOAD,
+    REPORT_PACKETS_RX, // Refreshed from stats, not set by callers
+    REPORT_PACKETS_TX,
+    REPORT_CHANNELS
+} report_channel_id_t;
+
 /* Function prototypes */
 void print_app_header(void);
 int start_application(void);
@@ -54,14 +98,19 @@ int transfer_data(void);
 /* Data transfer functions */
 void init_data_transfer(void);
 void send_data_to_qt(void);
+void report_channel_set(u8_t channel, s32_t value);
 void process_received_data(struct pbuf *p, const ip_addr_t *addr, u16_t port);
 void display_statistics(void);
-void send_heartbeat(void);
+u8_t send_heartbeat(void);
+u16_t message_wire_size(const data_message_t *msg);
+err_t send_text_message(u8_t msg_type, u8_t sequence, const char *text,
+                        const ip_addr_t *addr, u16_t port);
 
 /* External variables */
 extern transfer_stats_t stats;
 extern struct udp_pcb *data_pcb;
 extern ip_addr_t qt_client_ip;
 extern u16_t qt_client_port;
+extern u8_t sequence_counter;
 
 #endif /* __DATA_TRANSFER_H_ */
@@ -0,0 +1,62 @@
+/*
+ * Deferred Work Queue Implementation
+ * Single-producer/single-consumer ring: interrupt handlers post, the main
+ * loop drains. Head is only written by the producer and tail only by the
+ * consumer, so no locking or interrupt masking is needed.
+ */
+
+#include "deferred_work.h"
+#include "xpseudo_asm.h"
+
+static deferred_item_t queue[DEFERRED_WORK_QUEUE_SIZE];
+static volatile u32_t queue_head; // Next slot to fill (producer)
+static volatile u32_t queue_tail; // Next slot to run (consumer)
+static deferred_work_stats_t work_stats;
+
+int deferred_work_post(deferred_fn_t fn, void *arg) {
+  u32_t head = queue_head;
+  u32_t depth = head - queue_tail;
+
+  if (depth >= DEFERRED_WORK_QUEUE_SIZE) {
+    work_stats.overflows++;
+    return -1;
+  }
+
+  deferred_item_t *item = &queue[head & (DEFERRED_WORK_QUEUE_SIZE - 1)];
+  item->fn = fn;
+  item->arg = arg;
+
+  /* Publish the item before the new head becomes visible */
+  dmb();
+  queue_head = head + 1;
+
+  work_stats.posted++;
+  if (depth + 1 > work_stats.max_depth) {
+    work_stats.max_depth = depth + 1;
+  }
+  return 0;
+}
+
+u32_t deferred_work_run(u32_t budget) {
+  u32_t done = 0;
+
+  while (done < budget) {
+    u32_t tail = queue_tail;
+    if (tail == queue_head) {
+      break;
+    }
+
+    dmb();
+    deferred_item_t item = queue[tail & (DEFERRED_WORK_QUEUE_SIZE - 1)];
+    dmb();
+    queue_tail = tail + 1;
+
+    item.fn(item.arg);
+    done++;
+  }
+
+  work_stats.executed += done;
+  return done;
+}
+
+void deferred_work_get_stats(deferred_work_stats_t *out) { *out = work_stats; }
@@ -0,0 +1,35 @@
+/*
+ * Deferred Work Queue Header
+ * Lets interrupt handlers hand slow work to the main loop
+ */
+
+#ifndef __DEFERRED_WORK_H_
+#define __DEFERRED_WORK_H_
+
+#include "lwip/arch.h"
+
+/* Queue configuration */
+#define DEFERRED_WORK_QUEUE_SIZE 16 // Must be a power of two
+#define DEFERRED_WORK_BUDGET 2      // Items run per main loop pass
+
+typedef void (*deferred_fn_t)(void *arg);
+
+typedef struct {
+  deferred_fn_t fn;
+  void *arg;
+} deferred_item_t;
+
+/* Queue counters */
+typedef struct {
+  u32_t posted;
+  u32_t executed;
+  u32_t overflows; // Posts rejected because the queue was full
+  u32_t max_depth;
+} deferred_work_stats_t;
+
+/* Function prototypes */
+int deferred_work_post(deferred_fn_t fn, void *arg); // ISR only
+u32_t deferred_work_run(u32_t budget);               // Main loop only
+void deferred_work_get_stats(deferred_work_stats_t *out);
+
+#endif /* __DEFERRED_WORK_H_ */
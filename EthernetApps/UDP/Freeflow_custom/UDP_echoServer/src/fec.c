@@ -0,0 +1,247 @@
+/*
+ * FEC Implementation
+ * With FEC ON, streaming messages to the client go out wrapped with their
+ * group and index, and after every k of them m parity messages follow.
+ * Parity is accumulated as each data message is sent, so the board keeps
+ * m parity buffers rather than the group. The client delivers data messages
+ * as they arrive and rebuilds lost ones as soon as enough parity is in,
+ * without waiting for a retransmission.
+ */
+
+#include "fec.h"
+#include "send_queue.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* GF(2^8) tables; exp is doubled so log sums need no reduction */
+static u8_t fec_exp[512];
+static u8_t fec_log[256];
+
+static u8_t fec_enabled;
+static ip_addr_t fec_dest_ip;
+static u16_t fec_dest_port;
+static u8_t fec_k = FEC_DEFAULT_K;
+static u8_t fec_m = FEC_DEFAULT_M;
+static u32_t fec_deadline_ms = FEC_DEFAULT_DEADLINE_MS;
+
+/* Open group */
+static u16_t fec_group;
+static u8_t fec_count;
+static u16_t fec_parity_len; // Longest message so far; parity beyond is 0
+static XTime fec_first;
+static u8_t fec_coef_log[FEC_MAX_M][FEC_MAX_K]; // log of coef(j, i)
+static u8_t fec_parity[FEC_MAX_M][FEC_MAX_BLOCK];
+
+static fec_stats_t fec_stats;
+
+static void fec_init_tables(void) {
+  u16_t x = 1;
+  for (u16_t i = 0; i < 255; i++) {
+    fec_exp[i] = fec_exp[i + 255] = (u8_t)x;
+    fec_log[x] = (u8_t)i;
+    x <<= 1;
+    if (x & 0x100) {
+      x ^= 0x11d;
+    }
+  }
+
+  for (u8_t j = 0; j < FEC_MAX_M; j++) {
+    for (u8_t i = 0; i < FEC_MAX_K; i++) {
+      /* log((255 ^ i) / ((255 - j) ^ i)) */
+      fec_coef_log[j][i] =
+          (fec_log[255 ^ i] + 255 - fec_log[(255 - j) ^ i]) % 255;
+    }
+  }
+}
+
+/* parity ^= coef * block, byte by byte in GF(2^8) */
+static void fec_accumulate(u8_t *parity, const u8_t *block, u16_t len,
+                           u8_t coef_log) {
+  if (coef_log == 0) {
+    for (u16_t n = 0; n < len; n++) {
+      parity[n] ^= block[n];
+    }
+    return;
+  }
+  for (u16_t n = 0; n < len; n++) {
+    if (block[n] != 0) {
+      parity[n] ^= fec_exp[coef_log + fec_log[block[n]]];
+    }
+  }
+}
+
+static void fec_header(data_message_t *out, u8_t index, u8_t parity,
+                       u8_t k) {
+  fec_header_t hdr;
+  hdr.group = fec_group;
+  hdr.index = index;
+  hdr.parity = parity;
+  hdr.k = k;
+  hdr.m = fec_m;
+  hdr.reserved = 0;
+  memcpy(out->data, &hdr, sizeof(hdr));
+  out->msg_type = MSG_TYPE_FEC;
+}
+
+/* Sends the parity of the open group and starts the next one. A parity
+ * message that cannot be queued is lost like any dropped datagram. */
+static void fec_close_group(void) {
+  data_message_t out;
+  for (u8_t j = 0; j < fec_m; j++) {
+    fec_header(&out, j, 1, fec_count);
+    out.sequence = 0;
+    out.length = FEC_HEADER_SIZE + fec_parity_len;
+    memcpy(&out.data[FEC_HEADER_SIZE], fec_parity[j], fec_parity_len);
+    if (sendq_submit(&out, SENDQ_TELEMETRY, &fec_dest_ip, fec_dest_port) ==
+        ERR_OK) {
+      fec_stats.parity++;
+      fec_stats.bytes += out.length;
+      fec_stats.parity_bytes += out.length;
+    } else {
+      fec_stats.send_failures++;
+    }
+    memset(fec_parity[j], 0, fec_parity_len);
+  }
+
+  fec_stats.groups++;
+  if (fec_count < fec_k) {
+    fec_stats.short_groups++;
+  }
+  fec_group++;
+  fec_count = 0;
+  fec_parity_len = 0;
+}
+
+/* True if msg is to be sent through fec_send */
+int fec_active(const data_message_t *msg, const ip_addr_t *addr,
+               u16_t port) {
+  if (!fec_enabled || fec_dest_port != port ||
+      !ip_addr_cmp(&fec_dest_ip, addr) || msg->msg_type == MSG_TYPE_FEC) {
+    return 0;
+  }
+  if (DATA_HEADER_SIZE + msg->length > FEC_MAX_BLOCK) {
+    fec_stats.unprotected++;
+    return 0;
+  }
+  return 1;
+}
+
+err_t fec_send(const data_message_t *msg, const ip_addr_t *addr,
+               u16_t port) {
+  data_message_t out;
+  u16_t len = DATA_HEADER_SIZE + msg->length;
+
+  fec_header(&out, fec_count, 0, fec_k);
+  out.sequence = msg->sequence;
+  out.length = FEC_HEADER_SIZE + len;
+  wire_v1_encode(&out.data[FEC_HEADER_SIZE], msg->msg_type, msg->sequence,
+                 msg->length);
+  memcpy(&out.data[FEC_HEADER_SIZE + DATA_HEADER_SIZE], msg->data,
+         msg->length);
+  err_t err = sendq_submit(&out, SENDQ_TELEMETRY, addr, port);
+  if (err != ERR_OK) {
+    return err; // Not part of the group; the next message takes its index
+  }
+
+  if (fec_count == 0) {
+    XTime_GetTime(&fec_first);
+  }
+  for (u8_t j = 0; j < fec_m; j++) {
+    fec_accumulate(fec_parity[j], &out.data[FEC_HEADER_SIZE], len,
+                   fec_coef_log[j][fec_count]);
+  }
+  if (len > fec_parity_len) {
+    fec_parity_len = len;
+  }
+  fec_stats.data++;
+  fec_stats.bytes += out.length;
+
+  if (++fec_count == fec_k) {
+    fec_close_group();
+  }
+  return ERR_OK;
+}
+
+void fec_poll(void) {
+  if (!fec_enabled || fec_count == 0) {
+    return;
+  }
+
+  /* A slow stream must not leave its last messages unprotected */
+  XTime now;
+  XTime_GetTime(&now);
+  if (now - fec_first >=
+      (XTime)fec_deadline_ms * (COUNTS_PER_SECOND / 1000)) {
+    fec_close_group();
+  }
+}
+
+u16_t fec_command(const char *args, const ip_addr_t *addr, u16_t port,
+                  u8_t sequence, char *reply, u16_t reply_size) {
+  if (strncmp(args, "ON", 2) == 0) {
+    /* FEC ON [k] [m] [deadline_ms] */
+    char *end;
+    u32_t value[3] = {fec_k, fec_m, fec_deadline_ms};
+    const char *cursor = args + 2;
+    for (u8_t i = 0; i < 3; i++) {
+      u32_t v = strtoul(cursor, &end, 0);
+      if (end == cursor) {
+        break;
+      }
+      value[i] = v;
+      cursor = end;
+    }
+    if (value[0] < 1 || value[0] > FEC_MAX_K || value[1] < 1 ||
+        value[1] > FEC_MAX_M || value[2] == 0) {
+      return snprintf(reply, reply_size,
+                      "FEC error: usage FEC ON [k 1-%d] [m 1-%d] "
+                      "[deadline_ms >= 1] | OFF",
+                      FEC_MAX_K, FEC_MAX_M);
+    }
+    if (fec_exp[0] == 0) {
+      fec_init_tables();
+    }
+
+    /* The open group was coded for the old parameters: drop its parity */
+    for (u8_t j = 0; j < FEC_MAX_M; j++) {
+      memset(fec_parity[j], 0, fec_parity_len);
+    }
+    if (fec_count > 0) {
+      fec_group++;
+    }
+    fec_count = 0;
+    fec_parity_len = 0;
+    fec_k = (u8_t)value[0];
+    fec_m = (u8_t)value[1];
+    fec_deadline_ms = value[2];
+    fec_dest_ip = *addr;
+    fec_dest_port = port;
+    fec_enabled = 1;
+    return 0;
+  } else if (strncmp(args, "OFF", 3) == 0) {
+    if (fec_enabled && fec_count > 0) {
+      fec_close_group();
+    }
+    fec_enabled = 0;
+    return 0;
+  }
+
+  /* Parity bytes as a share of all bytes sent under FEC, in 0.1 % */
+  u32_t overhead = fec_stats.bytes ? (u32_t)((u64)fec_stats.parity_bytes *
+                                             1000 / fec_stats.bytes)
+                                   : 0;
+  return snprintf(reply, reply_size,
+                  "FEC %s k=%d m=%d deadline_ms=%lu groups=%lu "
+                  "short_groups=%lu data=%lu parity=%lu unprotected=%lu "
+                  "send_failures=%lu overhead=%lu.%lu%%",
+                  fec_enabled ? "on" : "off", fec_k, fec_m,
+                  (unsigned long)fec_deadline_ms,
+                  (unsigned long)fec_stats.groups,
+                  (unsigned long)fec_stats.short_groups,
+                  (unsigned long)fec_stats.data,
+                  (unsigned long)fec_stats.parity,
+                  (unsigned long)fec_stats.unprotected,
+                  (unsigned long)fec_stats.send_failures,
+                  (unsigned long)(overhead / 10),
+                  (unsigned long)(overhead % 10));
+}
@@ -0,0 +1,57 @@
+/*
+ * FEC Header
+ * Forward error correction for streaming messages: parity messages after
+ * every group of data messages, decoded by the client without a round trip
+ */
+
+#ifndef __FEC_H_
+#define __FEC_H_
+
+#include "data_transfer.h"
+
+/* Code limits and defaults */
+#define FEC_MAX_K 32            // Data messages per group
+#define FEC_MAX_M 4             // Parity messages per group
+#define FEC_DEFAULT_K 8
+#define FEC_DEFAULT_M 1         // One parity message: plain XOR
+#define FEC_DEFAULT_DEADLINE_MS 100 // A group not full by then is closed
+#define FEC_HEADER_SIZE 8
+#define FEC_MAX_BLOCK (MAX_DATA_SIZE - DATA_HEADER_SIZE - FEC_HEADER_SIZE)
+
+/* MSG_TYPE_FEC data: this header, then for a data message the protected
+ * message itself (v1 header and exactly length bytes of data), for a
+ * parity message the parity of the group's messages, each zero-padded to
+ * the longest. Parity row j is sum over i of coef(j, i) * message i in
+ * GF(2^8) (polynomial 0x11d), with the Cauchy coefficients
+ * coef(j, i) = (255 ^ i) / ((255 - j) ^ i); row 0 is all ones, so a
+ * single parity message is the XOR of the group. Any k of the k + m
+ * messages of a group rebuild all of its data messages. */
+typedef struct {
+  u16_t group;  // Per client, wraps
+  u8_t index;   // Data: position in the group; parity: row j
+  u8_t parity;  // 0 data, 1 parity
+  u8_t k;       // Data messages in the group; a parity message's k is
+                // final and may be lower when the deadline closed it
+  u8_t m;       // Parity messages per group
+  u16_t reserved;
+} fec_header_t;
+
+typedef struct {
+  u32_t groups;
+  u32_t short_groups;  // Closed by the deadline before k data messages
+  u32_t data;
+  u32_t parity;
+  u32_t unprotected;   // Too long to wrap, sent as they were
+  u32_t send_failures; // Parity messages the send queue refused
+  u32_t bytes;         // Wrapped data and parity bytes sent
+  u32_t parity_bytes;
+} fec_stats_t;
+
+/* Function prototypes */
+int fec_active(const data_message_t *msg, const ip_addr_t *addr, u16_t port);
+err_t fec_send(const data_message_t *msg, const ip_addr_t *addr, u16_t port);
+void fec_poll(void);
+u16_t fec_command(const char *args, const ip_addr_t *addr, u16_t port,
+                  u8_t sequence, char *reply, u16_t reply_size);
+
+#endif /* __FEC_H_ */
@@ -0,0 +1,308 @@
+/*
+ * Flight Recorder Implementation
+ * Samples every telemetry stream at FREC_RATE_HZ into a ring in its own DDR
+ * section. A TRIGGER command or a threshold crossing freezes the window
+ * around the event, which is then streamed to the client as fast as the
+ * link takes it.
+ */
+
+#include "flight_recorder.h"
+#include "proto.h"
+#include <stdlib.h>
+#include <string.h>
+
+static frec_record_t frec_ring[FREC_RECORDS]
+    __attribute__((section(".flight_recorder"), aligned(32)));
+
+static u8_t frec_state = FREC_RECORDING;
+static u32_t frec_written; // Records ever written, next sample index
+static u32_t frec_last_counter[TELEM_STREAM_COUNT];
+static u32_t frec_last_resets[TELEM_STREAM_COUNT];
+static XTime frec_period;
+static XTime frec_next_due;
+
+/* Window around the event */
+static u32_t frec_pre_records = FREC_DEFAULT_PRE_MS * FREC_RATE_HZ / 1000;
+static u32_t frec_post_records = FREC_DEFAULT_POST_MS * FREC_RATE_HZ / 1000;
+static u32_t frec_trigger_index;
+static u8_t frec_reason;
+
+/* Threshold trigger, checked on every record while recording */
+static u8_t frec_threshold_mode = FREC_REASON_NONE;
+static u8_t frec_threshold_stream;
+static u32_t frec_threshold_value;
+
+/* Dump in progress */
+static u8_t frec_dumping;
+static u32_t frec_dump_id;
+static u32_t frec_dump_next;
+static u32_t frec_dump_first;
+static u32_t frec_dump_end;
+static u32_t frec_dump_chunks;
+static u32_t frec_dump_send_failures;
+static ip_addr_t frec_dest_ip;
+static u16_t frec_dest_port;
+static u8_t frec_cmd_sequence;
+
+/* Oldest sample index still held in the ring */
+static u32_t frec_oldest(void) {
+  return frec_written > FREC_RECORDS ? frec_written - FREC_RECORDS : 0;
+}
+
+static void frec_trigger(u8_t reason) {
+  frec_state = FREC_TRIGGERED;
+  frec_reason = reason;
+  frec_trigger_index = frec_written;
+  xil_printf("[FREC] Triggered at sample %d (reason %d)\r\n",
+             frec_trigger_index, reason);
+}
+
+static void frec_start_dump(void) {
+  u32_t first = frec_trigger_index > frec_pre_records
+                    ? frec_trigger_index - frec_pre_records
+                    : 0;
+  if (first < frec_oldest()) {
+    first = frec_oldest();
+  }
+
+  frec_dump_id++;
+  frec_dump_first = first;
+  frec_dump_next = first;
+  frec_dump_end = frec_written;
+  frec_dump_chunks = 0;
+  frec_dump_send_failures = 0;
+  frec_dumping = frec_dest_port != 0;
+}
+
+static void frec_freeze(void) {
+  frec_state = FREC_FROZEN;
+  frec_start_dump();
+  xil_printf("[FREC] Frozen: samples %d..%d around trigger %d\r\n",
+             frec_dump_first, frec_dump_end - 1, frec_trigger_index);
+}
+
+static void frec_record(void) {
+  frec_record_t *rec = &frec_ring[frec_written % FREC_RECORDS];
+  rec->index = frec_written;
+
+  /* Per-period deltas of the cumulative counters, as in the AGG streams */
+  for (u8_t i = 0; i < TELEM_STREAM_COUNT; i++) {
+    rec->values[i] =
+        telemetry_delta(i, &frec_last_counter[i], &frec_last_resets[i]);
+  }
+  frec_written++;
+
+  if (frec_state == FREC_RECORDING && frec_threshold_mode != FREC_REASON_NONE) {
+    u32_t value = rec->values[frec_threshold_stream];
+    if ((frec_threshold_mode == FREC_REASON_ABOVE &&
+         value > frec_threshold_value) ||
+        (frec_threshold_mode == FREC_REASON_BELOW &&
+         value < frec_threshold_value)) {
+      frec_trigger(frec_threshold_mode);
+    }
+  } else if (frec_state == FREC_TRIGGERED &&
+             frec_written - frec_trigger_index >= frec_post_records) {
+    frec_freeze();
+  }
+}
+
+/* Send one chunk of the frozen window; returns 0 to retry on the next pass */
+static int frec_send_chunk(void) {
+  u32_t count = frec_dump_end - frec_dump_next;
+  if (count > FREC_RECORDS_PER_CHUNK) {
+    count = FREC_RECORDS_PER_CHUNK;
+  }
+
+  frec_chunk_header_t hdr;
+  hdr.dump_id = frec_dump_id;
+  hdr.trigger_index = frec_trigger_index;
+  hdr.window_first = frec_dump_first;
+  hdr.window_records = frec_dump_end - frec_dump_first;
+  hdr.first_index = frec_dump_next;
+  hdr.rate_hz = FREC_RATE_HZ;
+  hdr.records = (u16_t)count;
+  hdr.streams = TELEM_STREAM_COUNT;
+  hdr.reason = frec_reason;
+  hdr.reserved = 0;
+
+  /* Built here rather than on the stack, it is a full 1 KB message */
+  static data_message_t chunk;
+  memset(&chunk, 0, sizeof(chunk));
+  chunk.msg_type = MSG_TYPE_FREC;
+  chunk.sequence = (u8_t)frec_dump_chunks;
+  chunk.length = sizeof(hdr) + count * sizeof(frec_record_t);
+  memcpy(chunk.data, &hdr, sizeof(hdr));
+
+  /* Records may wrap around the end of the ring */
+  u8_t *out = &chunk.data[sizeof(hdr)];
+  for (u32_t i = 0; i < count; i++) {
+    memcpy(out, &frec_ring[(frec_dump_next + i) % FREC_RECORDS],
+           sizeof(frec_record_t));
+    out += sizeof(frec_record_t);
+  }
+
+  /* Sent directly, the dump paces itself and must not fill the send queue */
+  if (proto_sendto(&chunk, &frec_dest_ip, frec_dest_port) != ERR_OK) {
+    frec_dump_send_failures++;
+    return 0;
+  }
+
+  frec_dump_next += count;
+  frec_dump_chunks++;
+  return 1;
+}
+
+static void frec_pump_dump(void) {
+  for (int burst = 0; burst < FREC_DUMP_BURST && frec_dump_next < frec_dump_end;
+       burst++) {
+    if (!frec_send_chunk()) {
+      return; // Out of pbufs or TX descriptors, continue on the next pass
+    }
+  }
+
+  if (frec_dump_next >= frec_dump_end) {
+    char report[128];
+    frec_dumping = 0;
+    snprintf(report, sizeof(report),
+             "FREC done dump=%lu records=%lu chunks=%lu retries=%lu",
+             (unsigned long)frec_dump_id,
+             (unsigned long)(frec_dump_end - frec_dump_first),
+             (unsigned long)frec_dump_chunks,
+             (unsigned long)frec_dump_send_failures);
+    xil_printf("[FREC] %s\r\n", report);
+    send_text_message(MSG_TYPE_RESPONSE, frec_cmd_sequence, report,
+                      &frec_dest_ip, frec_dest_port);
+  }
+}
+
+void frec_poll(void) {
+  XTime now;
+  XTime_GetTime(&now);
+
+  if (frec_period == 0) {
+    frec_period = COUNTS_PER_SECOND / FREC_RATE_HZ;
+    frec_next_due = now + frec_period;
+    for (u8_t i = 0; i < TELEM_STREAM_COUNT; i++) {
+      frec_last_counter[i] = telemetry_counter(i);
+      frec_last_resets[i] = stats.resets;
+    }
+  }
+
+  if (frec_state != FREC_FROZEN) {
+    for (int n = 0; n < TELEM_MAX_CATCHUP && now >= frec_next_due &&
+                    frec_state != FREC_FROZEN;
+         n++) {
+      frec_record();
+      frec_next_due += frec_period;
+    }
+    if (now >= frec_next_due) {
+      frec_next_due = now + frec_period; // Too far behind, skip missed samples
+    }
+  }
+
+  if (frec_dumping) {
+    frec_pump_dump();
+  }
+}
+
+static void frec_set_dest(const ip_addr_t *addr, u16_t port, u8_t sequence) {
+  frec_dest_ip = *addr;
+  frec_dest_port = port;
+  frec_cmd_sequence = sequence;
+}
+
+static u16_t frec_status(char *reply, u16_t reply_size) {
+  static const char *const state_names[] = {"recording", "triggered",
+                                            "frozen"};
+  static const char *const reason_names[] = {"none", "command", "above",
+                                             "below"};
+  return snprintf(
+      reply, reply_size,
+      "FREC %s samples=%lu rate=%d capacity=%d pre=%lu post=%lu "
+      "trigger=%lu reason=%s threshold=%s stream=%d value=%lu dump=%lu "
+      "sent=%lu/%lu",
+      state_names[frec_state], (unsigned long)frec_written, FREC_RATE_HZ,
+      FREC_RECORDS, (unsigned long)frec_pre_records,
+      (unsigned long)frec_post_records, (unsigned long)frec_trigger_index,
+      reason_names[frec_reason], reason_names[frec_threshold_mode],
+      frec_threshold_stream, (unsigned long)frec_threshold_value,
+      (unsigned long)frec_dump_id,
+      (unsigned long)(frec_dump_next - frec_dump_first),
+      (unsigned long)(frec_dump_end - frec_dump_first));
+}
+
+u16_t frec_command(const char *args, const ip_addr_t *addr, u16_t port,
+                   u8_t sequence, char *reply, u16_t reply_size) {
+  if (strncmp(args, "TRIGGER", 7) == 0) {
+    if (frec_state != FREC_RECORDING) {
+      return snprintf(reply, reply_size,
+                      "FREC busy: window already captured, FREC ARM first");
+    }
+    frec_set_dest(addr, port, sequence);
+    frec_trigger(FREC_REASON_COMMAND);
+    return 0;
+  } else if (strncmp(args, "THRESHOLD", 9) == 0) {
+    /* FREC THRESHOLD <stream> ABOVE|BELOW <value> | FREC THRESHOLD OFF */
+    char *end;
+    const char *cursor = args + 9;
+    u32_t stream = strtoul(cursor, &end, 0);
+    int has_stream = end != cursor; // Checked before the blanks are skipped
+    while (*end == ' ') {
+      end++;
+    }
+
+    /* The value must be a number too, not whatever follows the keyword */
+    int above = strncmp(end, "ABOVE", 5) == 0;
+    char *value_end = end;
+    u32_t value = 0;
+    if (above || strncmp(end, "BELOW", 5) == 0) {
+      value = strtoul(end + 5, &value_end, 0);
+    }
+
+    if (strncmp(cursor + strspn(cursor, " "), "OFF", 3) == 0) {
+      frec_threshold_mode = FREC_REASON_NONE;
+      return 0;
+    } else if (has_stream && stream < TELEM_STREAM_COUNT &&
+               value_end > end + 5) {
+      frec_threshold_mode = above ? FREC_REASON_ABOVE : FREC_REASON_BELOW;
+      frec_threshold_stream = (u8_t)stream;
+      frec_threshold_value = value;
+      frec_set_dest(addr, port, sequence);
+      return 0;
+    } else {
+      return snprintf(reply, reply_size,
+                      "FREC error: usage FREC THRESHOLD <stream 0-%d> "
+                      "ABOVE|BELOW <value> | OFF",
+                      TELEM_STREAM_COUNT - 1);
+    }
+  } else if (strncmp(args, "WINDOW", 6) == 0) {
+    char *end;
+    u32_t pre_ms = strtoul(args + 6, &end, 0);
+    u32_t post_ms = strtoul(end, NULL, 0);
+    u64 pre = (u64)pre_ms * FREC_RATE_HZ / 1000;
+    u64 post = (u64)post_ms * FREC_RATE_HZ / 1000;
+    if (pre + post == 0 || pre + post >= FREC_RECORDS) {
+      return snprintf(reply, reply_size,
+                      "FREC error: pre + post must be 1..%d ms",
+                      FREC_SECONDS * 1000 - 1);
+    }
+    frec_pre_records = (u32_t)pre;
+    frec_post_records = (u32_t)post;
+    return 0;
+  } else if (strncmp(args, "DUMP", 4) == 0) {
+    if (frec_state != FREC_FROZEN) {
+      return snprintf(reply, reply_size, "FREC error: nothing frozen");
+    }
+    frec_set_dest(addr, port, sequence);
+    frec_start_dump();
+    return 0;
+  } else if (strncmp(args, "ARM", 3) == 0) {
+    frec_dumping = 0;
+    frec_reason = FREC_REASON_NONE;
+    frec_state = FREC_RECORDING;
+    frec_period = 0; // Re-baseline counters that moved while frozen
+    return 0;
+  }
+
+  return frec_status(reply, reply_size);
+}
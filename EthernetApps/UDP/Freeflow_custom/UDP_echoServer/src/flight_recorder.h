@@ -0,0 +1,61 @@
+/*
+ * Flight Recorder Header
+ * Continuous pre-trigger recording of all telemetry streams into a DDR ring
+ */
+
+#ifndef __FLIGHT_RECORDER_H_
+#define __FLIGHT_RECORDER_H_
+
+#include "data_transfer.h"
+#include "telemetry.h"
+
+/* Recorder configuration */
+#define FREC_RATE_HZ 1000         // Records per second, one per sample period
+#define FREC_SECONDS 60           // History kept in the ring
+#define FREC_RECORDS (FREC_RATE_HZ * FREC_SECONDS)
+#define FREC_DEFAULT_PRE_MS 5000  // Window kept before the trigger
+#define FREC_DEFAULT_POST_MS 1000 // Recording continues this long after it
+#define FREC_DUMP_BURST 32        // Dump datagrams per main loop pass
+
+/* One sample of every stream, stored in the ring */
+typedef struct {
+  u32_t index; // Sample number, FREC_RATE_HZ per second while recording
+  u32_t values[TELEM_STREAM_COUNT];
+} frec_record_t;
+
+/* Header at the start of each MSG_TYPE_FREC chunk's data field */
+typedef struct {
+  u32_t dump_id;
+  u32_t trigger_index; // Sample index of the trigger
+  u32_t window_first;  // First sample index in the whole dump
+  u32_t window_records;
+  u32_t first_index;   // First sample index in this chunk
+  u16_t rate_hz;
+  u16_t records;       // Records in this chunk
+  u8_t streams;        // Values per record
+  u8_t reason;         // frec_reason_t
+  u16_t reserved;
+} frec_chunk_header_t;
+
+#define FREC_RECORDS_PER_CHUNK                                                 \
+  ((MAX_DATA_SIZE - 4 - sizeof(frec_chunk_header_t)) / sizeof(frec_record_t))
+
+typedef enum {
+  FREC_RECORDING = 0,
+  FREC_TRIGGERED, // Recording the post-trigger part of the window
+  FREC_FROZEN     // Window preserved, ring no longer written
+} frec_state_t;
+
+typedef enum {
+  FREC_REASON_NONE = 0,
+  FREC_REASON_COMMAND,
+  FREC_REASON_ABOVE, // Threshold stream rose above its limit
+  FREC_REASON_BELOW  // Threshold stream fell below its limit
+} frec_reason_t;
+
+/* Function prototypes */
+void frec_poll(void);
+u16_t frec_command(const char *args, const ip_addr_t *addr, u16_t port,
+                   u8_t sequence, char *reply, u16_t reply_size);
+
+#endif /* __FLIGHT_RECORDER_H_ */
@@ -0,0 +1,335 @@
+/*
+ * Fragment Implementation
+ * A message up to FRAGMENT_MAX_MESSAGE bytes is copied once into the send
+ * buffer and goes out as MSG_TYPE_FRAGMENT datagrams, a few per main loop
+ * pass so the send queue never has to hold all of them. On receive every
+ * fragment is copied straight to its offset in a preallocated slot; the
+ * message is handed over once the last gap is filled and its CRC32C
+ * matches. Slots whose message stops making progress are reclaimed after
+ * FRAGMENT_TIMEOUT_MS, so a lost fragment costs one message, not a slot.
+ * A reply that comes while another message is being sent waits its turn in
+ * a small FIFO instead of being dropped.
+ */
+
+#include "fragment.h"
+#include "crc32c.h"
+#include "send_queue.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Message being sent; only one at a time */
+typedef struct {
+  u8_t active;
+  ip_addr_t addr;
+  u16_t port;
+  u8_t sequence;
+  fragment_header_t hdr; // index is the next fragment to send
+  XTime last_progress;
+  u8_t data[FRAGMENT_MAX_MESSAGE];
+} fragment_tx_t;
+
+/* Message being reassembled */
+typedef struct {
+  u8_t active;
+  u8_t complete; // Delivered; late duplicates are recognised until reuse
+  ip_addr_t addr;
+  u16_t port;
+  u16_t message_id;
+  u16_t count;
+  u16_t arrived;
+  u32_t crc;
+  XTime last_progress;
+  u32_t received[(FRAGMENT_MAX_COUNT + 31) / 32]; // Bit n: fragment n
+  fragment_message_t msg;
+} fragment_rx_t;
+
+/* Message waiting for the send buffer */
+typedef struct {
+  u8_t msg_type;
+  u8_t sequence;
+  ip_addr_t addr;
+  u16_t port;
+  u16_t length;
+  u8_t data[FRAGMENT_WAIT_MAX];
+} fragment_wait_t;
+
+static fragment_tx_t fragment_tx;
+static fragment_wait_t fragment_wait[FRAGMENT_WAIT_SLOTS];
+static u8_t fragment_wait_head; // Oldest waiting message
+static u8_t fragment_wait_count;
+static fragment_rx_t fragment_rx[FRAGMENT_RX_SLOTS];
+static u16_t fragment_next_id;
+static fragment_stats_t fragment_stats;
+
+static XTime fragment_timeout_counts(void) {
+  return (XTime)FRAGMENT_TIMEOUT_MS * (COUNTS_PER_SECOND / 1000);
+}
+
+static u16_t fragment_count(u32_t length) {
+  return (u16_t)((length + FRAGMENT_PAYLOAD - 1) / FRAGMENT_PAYLOAD);
+}
+
+static void fragment_send_next(XTime now) {
+  for (u8_t i = 0; i < FRAGMENT_TX_BUDGET && fragment_tx.active; i++) {
+    data_message_t msg;
+    fragment_header_t hdr = fragment_tx.hdr;
+    u32_t offset = (u32_t)hdr.index * FRAGMENT_PAYLOAD;
+    u32_t len = hdr.total_length - offset;
+    if (len > FRAGMENT_PAYLOAD) {
+      len = FRAGMENT_PAYLOAD;
+    }
+
+    msg.msg_type = MSG_TYPE_FRAGMENT;
+    msg.sequence = fragment_tx.sequence;
+    msg.length = sizeof(hdr) + len;
+    memcpy(msg.data, &hdr, sizeof(hdr));
+    memcpy(&msg.data[sizeof(hdr)], &fragment_tx.data[offset], len);
+
+    /* A refused fragment is retried next pass; the message is given up
+     * only if the queue stays full for the whole timeout */
+    if (sendq_submit(&msg, SENDQ_RELIABLE, &fragment_tx.addr,
+                     fragment_tx.port) != ERR_OK) {
+      if (now - fragment_tx.last_progress > fragment_timeout_counts()) {
+        xil_printf("[ERROR] Fragmented message %d abandoned at %d/%d\r\n",
+                   fragment_tx.hdr.message_id, fragment_tx.hdr.index,
+                   fragment_tx.hdr.count);
+        fragment_stats.tx_abandoned++;
+        fragment_tx.active = 0;
+      }
+      return;
+    }
+
+    fragment_stats.tx_fragments++;
+    fragment_tx.last_progress = now;
+    if (++fragment_tx.hdr.index == fragment_tx.hdr.count) {
+      fragment_tx.active = 0;
+    }
+  }
+}
+
+/* Starts sending the message already in fragment_tx.data */
+static void fragment_start(u8_t msg_type, u8_t sequence, u32_t length,
+                           const ip_addr_t *addr, u16_t port) {
+  fragment_tx.addr = *addr;
+  fragment_tx.port = port;
+  fragment_tx.sequence = sequence;
+  fragment_tx.hdr.message_id = fragment_next_id++;
+  fragment_tx.hdr.index = 0;
+  fragment_tx.hdr.count = fragment_count(length);
+  fragment_tx.hdr.msg_type = msg_type;
+  fragment_tx.hdr.reserved = 0;
+  fragment_tx.hdr.total_length = length;
+  fragment_tx.hdr.crc = crc32c(0, fragment_tx.data, length);
+  XTime_GetTime(&fragment_tx.last_progress);
+  fragment_tx.active = 1;
+  fragment_stats.tx_messages++;
+
+  /* The first fragments go out right away, the rest from fragment_poll */
+  fragment_send_next(fragment_tx.last_progress);
+}
+
+static int fragment_tx_busy(void) {
+  return fragment_tx.active || fragment_wait_count > 0;
+}
+
+/* Moves the oldest waiting message into the send buffer */
+static void fragment_start_waiting(void) {
+  fragment_wait_t *w = &fragment_wait[fragment_wait_head];
+  memcpy(fragment_tx.data, w->data, w->length);
+  fragment_wait_head = (fragment_wait_head + 1) % FRAGMENT_WAIT_SLOTS;
+  fragment_wait_count--;
+  fragment_start(w->msg_type, w->sequence, w->length, &w->addr, w->port);
+}
+
+/* Sends a message of up to FRAGMENT_MAX_MESSAGE bytes to addr:port. The
+ * data is copied, so the caller's buffer is free on return. While another
+ * message is being sent, one of up to FRAGMENT_WAIT_MAX bytes waits in
+ * order; ERR_INPROGRESS means it could not. */
+err_t fragment_send(u8_t msg_type, u8_t sequence, const void *data,
+                    u32_t length, const ip_addr_t *addr, u16_t port) {
+  if (length > FRAGMENT_MAX_MESSAGE) {
+    return ERR_VAL;
+  }
+  if (fragment_tx_busy()) {
+    if (length > FRAGMENT_WAIT_MAX ||
+        fragment_wait_count == FRAGMENT_WAIT_SLOTS) {
+      fragment_stats.tx_busy++;
+      return ERR_INPROGRESS;
+    }
+    fragment_wait_t *w = &fragment_wait[(fragment_wait_head +
+                                         fragment_wait_count) %
+                                        FRAGMENT_WAIT_SLOTS];
+    w->msg_type = msg_type;
+    w->sequence = sequence;
+    w->addr = *addr;
+    w->port = port;
+    w->length = (u16_t)length;
+    memcpy(w->data, data, length);
+    fragment_wait_count++;
+    fragment_stats.tx_queued++;
+    return ERR_OK;
+  }
+
+  memcpy(fragment_tx.data, data, length);
+  fragment_start(msg_type, sequence, length, addr, port);
+  return ERR_OK;
+}
+
+void fragment_poll(void) {
+  XTime now;
+  XTime_GetTime(&now);
+
+  if (!fragment_tx.active && fragment_wait_count > 0) {
+    fragment_start_waiting();
+  } else if (fragment_tx.active) {
+    fragment_send_next(now);
+  }
+
+  for (u8_t i = 0; i < FRAGMENT_RX_SLOTS; i++) {
+    fragment_rx_t *slot = &fragment_rx[i];
+    if (slot->active &&
+        now - slot->last_progress > fragment_timeout_counts()) {
+      xil_printf("[ERROR] Fragmented message %d timed out at %d/%d\r\n",
+                 slot->message_id, slot->arrived, slot->count);
+      fragment_stats.rx_timeouts++;
+      slot->active = 0;
+    }
+  }
+}
+
+static fragment_rx_t *fragment_slot(const fragment_header_t *hdr,
+                                    const ip_addr_t *addr, u16_t port) {
+  fragment_rx_t *unused = NULL;
+  for (u8_t i = 0; i < FRAGMENT_RX_SLOTS; i++) {
+    fragment_rx_t *slot = &fragment_rx[i];
+    if ((slot->active || slot->complete) &&
+        slot->message_id == hdr->message_id &&
+        slot->port == port && ip_addr_cmp(&slot->addr, addr)) {
+      return slot;
+    }
+    if (unused == NULL && !slot->active) {
+      unused = slot;
+    }
+  }
+  return unused;
+}
+
+/* Takes one MSG_TYPE_FRAGMENT message. Returns the whole message once its
+ * last fragment arrived, valid until the next call, and NULL otherwise. */
+const fragment_message_t *fragment_receive(const wire_v1_view_t *msg,
+                                           const ip_addr_t *addr,
+                                           u16_t port) {
+  fragment_header_t hdr;
+  if (msg->length < sizeof(hdr)) {
+    fragment_stats.rx_invalid++;
+    return NULL;
+  }
+  memcpy(&hdr, msg->data, sizeof(hdr));
+  u16_t len = msg->length - sizeof(hdr);
+  u32_t offset = (u32_t)hdr.index * FRAGMENT_PAYLOAD;
+  u32_t expected = hdr.total_length - offset;
+  if (expected > FRAGMENT_PAYLOAD) {
+    expected = FRAGMENT_PAYLOAD;
+  }
+  if (hdr.total_length > FRAGMENT_MAX_MESSAGE ||
+      hdr.count != fragment_count(hdr.total_length) ||
+      hdr.index >= hdr.count || len != expected ||
+      hdr.msg_type == MSG_TYPE_FRAGMENT) {
+    fragment_stats.rx_invalid++;
+    return NULL;
+  }
+  fragment_stats.rx_fragments++;
+
+  fragment_rx_t *slot = fragment_slot(&hdr, addr, port);
+  if (slot == NULL) {
+    fragment_stats.rx_no_slot++;
+    return NULL;
+  }
+  if (slot->complete && slot->message_id == hdr.message_id &&
+      slot->port == port && ip_addr_cmp(&slot->addr, addr)) {
+    fragment_stats.rx_duplicates++;
+    return NULL;
+  }
+  if (!slot->active) {
+    memset(slot->received, 0, sizeof(slot->received));
+    slot->active = 1;
+    slot->complete = 0;
+    slot->addr = *addr;
+    slot->port = port;
+    slot->message_id = hdr.message_id;
+    slot->count = hdr.count;
+    slot->arrived = 0;
+    slot->crc = hdr.crc;
+    slot->msg.msg_type = hdr.msg_type;
+    slot->msg.sequence = msg->sequence;
+    slot->msg.length = hdr.total_length;
+  } else if (slot->msg.length != hdr.total_length ||
+             slot->msg.msg_type != hdr.msg_type) {
+    fragment_stats.rx_invalid++;
+    return NULL;
+  }
+
+  u32_t bit = 1u << (hdr.index % 32);
+  if (slot->received[hdr.index / 32] & bit) {
+    fragment_stats.rx_duplicates++;
+    return NULL;
+  }
+  slot->received[hdr.index / 32] |= bit;
+  memcpy(&slot->msg.data[offset], &msg->data[sizeof(hdr)], len);
+  XTime_GetTime(&slot->last_progress);
+  if (++slot->arrived < slot->count) {
+    return NULL;
+  }
+
+  slot->active = 0;
+  slot->complete = 1;
+  if (crc32c(0, slot->msg.data, slot->msg.length) != slot->crc) {
+    xil_printf("[ERROR] CRC32C mismatch on fragmented message %d\r\n",
+               slot->message_id);
+    fragment_stats.rx_crc_failures++;
+    return NULL;
+  }
+  fragment_stats.rx_messages++;
+  return &slot->msg;
+}
+
+u16_t fragment_command(const char *args, const ip_addr_t *addr, u16_t port,
+                       u8_t sequence, char *reply, u16_t reply_size) {
+  if (strncmp(args, "TEST", 4) == 0) {
+    /* FRAG TEST <bytes>: a text message that size, to check reassembly on
+     * the client. Built in the send buffer itself, so no second copy. */
+    u32_t length = strtoul(args + 4, NULL, 0);
+    if (length == 0 || length > FRAGMENT_MAX_MESSAGE) {
+      return snprintf(reply, reply_size,
+                      "FRAG error: TEST needs 1-%d bytes",
+                      FRAGMENT_MAX_MESSAGE);
+    }
+    if (fragment_tx_busy()) {
+      fragment_stats.tx_busy++;
+    } else {
+      for (u32_t i = 0; i < length; i++) {
+        fragment_tx.data[i] = (i + 1) % 64 == 0 ? '\n' : 'A' + i % 26;
+      }
+      fragment_start(MSG_TYPE_DATA, sequence_counter++, length, addr, port);
+      return 0;
+    }
+  }
+
+  return snprintf(reply, reply_size,
+                  "FRAG tx_messages=%lu tx_fragments=%lu tx_queued=%lu "
+                  "tx_busy=%lu tx_abandoned=%lu rx_messages=%lu "
+                  "rx_fragments=%lu rx_duplicates=%lu rx_invalid=%lu "
+                  "rx_no_slot=%lu rx_timeouts=%lu rx_crc_failures=%lu",
+                  (unsigned long)fragment_stats.tx_messages,
+                  (unsigned long)fragment_stats.tx_fragments,
+                  (unsigned long)fragment_stats.tx_queued,
+                  (unsigned long)fragment_stats.tx_busy,
+                  (unsigned long)fragment_stats.tx_abandoned,
+                  (unsigned long)fragment_stats.rx_messages,
+                  (unsigned long)fragment_stats.rx_fragments,
+                  (unsigned long)fragment_stats.rx_duplicates,
+                  (unsigned long)fragment_stats.rx_invalid,
+                  (unsigned long)fragment_stats.rx_no_slot,
+                  (unsigned long)fragment_stats.rx_timeouts,
+                  (unsigned long)fragment_stats.rx_crc_failures);
+}
@@ -0,0 +1,71 @@
+/*
+ * Fragment Header
+ * Messages larger than one data_message_t split into MSG_TYPE_FRAGMENT
+ * datagrams and reassembled on receive
+ */
+
+#ifndef __FRAGMENT_H_
+#define __FRAGMENT_H_
+
+#include "data_transfer.h"
+
+/* Fragmentation limits */
+#define FRAGMENT_MAX_MESSAGE (64 * 1024) // Largest message either way
+#define FRAGMENT_HEADER_SIZE 16
+#define FRAGMENT_PAYLOAD \
+  (MAX_DATA_SIZE - DATA_HEADER_SIZE - FRAGMENT_HEADER_SIZE) // 1004 bytes
+#define FRAGMENT_MAX_COUNT (FRAGMENT_MAX_MESSAGE / FRAGMENT_PAYLOAD + 1)
+#define FRAGMENT_RX_SLOTS 2       // Messages reassembled at the same time
+#define FRAGMENT_TIMEOUT_MS 2000  // Without progress a message is abandoned
+#define FRAGMENT_TX_BUDGET 4      // Fragments submitted per main loop pass
+#define FRAGMENT_WAIT_SLOTS 2     // Messages held while another is sent
+#define FRAGMENT_WAIT_MAX COMMAND_REPLY_SIZE // Largest message that may wait
+
+/* MSG_TYPE_FRAGMENT data: this header, then bytes index * FRAGMENT_PAYLOAD
+ * onwards of the whole message, FRAGMENT_PAYLOAD of them in every fragment
+ * but the last. The fragment's v1 sequence is the whole message's. Each
+ * fragment stays below the Ethernet MTU, so IP never fragments. */
+typedef struct {
+  u16_t message_id; // Per sender, wraps
+  u16_t index;
+  u16_t count;
+  u8_t msg_type;    // Of the whole message
+  u8_t reserved;
+  u32_t total_length;
+  u32_t crc;        // CRC32C of the whole message data
+} fragment_header_t;
+
+/* A message being reassembled, written in place as fragments arrive */
+typedef struct {
+  u8_t msg_type;
+  u8_t sequence;
+  u16_t reserved;
+  u32_t length;
+  u8_t data[FRAGMENT_MAX_MESSAGE];
+} fragment_message_t;
+
+typedef struct {
+  u32_t tx_messages;
+  u32_t tx_fragments;
+  u32_t tx_queued;      // Waited for the previous large message to finish
+  u32_t tx_busy;        // Refused: too large to wait, or no wait slot free
+  u32_t tx_abandoned;   // Fragments could not be queued for too long
+  u32_t rx_messages;
+  u32_t rx_fragments;
+  u32_t rx_duplicates;
+  u32_t rx_invalid;     // Header inconsistent with itself or its message
+  u32_t rx_no_slot;     // Every reassembly slot busy with another message
+  u32_t rx_timeouts;
+  u32_t rx_crc_failures;
+} fragment_stats_t;
+
+/* Function prototypes */
+err_t fragment_send(u8_t msg_type, u8_t sequence, const void *data,
+                    u32_t length, const ip_addr_t *addr, u16_t port);
+const fragment_message_t *fragment_receive(const wire_v1_view_t *msg,
+                                           const ip_addr_t *addr, u16_t port);
+void fragment_poll(void);
+u16_t fragment_command(const char *args, const ip_addr_t *addr, u16_t port,
+                       u8_t sequence, char *reply, u16_t reply_size);
+
+#endif /* __FRAGMENT_H_ */
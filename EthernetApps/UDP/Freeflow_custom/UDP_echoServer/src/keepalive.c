@@ -0,0 +1,128 @@
+/*
+ * Keepalive Implementation
+ * Any datagram from the client proves it is alive, so heartbeats are only
+ * sent after KEEPALIVE_IDLE_MS of receive silence. The client answers a probe
+ * with an ACK heartbeat, which gives an RTT sample; the probe timeout and so
+ * the session timeout follow the measured RTT instead of a loop count.
+ */
+
+#include "keepalive.h"
+#include "send_queue.h"
+#include <string.h>
+
+static keepalive_stats_t ka;
+static XTime last_rx;
+static XTime probe_time;
+static u8_t probe_sequence;
+static u8_t probes_outstanding; // Sent since the last datagram from the client
+
+static XTime ms_to_ticks(u32_t ms) {
+  return (XTime)ms * (COUNTS_PER_SECOND / 1000);
+}
+
+void keepalive_reset(void) {
+  XTime_GetTime(&last_rx);
+  probes_outstanding = 0;
+  stats.connection_timeout_counter = 0;
+}
+
+u32_t keepalive_rto_ms(void) {
+  if (ka.rtt_samples == 0) {
+    return KEEPALIVE_INITIAL_RTO_MS;
+  }
+  u32_t rto = (ka.srtt_us + 4 * ka.rttvar_us) / 1000;
+  if (rto < KEEPALIVE_MIN_RTO_MS) {
+    rto = KEEPALIVE_MIN_RTO_MS;
+  }
+  return rto > KEEPALIVE_MAX_RTO_MS ? KEEPALIVE_MAX_RTO_MS : rto;
+}
+
+static void keepalive_rtt_sample(u32_t rtt_us) {
+  if (ka.rtt_samples == 0) {
+    ka.srtt_us = rtt_us;
+    ka.rttvar_us = rtt_us / 2;
+  } else {
+    u32_t err = rtt_us > ka.srtt_us ? rtt_us - ka.srtt_us : ka.srtt_us - rtt_us;
+    ka.rttvar_us = (3 * ka.rttvar_us + err) / 4;
+    ka.srtt_us = (7 * ka.srtt_us + rtt_us) / 8;
+  }
+  ka.rtt_samples++;
+}
+
+void keepalive_on_rx(const wire_v1_view_t *msg, u16_t data_len,
+                     const ip_addr_t *addr, u16_t port) {
+  XTime_GetTime(&last_rx);
+
+  if (msg->msg_type == MSG_TYPE_HEARTBEAT) {
+    size_t prefix_len = strlen(KEEPALIVE_ACK_PREFIX);
+    if (data_len >= prefix_len &&
+        memcmp(msg->data, KEEPALIVE_ACK_PREFIX, prefix_len) == 0) {
+      /* Answer to our probe; only the outstanding one gives a clean RTT */
+      ka.acks_received++;
+      if (probes_outstanding > 0 && msg->sequence == probe_sequence) {
+        keepalive_rtt_sample(
+            (u32_t)((last_rx - probe_time) / (COUNTS_PER_SECOND / 1000000)));
+      }
+    } else {
+      /* Client probe: echo it back trimmed to its text */
+      data_message_t ack;
+      ack.msg_type = MSG_TYPE_HEARTBEAT;
+      ack.sequence = msg->sequence;
+      ack.length = snprintf((char *)ack.data, sizeof(ack.data), "%s%.*s",
+                            KEEPALIVE_ACK_PREFIX, (int)data_len, msg->data);
+      if (ack.length >= sizeof(ack.data)) {
+        ack.length = sizeof(ack.data) - 1;
+      }
+      sendq_submit(&ack, SENDQ_TELEMETRY, addr, port);
+      ka.acks_sent++;
+    }
+  }
+
+  probes_outstanding = 0;
+  stats.connection_timeout_counter = 0;
+}
+
+int keepalive_poll(void) {
+  if (qt_client_port == 0) {
+    return 0;
+  }
+
+  XTime now;
+  XTime_GetTime(&now);
+
+  if (probes_outstanding == 0) {
+    if (now - last_rx < ms_to_ticks(KEEPALIVE_IDLE_MS)) {
+      return 0; // Traffic is flowing, nothing to prove
+    }
+  } else if (now - probe_time < ms_to_ticks(keepalive_rto_ms())) {
+    return 0; // Waiting for the answer to the last probe
+  }
+
+  if (probes_outstanding >= KEEPALIVE_PROBES) {
+    ka.timeouts++;
+    probes_outstanding = 0;
+    return 1;
+  }
+
+  probe_sequence = send_heartbeat();
+  probe_time = now;
+  probes_outstanding++;
+  stats.connection_timeout_counter = probes_outstanding;
+  ka.probes++;
+  return 0;
+}
+
+u16_t keepalive_command(const char *args, const ip_addr_t *addr, u16_t port,
+                        u8_t sequence, char *reply, u16_t reply_size) {
+  u32_t rto = keepalive_rto_ms();
+  return snprintf(reply, reply_size,
+                  "KEEPALIVE idle_ms=%d rto_ms=%lu timeout_ms=%lu "
+                  "srtt_us=%lu rttvar_us=%lu samples=%lu probes=%lu "
+                  "acks_sent=%lu acks_received=%lu timeouts=%lu",
+                  KEEPALIVE_IDLE_MS, (unsigned long)rto,
+                  (unsigned long)(KEEPALIVE_IDLE_MS + KEEPALIVE_PROBES * rto),
+                  (unsigned long)ka.srtt_us, (unsigned long)ka.rttvar_us,
+                  (unsigned long)ka.rtt_samples, (unsigned long)ka.probes,
+                  (unsigned long)ka.acks_sent,
+                  (unsigned long)ka.acks_received, (unsigned long)ka.timeouts);
+}
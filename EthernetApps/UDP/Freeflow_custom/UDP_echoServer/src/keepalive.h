@@ -0,0 +1,38 @@
+/*
+ * Keepalive Header
+ * Traffic-aware liveness: probes only after the link goes quiet
+ */
+
+#ifndef __KEEPALIVE_H_
+#define __KEEPALIVE_H_
+
+#include "data_transfer.h"
+
+/* Keepalive tuning */
+#define KEEPALIVE_IDLE_MS 5000        // Receive silence before the first probe
+#define KEEPALIVE_PROBES 3            // Unanswered probes before a timeout
+#define KEEPALIVE_INITIAL_RTO_MS 1000 // Probe timeout until an RTT is measured
+#define KEEPALIVE_MIN_RTO_MS 200
+#define KEEPALIVE_MAX_RTO_MS 5000
+#define KEEPALIVE_ACK_PREFIX "ACK " // Heartbeat replies echo the probe text
+
+typedef struct {
+  u32_t probes;        // Heartbeats sent because the link was idle
+  u32_t acks_sent;     // Replies to the client's probes
+  u32_t acks_received;
+  u32_t timeouts;      // Sessions dropped after KEEPALIVE_PROBES misses
+  u32_t rtt_samples;
+  u32_t srtt_us;       // Smoothed RTT and variation, RFC 6298 style
+  u32_t rttvar_us;
+} keepalive_stats_t;
+
+/* Function prototypes */
+void keepalive_reset(void);
+void keepalive_on_rx(const wire_v1_view_t *msg, u16_t data_len,
+                     const ip_addr_t *addr, u16_t port);
+int keepalive_poll(void); // Returns 1 once the session has timed out
+u32_t keepalive_rto_ms(void);
+u16_t keepalive_command(const char *args, const ip_addr_t *addr, u16_t port,
+                        u8_t sequence, char *reply, u16_t reply_size);
+
+#endif /* __KEEPALIVE_H_ */
@@ -0,0 +1,113 @@
+/*
+ * LZ4 Block Implementation
+ * Greedy single-pass LZ4: a hash of the next 4 bytes finds the last place
+ * they occurred, matches are extended both ways and emitted as standard LZ4
+ * sequences, so any LZ4 block decoder can read the output. The only state
+ * is a static 2 KB position table. Messages are at most 1020 bytes, so
+ * positions and offsets fit in a u16.
+ */
+
+#include "lz4_block.h"
+#include <string.h>
+
+static u16_t lz4_table[1 << LZ4_HASH_LOG];
+
+static u32_t lz4_read32(const u8_t *p) {
+  u32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+static u32_t lz4_hash(u32_t seq) {
+  return (seq * 2654435761u) >> (32 - LZ4_HASH_LOG);
+}
+
+/* Length field continuation: 255 per byte, then the remainder */
+static u8_t *lz4_write_length(u8_t *op, u16_t len) {
+  while (len >= 255) {
+    *op++ = 255;
+    len -= 255;
+  }
+  *op++ = (u8_t)len;
+  return op;
+}
+
+/* Worst case bytes for one sequence: token, length continuations, literals
+ * and offset */
+static u16_t lz4_sequence_bound(u16_t literals, u16_t match_extra) {
+  return 1 + (literals / 255 + 1) + literals + 2 + (match_extra / 255 + 1);
+}
+
+/* Compresses src into at most dst_cap bytes. Returns the compressed size,
+ * or 0 if the input is too short or does not fit in dst_cap. */
+u16_t lz4_compress(const u8_t *src, u16_t src_len, u8_t *dst, u16_t dst_cap) {
+  if (src_len < LZ4_MIN_INPUT) {
+    return 0;
+  }
+
+  memset(lz4_table, 0, sizeof(lz4_table));
+  const u16_t match_start_limit = src_len - LZ4_MFLIMIT;
+  const u16_t match_end_limit = src_len - LZ4_LAST_LITERALS;
+  u8_t *op = dst;
+  u16_t anchor = 0;
+  u16_t ip = 0;
+
+  while (ip <= match_start_limit) {
+    u32_t seq = lz4_read32(src + ip);
+    u32_t h = lz4_hash(seq);
+    u16_t ref = lz4_table[h];
+    lz4_table[h] = ip;
+    if (ref >= ip || lz4_read32(src + ref) != seq) {
+      ip++;
+      continue;
+    }
+
+    /* Extend backwards into pending literals, then forwards */
+    while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1]) {
+      ip--;
+      ref--;
+    }
+    u16_t len = LZ4_MIN_MATCH;
+    while (ip + len < match_end_limit && src[ip + len] == src[ref + len]) {
+      len++;
+    }
+
+    u16_t literals = ip - anchor;
+    u16_t match_extra = len - LZ4_MIN_MATCH;
+    if ((u16_t)(op - dst) + lz4_sequence_bound(literals, match_extra) >
+        dst_cap) {
+      return 0;
+    }
+
+    u8_t *token = op++;
+    *token = (u8_t)((literals < 15 ? literals : 15) << 4);
+    if (literals >= 15) {
+      op = lz4_write_length(op, literals - 15);
+    }
+    memcpy(op, src + anchor, literals);
+    op += literals;
+    *op++ = (u8_t)(ip - ref);
+    *op++ = (u8_t)((ip - ref) >> 8);
+    *token |= (u8_t)(match_extra < 15 ? match_extra : 15);
+    if (match_extra >= 15) {
+      op = lz4_write_length(op, match_extra - 15);
+    }
+
+    ip += len;
+    anchor = ip;
+  }
+
+  /* Everything after the last match goes out as literals */
+  u16_t literals = src_len - anchor;
+  if ((u16_t)(op - dst) + 1 + (literals / 255 + 1) + literals > dst_cap) {
+    return 0;
+  }
+  *op++ = (u8_t)((literals < 15 ? literals : 15) << 4);
+  if (literals >= 15) {
+    op = lz4_write_length(op, literals - 15);
+  }
+  memcpy(op, src + anchor, literals);
+  op += literals;
+
+  return (u16_t)(op - dst);
+}
@@ -0,0 +1,21 @@
+/*
+ * LZ4 Block Header
+ * LZ4 block format compressor for message payloads, no heap
+ */
+
+#ifndef __LZ4_BLOCK_H_
+#define __LZ4_BLOCK_H_
+
+#include "data_transfer.h"
+
+/* Compressor tuning */
+#define LZ4_HASH_LOG 10        // Match finder table: 1 << 10 u16 positions
+#define LZ4_MIN_INPUT 32       // Shorter payloads are never worth it
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5    // Format rule: a block ends with 5 literals
+#define LZ4_MFLIMIT 12         // and its last match starts 12 bytes before
+
+/* Function prototypes */
+u16_t lz4_compress(const u8_t *src, u16_t src_len, u8_t *dst, u16_t dst_cap);
+
+#endif /* __LZ4_BLOCK_H_ */
@@ -23,6 +23,7 @@
 #include "platform.h"
 #include "platform_config.h"
 #include "data_transfer.h"
+#include "deferred_work.h"
 #ifdef __arm__
 #include "xil_printf.h"
 #endif
@@ -109,6 +110,7 @@ int main()
 	while (1) {
 		xemacif_input(echo_netif);
 		transfer_data();
+		deferred_work_run(DEFERRED_WORK_BUDGET);
 	}
 
 	/* never reached */
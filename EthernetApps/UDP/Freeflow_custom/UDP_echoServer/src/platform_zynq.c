@@ -56,6 +56,8 @@
 #include "platform.h"
 #include "platform_config.h"
 #include "netif/xadapter.h"
+#include "deferred_work.h"
+#include "rx_watchdog.h"
 #ifdef PLATFORM_ZYNQ
 #include "xscutimer.h"
 
@@ -65,17 +67,11 @@
 #define INTC_DIST_BASE_ADDR	XPAR_SCUGIC_0_DIST_BASEADDR
 #define TIMER_IRPT_INTR		XPAR_SCUTIMER_INTR
 
-#define RESET_RX_CNTR_LIMIT	400
-
 void tcp_fasttmr(void);
 void tcp_slowtmr(void);
 
 static XScuTimer TimerInstance;
 
-#ifndef USE_SOFTETH_ON_ZYNQ
-static int ResetRxCntr = 0;
-#endif
-
 extern struct netif *echo_netif;
 
 volatile int TcpFastTmrFlag = 0;
@@ -87,6 +83,28 @@ void dhcp_fine_tmr();
 void dhcp_coarse_tmr();
 #endif
 
+/* Set by the ISR when a job is queued, cleared once the main loop ran it,
+ * so a stalled main loop never sees the same job queued twice.
+ */
+#ifndef USE_SOFTETH_ON_ZYNQ
+static volatile int RxWatchdogPending = 0;
+#endif
+static volatile int LinkDetectPending = 0;
+
+#ifndef USE_SOFTETH_ON_ZYNQ
+static void deferred_rx_watchdog(void *arg)
+{
+	rx_watchdog_poll();
+	RxWatchdogPending = 0;
+}
+#endif
+
+static void deferred_link_detect(void *arg)
+{
+	eth_link_detect((struct netif *)arg);
+	LinkDetectPending = 0;
+}
+
 void
 timer_callback(XScuTimer * TimerInstance)
 {
@@ -102,9 +120,6 @@ timer_callback(XScuTimer * TimerInstance)
 	 TcpFastTmrFlag = 1;
 
 	odd = !odd;
-#ifndef USE_SOFTETH_ON_ZYNQ
-	ResetRxCntr++;
-#endif
 	if (odd) {
 #if LWIP_DHCP==1
 		dhcp_timer++;
@@ -122,21 +137,25 @@ timer_callback(XScuTimer * TimerInstance)
 
 	/* For providing an SW alternative for the SI #692601. Under heavy
 	 * Rx traffic if at some point the Rx path becomes unresponsive, the
-	 * following API call will ensures a SW reset of the Rx path. The
-	 * API xemacpsif_resetrx_on_no_rxdata is called every 100 milliseconds.
-	 * This ensures that if the above HW bug is hit, in the worst case,
-	 * the Rx path cannot become unresponsive for more than 100
-	 * milliseconds.
+	 * Rx path has to be reset in SW. Instead of resetting on a fixed
+	 * schedule whenever no frame arrived, rx_watchdog_poll samples the
+	 * GEM statistics every tick and only resets when the RX activity
+	 * shows a stall (see rx_watchdog.c).
+	 *
+	 * The poll and the PHY link check below both do register/MDIO
+	 * transactions, so they are only queued here and run from the main
+	 * loop; the ISR itself stays short and constant time.
 	 */
 #ifndef USE_SOFTETH_ON_ZYNQ
-	if (ResetRxCntr >= RESET_RX_CNTR_LIMIT) {
-		xemacpsif_resetrx_on_no_rxdata(echo_netif);
-		ResetRxCntr = 0;
-	}
+	if (!RxWatchdogPending &&
+	    deferred_work_post(deferred_rx_watchdog, NULL) == 0)
+		RxWatchdogPending = 1;
 #endif
 	/* For detecting Ethernet phy link status periodically */
 	if (DetectEthLinkStatus == ETH_LINK_DETECT_INTERVAL) {
-		eth_link_detect(echo_netif);
+		if (!LinkDetectPending &&
+		    deferred_work_post(deferred_link_detect, echo_netif) == 0)
+			LinkDetectPending = 1;
 		DetectEthLinkStatus = 0;
 	}
 
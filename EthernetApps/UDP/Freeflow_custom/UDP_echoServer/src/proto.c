@@ -0,0 +1,381 @@
+/*
+ * Protocol Implementation
+ * Received messages reach the handlers as a wire_v1_view_t pointing into
+ * the datagram, whichever framing it came in. A peer that sends v2 gets v2
+ * back: on send every message gets a 32-bit per-stream sequence and a
+ * microsecond timestamp, which lets the receiver count loss, reordering and
+ * jitter.
+ * Peers that only ever sent v1 keep getting the v1 framing.
+ */
+
+#include "proto.h"
+#include "crc32c.h"
+#include "lz4_block.h"
+#include <string.h>
+
+static proto_peer_t proto_peers[PROTO_PEERS];
+static u8_t proto_next_peer; // Slot reused next when every slot is taken
+static proto_rx_stream_t proto_rx[PROTO_RX_STREAMS];
+static u32_t proto_rx_v1;
+static u32_t proto_rx_v2;
+static u32_t proto_rx_errors;
+static u32_t proto_rx_untracked; // v2 messages on streams beyond the table
+static u32_t proto_crc_ok;
+static u32_t proto_crc_failures;
+static u32_t proto_lz4_packed;  // Messages sent compressed
+static u32_t proto_lz4_skipped; // Tried, but compression did not shrink them
+static u32_t proto_lz4_in;      // Payload bytes before and after compression
+static u32_t proto_lz4_out;
+static u32_t proto_bench_ns;       // Last PROTO BENCH result, per round trip
+static u32_t proto_bench_failures; // Round trips that came back different
+
+/* A datagram split over a pbuf chain is gathered here, the only case where
+ * a received message is copied; valid until the next receive */
+static u8_t proto_rx_buf[WIRE_V2_HEADER_SIZE + WIRE_V1_MAX_DATA + CRC32C_SIZE];
+
+/* Compressed payload of the message being sent */
+static u8_t proto_lz4_buf[sizeof(((data_message_t *)0)->data)];
+
+static u64 proto_now_us(void) {
+  XTime now;
+  XTime_GetTime(&now);
+  return now / (COUNTS_PER_SECOND / 1000000);
+}
+
+static proto_peer_t *proto_peer(const ip_addr_t *addr, u16_t port) {
+  for (int i = 0; i < PROTO_PEERS; i++) {
+    if (proto_peers[i].port == port &&
+        ip_addr_cmp(&proto_peers[i].addr, addr)) {
+      return &proto_peers[i];
+    }
+  }
+  return NULL;
+}
+
+/* Remember the version and trailer a peer last used; a new peer takes the
+ * next slot in turn, with fresh send sequences */
+static void proto_peer_seen(const ip_addr_t *addr, u16_t port, u8_t version,
+                            u8_t crc) {
+  proto_peer_t *peer = proto_peer(addr, port);
+  if (peer == NULL) {
+    peer = &proto_peers[proto_next_peer];
+    proto_next_peer = (proto_next_peer + 1) % PROTO_PEERS;
+    memset(peer, 0, sizeof(*peer));
+    peer->addr = *addr;
+    peer->port = port;
+  }
+  peer->version = version;
+  peer->crc = crc;
+}
+
+static proto_rx_stream_t *proto_rx_stream(u16_t stream_id) {
+  proto_rx_stream_t *unused = NULL;
+  for (int i = 0; i < PROTO_RX_STREAMS; i++) {
+    if (proto_rx[i].active && proto_rx[i].stream_id == stream_id) {
+      return &proto_rx[i];
+    }
+    if (unused == NULL && !proto_rx[i].active) {
+      unused = &proto_rx[i];
+    }
+  }
+  return unused;
+}
+
+static void proto_track(const wire_v2_header_t *hdr) {
+  proto_rx_stream_t *s = proto_rx_stream(hdr->stream_id);
+  if (s == NULL) {
+    proto_rx_untracked++;
+    return;
+  }
+
+  if (!s->active) {
+    memset(s, 0, sizeof(*s));
+    s->active = 1;
+    s->stream_id = hdr->stream_id;
+  }
+  if (seq_window_add(&s->seq, hdr->sequence) == SEQ_DUPLICATE) {
+    return;
+  }
+
+  /* Interarrival jitter as in RFC 3550; the clocks need not agree, only
+   * tick at the same rate */
+  s64 transit = (s64)(proto_now_us() - hdr->timestamp);
+  if (s->received > 0) {
+    s64 d = transit - s->last_transit_us;
+    u32_t delta = (u32_t)(d < 0 ? -d : d);
+    s->jitter_us += ((s32_t)delta - (s32_t)s->jitter_us) / 16;
+  }
+  s->last_transit_us = transit;
+  s->received++;
+}
+
+err_t proto_decode(struct pbuf *p, const ip_addr_t *addr, u16_t port,
+                   wire_v1_view_t *msg) {
+  const u8_t *raw = (const u8_t *)p->payload;
+  if (p->len < p->tot_len) {
+    if (p->tot_len > sizeof(proto_rx_buf)) {
+      xil_printf("[ERROR] Received oversized packet: %d bytes\r\n",
+                 p->tot_len);
+      proto_rx_errors++;
+      return ERR_VAL;
+    }
+    pbuf_copy_partial(p, proto_rx_buf, p->tot_len, 0);
+    raw = proto_rx_buf;
+  }
+
+  if (wire_is_v2(raw, p->tot_len)) {
+    wire_v2_view_t v2;
+    wire_status_t status = wire_v2_decode(raw, p->tot_len, &v2);
+    if (status != WIRE_OK) {
+      xil_printf("[ERROR] Received v2 packet with bad %s: %d bytes\r\n",
+                 status == WIRE_ERR_SHORT ? "header" : "length", p->tot_len);
+      proto_rx_errors++;
+      return ERR_VAL;
+    }
+    if (v2.crc != NULL) {
+      u16_t covered = WIRE_V2_HEADER_SIZE + v2.hdr.length;
+      if (crc32c(0, raw, covered) != wire_get_u32(v2.crc)) {
+        xil_printf("[ERROR] CRC32C mismatch on v2 type %d tag %d\r\n",
+                   v2.hdr.msg_type, v2.hdr.tag);
+        proto_crc_failures++;
+        return ERR_VAL;
+      }
+      proto_crc_ok++;
+    }
+    /* Compression is offered one way only: the board packs, never unpacks */
+    if (v2.hdr.flags & WIRE_FLAG_LZ4) {
+      xil_printf("[ERROR] Received LZ4 payload on v2 type %d tag %d\r\n",
+                 v2.hdr.msg_type, v2.hdr.tag);
+      proto_rx_errors++;
+      return ERR_VAL;
+    }
+
+    msg->msg_type = v2.hdr.msg_type;
+    msg->sequence = v2.hdr.tag;
+    msg->length = v2.hdr.length;
+    msg->data = v2.data;
+
+    proto_peer_seen(addr, port, 2, v2.crc != NULL);
+    proto_track(&v2.hdr);
+    proto_rx_v2++;
+    return ERR_OK;
+  }
+
+  wire_status_t status = wire_v1_decode(raw, p->tot_len, msg);
+  if (status != WIRE_OK) {
+    xil_printf("[ERROR] Received packet with bad %s: %d bytes\r\n",
+               status == WIRE_ERR_SHORT ? "header" : "length", p->tot_len);
+    proto_rx_errors++;
+    return ERR_VAL;
+  }
+
+  proto_peer_seen(addr, port, 1, 0);
+  proto_rx_v1++;
+  return ERR_OK;
+}
+
+static int proto_is_v2(const proto_peer_t *peer) {
+  return peer != NULL && peer->version == 2;
+}
+
+err_t proto_sendto(const data_message_t *msg, const ip_addr_t *addr,
+                   u16_t port) {
+  proto_peer_t *peer = proto_peer(addr, port);
+  int v2 = proto_is_v2(peer);
+
+  /* Compress only when it actually saves bytes */
+  const u8_t *data = msg->data;
+  u16_t data_len = msg->length;
+  u8_t lz4 = 0;
+  if (v2 && peer->lz4 && msg->length >= LZ4_MIN_INPUT) {
+    u16_t packed = lz4_compress(msg->data, msg->length, proto_lz4_buf,
+                                msg->length - 1);
+    if (packed != 0) {
+      data = proto_lz4_buf;
+      data_len = packed;
+      lz4 = 1;
+    } else {
+      proto_lz4_skipped++;
+    }
+  }
+
+  u16_t size = v2 ? WIRE_V2_HEADER_SIZE + data_len +
+                        (peer->crc ? CRC32C_SIZE : 0)
+                  : message_wire_size(msg);
+  struct pbuf *pbuf = pbuf_alloc(PBUF_TRANSPORT, size, PBUF_RAM);
+  if (pbuf == NULL) {
+    return ERR_MEM;
+  }
+
+  u32_t *tx_sequence = NULL;
+  if (v2) {
+    wire_v2_header_t hdr;
+    u8_t *out = (u8_t *)pbuf->payload;
+    tx_sequence = &peer->tx_sequence[msg->msg_type % PROTO_TX_STREAMS];
+    hdr.version = WIRE_V2_VERSION;
+    hdr.msg_type = msg->msg_type;
+    hdr.flags = (msg->msg_type == MSG_TYPE_RESPONSE ||
+                 msg->msg_type == MSG_TYPE_BATCH_RESULT)
+                    ? WIRE_FLAG_REPLY
+                    : 0;
+    if (peer->crc) {
+      hdr.flags |= WIRE_FLAG_CRC;
+    }
+    if (lz4) {
+      hdr.flags |= WIRE_FLAG_LZ4;
+    }
+    hdr.tag = msg->sequence;
+    hdr.sequence = *tx_sequence;
+    hdr.timestamp = proto_now_us();
+    hdr.stream_id = msg->msg_type;
+    hdr.length = data_len;
+    wire_v2_encode(out, &hdr);
+    memcpy(out + WIRE_V2_HEADER_SIZE, data, data_len);
+    if (peer->crc) {
+      u16_t covered = WIRE_V2_HEADER_SIZE + data_len;
+      wire_put_u32(out + covered, crc32c(0, out, covered));
+    }
+  } else {
+    /* Full frames carry whatever follows the data in msg, as they always
+     * have; the header is encoded field by field */
+    u8_t *out = (u8_t *)pbuf->payload;
+    wire_v1_encode(out, msg->msg_type, msg->sequence, msg->length);
+    memcpy(out + DATA_HEADER_SIZE, msg->data, size - DATA_HEADER_SIZE);
+  }
+
+  err_t err = udp_sendto(data_pcb, pbuf, addr, port);
+  pbuf_free(pbuf);
+
+  /* A send that failed is retried with the same sequence, so the receiver
+   * sees no gap */
+  if (err == ERR_OK) {
+    if (tx_sequence != NULL) {
+      (*tx_sequence)++;
+    }
+    if (lz4) {
+      proto_lz4_packed++;
+      proto_lz4_in += msg->length;
+      proto_lz4_out += data_len;
+    }
+    stats.packets_sent++;
+    stats.bytes_sent += size;
+  }
+  return err;
+}
+
+static int proto_bench_same(const wire_v2_header_t *a,
+                            const wire_v2_header_t *b) {
+  return a->version == b->version && a->msg_type == b->msg_type &&
+         a->flags == b->flags && a->tag == b->tag &&
+         a->sequence == b->sequence && a->timestamp == b->timestamp &&
+         a->stream_id == b->stream_id && a->length == b->length;
+}
+
+/* Encodes and decodes a v2 and a v1 header per round, every field
+ * compared, so the codec's cost is measured together with its
+ * correctness */
+static void proto_bench(void) {
+  static u8_t frame[WIRE_V2_HEADER_SIZE + 16 + WIRE_CRC_SIZE];
+  wire_v2_header_t hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.version = WIRE_V2_VERSION;
+  hdr.flags = WIRE_FLAG_CRC;
+  hdr.length = 16;
+  proto_bench_failures = 0;
+
+  XTime start, end;
+  XTime_GetTime(&start);
+  for (u32_t r = 0; r < PROTO_BENCH_ROUNDS; r++) {
+    wire_v2_view_t v2;
+    wire_v1_view_t v1;
+    hdr.msg_type = (u8_t)(r & 0x7F);
+    hdr.tag = (u8_t)(r >> 7);
+    hdr.sequence = r * 0x9E3779B1u; // Every byte of each field exercised
+    hdr.timestamp = ((u64)r << 40) | r;
+    hdr.stream_id = (u16_t)(r * 31);
+
+    wire_v2_encode(frame, &hdr);
+    if (wire_v2_decode(frame, sizeof(frame), &v2) != WIRE_OK ||
+        !proto_bench_same(&v2.hdr, &hdr) ||
+        v2.data != frame + WIRE_V2_HEADER_SIZE) {
+      proto_bench_failures++;
+    }
+    wire_v1_encode(frame, hdr.msg_type, hdr.tag, hdr.length);
+    if (wire_v1_decode(frame, sizeof(frame), &v1) != WIRE_OK ||
+        v1.msg_type != hdr.msg_type || v1.sequence != hdr.tag ||
+        v1.length != hdr.length || v1.data != frame + WIRE_V1_HEADER_SIZE) {
+      proto_bench_failures++;
+    }
+  }
+  XTime_GetTime(&end);
+  proto_bench_ns = (u32_t)((end - start) * 1000000000ULL /
+                           COUNTS_PER_SECOND / PROTO_BENCH_ROUNDS);
+}
+
+u16_t proto_command(const char *args, const ip_addr_t *addr, u16_t port,
+                    u8_t sequence, char *reply, u16_t reply_size) {
+  if (strncmp(args, "RESET", 5) == 0) {
+    memset(proto_rx, 0, sizeof(proto_rx));
+    proto_rx_v1 = 0;
+    proto_rx_v2 = 0;
+    proto_rx_errors = 0;
+    proto_rx_untracked = 0;
+    proto_crc_ok = 0;
+    proto_crc_failures = 0;
+    proto_lz4_packed = 0;
+    proto_lz4_skipped = 0;
+    proto_lz4_in = 0;
+    proto_lz4_out = 0;
+    return 0;
+  }
+
+  /* PROTO BENCH: round trips through the wire.h codec */
+  if (strncmp(args, "BENCH", 5) == 0) {
+    proto_bench();
+  }
+
+  /* PROTO LZ4 ON|OFF: compressed payloads for the caller, v2 only */
+  proto_peer_t *self = proto_peer(addr, port);
+  if (self != NULL && strncmp(args, "LZ4 ON", 6) == 0) {
+    self->lz4 = 1;
+    return 0;
+  } else if (self != NULL && strncmp(args, "LZ4 OFF", 7) == 0) {
+    self->lz4 = 0;
+    return 0;
+  }
+
+  int len = snprintf(reply, reply_size,
+                     "PROTO you=v%d%s%s rx_v1=%lu rx_v2=%lu errors=%lu "
+                     "untracked=%lu crc_ok=%lu crc_failures=%lu "
+                     "lz4_packed=%lu lz4_skipped=%lu lz4_bytes=%lu->%lu "
+                     "bench_ns=%lu%s",
+                     self != NULL ? self->version : 1,
+                     self != NULL && self->crc ? "+crc" : "",
+                     self != NULL && self->lz4 ? "+lz4" : "",
+                     (unsigned long)proto_rx_v1, (unsigned long)proto_rx_v2,
+                     (unsigned long)proto_rx_errors,
+                     (unsigned long)proto_rx_untracked,
+                     (unsigned long)proto_crc_ok,
+                     (unsigned long)proto_crc_failures,
+                     (unsigned long)proto_lz4_packed,
+                     (unsigned long)proto_lz4_skipped,
+                     (unsigned long)proto_lz4_in,
+                     (unsigned long)proto_lz4_out,
+                     (unsigned long)proto_bench_ns,
+                     proto_bench_failures != 0 ? " BENCH FAILED" : "");
+  for (int i = 0; i < PROTO_RX_STREAMS && len < reply_size; i++) {
+    const proto_rx_stream_t *s = &proto_rx[i];
+    if (!s->active) {
+      continue;
+    }
+    len += snprintf(reply + len, reply_size - len,
+                    " | stream %d highest=%lu received=%lu lost=%lu "
+                    "reordered=%lu duplicates=%lu jitter_us=%lu",
+                    s->stream_id, (unsigned long)s->seq.highest,
+                    (unsigned long)s->received, (unsigned long)s->seq.lost,
+                    (unsigned long)s->seq.reordered,
+                    (unsigned long)s->seq.duplicates,
+                    (unsigned long)s->jitter_us);
+  }
+  return len < reply_size ? len : reply_size - 1;
+}
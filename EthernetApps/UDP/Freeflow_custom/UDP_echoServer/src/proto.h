@@ -0,0 +1,48 @@
+/*
+ * Protocol Header
+ * v1/v2 wire framing of data_message_t, negotiated per peer
+ */
+
+#ifndef __PROTO_H_
+#define __PROTO_H_
+
+#include "data_transfer.h"
+#include "seq_window.h"
+
+/* v2 framing is in wire.h. The stream id defaults to the message type, so
+ * each type has its own gap-free sequence. tag is the v1 sequence byte: the
+ * request id that replies, ack ranges and the reply cache work with. */
+#define PROTO_PEERS 4       // Peers whose version is remembered
+#define PROTO_RX_STREAMS 8  // Incoming streams tracked for loss and reorder
+#define PROTO_TX_STREAMS 32 // Outgoing streams with their own sequence
+#define PROTO_BENCH_ROUNDS 10000 // Encode/decode round trips of PROTO BENCH
+
+/* Send sequences of a peer that speaks v2 */
+typedef struct {
+  ip_addr_t addr;
+  u16_t port; // 0 = slot unused
+  u8_t version;
+  u8_t crc;   // Peer sent CRC trailers, so it gets them back
+  u8_t lz4;   // Peer asked for compression with PROTO LZ4 ON
+  u32_t tx_sequence[PROTO_TX_STREAMS];
+} proto_peer_t;
+
+/* Receive side of one v2 stream */
+typedef struct {
+  u16_t stream_id;
+  u8_t active;
+  seq_window_t seq;
+  u32_t received;      // Duplicates excluded
+  s64 last_transit_us; // Arrival minus send time, for the jitter estimate
+  u32_t jitter_us;     // RFC 3550 interarrival jitter
+} proto_rx_stream_t;
+
+/* Function prototypes */
+err_t proto_decode(struct pbuf *p, const ip_addr_t *addr, u16_t port,
+                   wire_v1_view_t *msg);
+err_t proto_sendto(const data_message_t *msg, const ip_addr_t *addr,
+                   u16_t port);
+u16_t proto_command(const char *args, const ip_addr_t *addr, u16_t port,
+                    u8_t sequence, char *reply, u16_t reply_size);
+
+#endif /* __PROTO_H_ */
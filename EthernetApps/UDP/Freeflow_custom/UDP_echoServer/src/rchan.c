@@ -0,0 +1,464 @@
+/*
+ * Reliable Channel Implementation
+ * A transfer is cut into RCHAN_SEGMENT byte segments, and up to a window of
+ * them are in flight at once. The receiver answers every segment with a
+ * SACK: its cumulative point plus a bitmap of what arrived beyond it, so a
+ * loss costs the sender one resend of the missing segment rather than the
+ * window. A segment is resent once RCHAN_DUP_THRESH later ones are acked or
+ * its RTO expires; the RTO follows the RTT measured on segments sent once.
+ * Segments go straight to proto_sendto: the window paces them, and the send
+ * queue is left to the messages it was sized for.
+ */
+
+#include "rchan.h"
+#include "blob.h"
+#include "proto.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Services that accept transfers; add an entry to route a new one */
+static const rchan_service_t rchan_services[] = {
+    {RCHAN_SERVICE_BLOB, blob_deliver},
+};
+
+/* Transfer being sent; only one at a time. Per-segment state is kept for
+ * the window only, at segment % RCHAN_MAX_WINDOW. */
+typedef struct {
+  u8_t active;
+  ip_addr_t addr;
+  u16_t port;
+  u16_t transfer;
+  u8_t service;
+  const u8_t *data; // Caller's buffer, read again for every resend
+  u32_t length;
+  u32_t count;
+  u32_t base;       // Lowest segment not yet acked
+  u32_t next;       // Lowest segment never sent
+  XTime started;
+  XTime last_progress;
+  XTime sent[RCHAN_MAX_WINDOW];
+  u8_t sends[RCHAN_MAX_WINDOW];
+  u8_t acked[RCHAN_MAX_WINDOW];
+} rchan_tx_t;
+
+/* Transfer being received; kept once complete so a sender that missed the
+ * final SACK is acked again */
+typedef struct {
+  u8_t active;
+  u8_t complete;
+  ip_addr_t addr;
+  u16_t port;
+  u16_t transfer;
+  u8_t service;
+  u32_t length;
+  u32_t count;
+  u32_t cumulative; // Lowest segment not yet received
+  XTime last_progress;
+  u32_t received[(RCHAN_RX_SEGMENTS + 31) / 32]; // Bit n: segment n
+} rchan_rx_t;
+
+static rchan_tx_t rchan_tx;
+static rchan_rx_t rchan_rx;
+static u8_t rchan_rx_data[RCHAN_RX_MAX];
+static u16_t rchan_next_transfer;
+static u32_t rchan_window = RCHAN_DEFAULT_WINDOW;
+
+/* RTT estimate, RFC 6298 style, kept across transfers */
+static u32_t rchan_srtt_us;
+static u32_t rchan_rttvar_us;
+static u32_t rchan_rtt_samples;
+static u32_t rchan_rto_ms = RCHAN_INITIAL_RTO_MS; // Doubled on timeouts
+
+static rchan_stats_t rchan_stats;
+
+static XTime rchan_ms_to_ticks(u32_t ms) {
+  return (XTime)ms * (COUNTS_PER_SECOND / 1000);
+}
+
+static u32_t rchan_ticks_to_us(XTime ticks) {
+  return (u32_t)(ticks / (COUNTS_PER_SECOND / 1000000));
+}
+
+static u32_t rchan_count(u32_t length) {
+  return (length + RCHAN_SEGMENT - 1) / RCHAN_SEGMENT;
+}
+
+static u16_t rchan_segment_length(u32_t length, u32_t segment) {
+  u32_t len = length - segment * RCHAN_SEGMENT;
+  return (u16_t)(len > RCHAN_SEGMENT ? RCHAN_SEGMENT : len);
+}
+
+static u32_t rchan_computed_rto_ms(void) {
+  if (rchan_rtt_samples == 0) {
+    return RCHAN_INITIAL_RTO_MS;
+  }
+  u32_t rto = (rchan_srtt_us + 4 * rchan_rttvar_us) / 1000;
+  if (rto < RCHAN_MIN_RTO_MS) {
+    rto = RCHAN_MIN_RTO_MS;
+  }
+  return rto > RCHAN_MAX_RTO_MS ? RCHAN_MAX_RTO_MS : rto;
+}
+
+static void rchan_rtt_sample(u32_t rtt_us) {
+  if (rchan_rtt_samples == 0) {
+    rchan_srtt_us = rtt_us;
+    rchan_rttvar_us = rtt_us / 2;
+  } else {
+    u32_t err = rtt_us > rchan_srtt_us ? rtt_us - rchan_srtt_us
+                                       : rchan_srtt_us - rtt_us;
+    rchan_rttvar_us = (3 * rchan_rttvar_us + err) / 4;
+    rchan_srtt_us = (7 * rchan_srtt_us + rtt_us) / 8;
+  }
+  rchan_rtt_samples++;
+  rchan_rto_ms = rchan_computed_rto_ms();
+}
+
+static err_t rchan_send_segment(u32_t segment, XTime now) {
+  data_message_t msg;
+  rchan_data_header_t hdr;
+  u16_t len = rchan_segment_length(rchan_tx.length, segment);
+
+  hdr.transfer = rchan_tx.transfer;
+  hdr.service = rchan_tx.service;
+  hdr.reserved = 0;
+  hdr.segment = segment;
+  hdr.total_length = rchan_tx.length;
+  msg.msg_type = MSG_TYPE_RCHAN_DATA;
+  msg.sequence = (u8_t)segment;
+  msg.length = sizeof(hdr) + len;
+  memcpy(msg.data, &hdr, sizeof(hdr));
+  memcpy(&msg.data[sizeof(hdr)],
+         &rchan_tx.data[segment * RCHAN_SEGMENT], len);
+
+  err_t err = proto_sendto(&msg, &rchan_tx.addr, rchan_tx.port);
+  if (err == ERR_OK) {
+    u8_t slot = segment % RCHAN_MAX_WINDOW;
+    rchan_tx.sent[slot] = now;
+    rchan_tx.sends[slot]++;
+    rchan_stats.tx_segments++;
+  }
+  return err;
+}
+
+static void rchan_tx_finish(XTime now) {
+  u32_t elapsed_us = rchan_ticks_to_us(now - rchan_tx.started);
+  rchan_stats.tx_last_kbps =
+      elapsed_us ? (u32_t)((u64)rchan_tx.length * 8000 / elapsed_us) : 0;
+  rchan_stats.tx_completed++;
+  rchan_tx.active = 0;
+  xil_printf("[INFO] Reliable transfer %d complete: %lu bytes, %lu kbit/s\r\n",
+             rchan_tx.transfer, (unsigned long)rchan_tx.length,
+             (unsigned long)rchan_stats.tx_last_kbps);
+}
+
+/* Resends expired segments, then fills the window with new ones, at most
+ * RCHAN_BURST datagrams in all. A refused datagram ends the pass. */
+static void rchan_tx_pump(XTime now) {
+  u8_t budget = RCHAN_BURST;
+  XTime rto = rchan_ms_to_ticks(rchan_rto_ms);
+
+  for (u32_t s = rchan_tx.base; s < rchan_tx.next && budget > 0; s++) {
+    u8_t slot = s % RCHAN_MAX_WINDOW;
+    if (rchan_tx.acked[slot] || now - rchan_tx.sent[slot] < rto) {
+      continue;
+    }
+    if (rchan_send_segment(s, now) != ERR_OK) {
+      return;
+    }
+    rchan_stats.tx_timeouts++;
+    budget--;
+
+    /* Back off as RFC 6298 does, once per expiry of the oldest segment
+     * rather than per segment; the next RTT sample resets it */
+    if (s == rchan_tx.base) {
+      rchan_rto_ms *= 2;
+      if (rchan_rto_ms > RCHAN_MAX_RTO_MS) {
+        rchan_rto_ms = RCHAN_MAX_RTO_MS;
+      }
+    }
+  }
+
+  while (budget > 0 && rchan_tx.next < rchan_tx.count &&
+         rchan_tx.next < rchan_tx.base + rchan_window) {
+    u8_t slot = rchan_tx.next % RCHAN_MAX_WINDOW;
+    rchan_tx.sends[slot] = 0;
+    rchan_tx.acked[slot] = 0;
+    if (rchan_send_segment(rchan_tx.next, now) != ERR_OK) {
+      return;
+    }
+    rchan_tx.next++;
+    budget--;
+  }
+}
+
+/* Sends length bytes of data to the service of that id at addr:port. data
+ * is not copied: it must stay untouched until rchan_tx_busy() is false.
+ * Returns ERR_INPROGRESS while the previous transfer is still running. */
+err_t rchan_send(u8_t service, const u8_t *data, u32_t length,
+                 const ip_addr_t *addr, u16_t port) {
+  if (length == 0) {
+    return ERR_VAL;
+  }
+  if (rchan_tx.active) {
+    return ERR_INPROGRESS;
+  }
+
+  rchan_tx.addr = *addr;
+  rchan_tx.port = port;
+  rchan_tx.transfer = rchan_next_transfer++;
+  rchan_tx.service = service;
+  rchan_tx.data = data;
+  rchan_tx.length = length;
+  rchan_tx.count = rchan_count(length);
+  rchan_tx.base = 0;
+  rchan_tx.next = 0;
+  XTime_GetTime(&rchan_tx.started);
+  rchan_tx.last_progress = rchan_tx.started;
+  rchan_tx.active = 1;
+  rchan_stats.tx_transfers++;
+
+  /* The first window goes out right away, the rest is ack-clocked */
+  rchan_tx_pump(rchan_tx.started);
+  return ERR_OK;
+}
+
+int rchan_tx_busy(void) { return rchan_tx.active; }
+
+static void rchan_on_sack(const wire_v1_view_t *msg, const ip_addr_t *addr,
+                          u16_t port) {
+  rchan_sack_t sack;
+  if (msg->length < sizeof(sack)) {
+    rchan_stats.rx_invalid++;
+    return;
+  }
+  memcpy(&sack, msg->data, sizeof(sack));
+  if (!rchan_tx.active || sack.transfer != rchan_tx.transfer ||
+      port != rchan_tx.port || !ip_addr_cmp(addr, &rchan_tx.addr)) {
+    return; // Late SACK of a finished or abandoned transfer
+  }
+  if (sack.cumulative > rchan_tx.next) {
+    rchan_stats.rx_invalid++;
+    return;
+  }
+  if (sack.cumulative < rchan_tx.base) {
+    return; // Overtaken by a later SACK
+  }
+
+  XTime now;
+  XTime_GetTime(&now);
+
+  /* Karn: a resent segment's ack cannot tell which copy it answers */
+  if (sack.trigger >= rchan_tx.base && sack.trigger < rchan_tx.next) {
+    u8_t slot = sack.trigger % RCHAN_MAX_WINDOW;
+    if (rchan_tx.sends[slot] == 1 && !rchan_tx.acked[slot]) {
+      rchan_rtt_sample(rchan_ticks_to_us(now - rchan_tx.sent[slot]));
+    }
+  }
+
+  if (sack.cumulative > rchan_tx.base) {
+    rchan_tx.base = sack.cumulative;
+    rchan_tx.last_progress = now;
+  }
+  if (rchan_tx.base == rchan_tx.count) {
+    rchan_tx_finish(now);
+    return;
+  }
+
+  u32_t highest = rchan_tx.base;
+  for (u8_t n = 0; n < 64; n++) {
+    u32_t s = sack.cumulative + 1 + n;
+    if (s >= rchan_tx.next) {
+      break;
+    }
+    if (sack.bitmap[n / 32] & (1u << (n % 32))) {
+      rchan_tx.acked[s % RCHAN_MAX_WINDOW] = 1;
+      highest = s;
+    }
+  }
+
+  /* A hole RCHAN_DUP_THRESH segments below the highest acked one is taken
+   * as lost, resent at most once per smoothed RTT */
+  XTime srtt = (XTime)rchan_srtt_us * (COUNTS_PER_SECOND / 1000000);
+  for (u32_t s = rchan_tx.base; s + RCHAN_DUP_THRESH <= highest; s++) {
+    u8_t slot = s % RCHAN_MAX_WINDOW;
+    if (rchan_tx.acked[slot] || now - rchan_tx.sent[slot] <= srtt) {
+      continue;
+    }
+    if (rchan_send_segment(s, now) != ERR_OK) {
+      break;
+    }
+    rchan_stats.tx_fast_resends++;
+  }
+
+  /* The window moved: send what now fits */
+  rchan_tx_pump(now);
+}
+
+static const rchan_service_t *rchan_service(u8_t id) {
+  for (u8_t i = 0; i < sizeof(rchan_services) / sizeof(rchan_services[0]);
+       i++) {
+    if (rchan_services[i].id == id) {
+      return &rchan_services[i];
+    }
+  }
+  return NULL;
+}
+
+static void rchan_send_sack(u32_t trigger, const ip_addr_t *addr,
+                            u16_t port) {
+  data_message_t msg;
+  rchan_sack_t sack;
+
+  sack.transfer = rchan_rx.transfer;
+  sack.service = rchan_rx.service;
+  sack.reserved = 0;
+  sack.cumulative = rchan_rx.cumulative;
+  sack.trigger = trigger;
+  sack.bitmap[0] = 0;
+  sack.bitmap[1] = 0;
+  for (u8_t n = 0; n < 64; n++) {
+    u32_t s = rchan_rx.cumulative + 1 + n;
+    if (s >= rchan_rx.count) {
+      break;
+    }
+    if (rchan_rx.received[s / 32] & (1u << (s % 32))) {
+      sack.bitmap[n / 32] |= 1u << (n % 32);
+    }
+  }
+
+  msg.msg_type = MSG_TYPE_RCHAN_SACK;
+  msg.sequence = (u8_t)trigger;
+  msg.length = sizeof(sack);
+  memcpy(msg.data, &sack, sizeof(sack));
+  proto_sendto(&msg, addr, port); // A lost SACK is covered by the next one
+}
+
+/* Takes one MSG_TYPE_RCHAN_DATA or MSG_TYPE_RCHAN_SACK message */
+void rchan_receive(const wire_v1_view_t *msg, const ip_addr_t *addr,
+                   u16_t port) {
+  if (msg->msg_type == MSG_TYPE_RCHAN_SACK) {
+    rchan_on_sack(msg, addr, port);
+    return;
+  }
+
+  rchan_data_header_t hdr;
+  if (msg->length < sizeof(hdr)) {
+    rchan_stats.rx_invalid++;
+    return;
+  }
+  memcpy(&hdr, msg->data, sizeof(hdr));
+  u16_t len = msg->length - sizeof(hdr);
+  if (hdr.total_length == 0 || hdr.total_length > RCHAN_RX_MAX ||
+      hdr.segment >= rchan_count(hdr.total_length) ||
+      len != rchan_segment_length(hdr.total_length, hdr.segment) ||
+      rchan_service(hdr.service) == NULL) {
+    rchan_stats.rx_invalid++;
+    return;
+  }
+
+  XTime now;
+  XTime_GetTime(&now);
+  if (!rchan_rx.active || rchan_rx.transfer != hdr.transfer ||
+      rchan_rx.port != port || !ip_addr_cmp(&rchan_rx.addr, addr) ||
+      rchan_rx.length != hdr.total_length ||
+      rchan_rx.service != hdr.service) {
+    /* One transfer at a time; a stalled one is replaced */
+    if (rchan_rx.active && !rchan_rx.complete &&
+        now - rchan_rx.last_progress < rchan_ms_to_ticks(RCHAN_GIVE_UP_MS)) {
+      rchan_stats.rx_busy++;
+      return;
+    }
+    memset(rchan_rx.received, 0, sizeof(rchan_rx.received));
+    rchan_rx.active = 1;
+    rchan_rx.complete = 0;
+    rchan_rx.addr = *addr;
+    rchan_rx.port = port;
+    rchan_rx.transfer = hdr.transfer;
+    rchan_rx.service = hdr.service;
+    rchan_rx.length = hdr.total_length;
+    rchan_rx.count = rchan_count(hdr.total_length);
+    rchan_rx.cumulative = 0;
+    rchan_stats.rx_transfers++;
+  }
+
+  u32_t bit = 1u << (hdr.segment % 32);
+  if (rchan_rx.received[hdr.segment / 32] & bit) {
+    rchan_stats.rx_duplicates++;
+  } else {
+    rchan_rx.received[hdr.segment / 32] |= bit;
+    memcpy(&rchan_rx_data[hdr.segment * RCHAN_SEGMENT],
+           &msg->data[sizeof(hdr)], len);
+    while (rchan_rx.cumulative < rchan_rx.count &&
+           (rchan_rx.received[rchan_rx.cumulative / 32] &
+            (1u << (rchan_rx.cumulative % 32)))) {
+      rchan_rx.cumulative++;
+    }
+    rchan_rx.last_progress = now;
+    rchan_stats.rx_segments++;
+  }
+
+  /* Duplicates are acked too: they mean an earlier SACK was lost */
+  rchan_send_sack(hdr.segment, addr, port);
+
+  if (rchan_rx.cumulative == rchan_rx.count && !rchan_rx.complete) {
+    rchan_rx.complete = 1;
+    rchan_stats.rx_completed++;
+    rchan_service(rchan_rx.service)
+        ->deliver(rchan_rx_data, rchan_rx.length, addr, port);
+  }
+}
+
+void rchan_poll(void) {
+  if (!rchan_tx.active) {
+    return;
+  }
+
+  XTime now;
+  XTime_GetTime(&now);
+  if (now - rchan_tx.last_progress > rchan_ms_to_ticks(RCHAN_GIVE_UP_MS)) {
+    xil_printf("[ERROR] Reliable transfer %d abandoned at %lu/%lu\r\n",
+               rchan_tx.transfer, (unsigned long)rchan_tx.base,
+               (unsigned long)rchan_tx.count);
+    rchan_stats.tx_aborted++;
+    rchan_tx.active = 0;
+    return;
+  }
+  rchan_tx_pump(now);
+}
+
+u16_t rchan_command(const char *args, const ip_addr_t *addr, u16_t port,
+                    u8_t sequence, char *reply, u16_t reply_size) {
+  if (strncmp(args, "WINDOW", 6) == 0) {
+    /* RCHAN WINDOW <segments> */
+    u32_t window = strtoul(args + 6, NULL, 0);
+    if (window < 1 || window > RCHAN_MAX_WINDOW) {
+      return snprintf(reply, reply_size,
+                      "RCHAN error: WINDOW needs 1-%d segments",
+                      RCHAN_MAX_WINDOW);
+    }
+    rchan_window = window;
+    return 0;
+  }
+
+  return snprintf(reply, reply_size,
+                  "RCHAN window=%lu srtt_us=%lu rto_ms=%lu tx_transfers=%lu "
+                  "tx_completed=%lu tx_aborted=%lu tx_segments=%lu "
+                  "tx_timeouts=%lu tx_fast_resends=%lu tx_last_kbps=%lu "
+                  "rx_transfers=%lu rx_completed=%lu rx_segments=%lu "
+                  "rx_duplicates=%lu rx_busy=%lu rx_invalid=%lu",
+                  (unsigned long)rchan_window, (unsigned long)rchan_srtt_us,
+                  (unsigned long)rchan_rto_ms,
+                  (unsigned long)rchan_stats.tx_transfers,
+                  (unsigned long)rchan_stats.tx_completed,
+                  (unsigned long)rchan_stats.tx_aborted,
+                  (unsigned long)rchan_stats.tx_segments,
+                  (unsigned long)rchan_stats.tx_timeouts,
+                  (unsigned long)rchan_stats.tx_fast_resends,
+                  (unsigned long)rchan_stats.tx_last_kbps,
+                  (unsigned long)rchan_stats.rx_transfers,
+                  (unsigned long)rchan_stats.rx_completed,
+                  (unsigned long)rchan_stats.rx_segments,
+                  (unsigned long)rchan_stats.rx_duplicates,
+                  (unsigned long)rchan_stats.rx_busy,
+                  (unsigned long)rchan_stats.rx_invalid);
+}
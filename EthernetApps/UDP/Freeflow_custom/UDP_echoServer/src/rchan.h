@@ -0,0 +1,90 @@
+/*
+ * Reliable Channel Header
+ * Sliding-window transfers with selective acknowledgements over UDP
+ */
+
+#ifndef __RCHAN_H_
+#define __RCHAN_H_
+
+#include "data_transfer.h"
+
+/* Channel configuration */
+#define RCHAN_DATA_HEADER_SIZE 12
+#define RCHAN_SACK_SIZE 20
+#define RCHAN_SEGMENT \
+  (MAX_DATA_SIZE - DATA_HEADER_SIZE - RCHAN_DATA_HEADER_SIZE) // 1008 bytes
+#define RCHAN_MAX_WINDOW 64       // Segments in flight; the SACK bitmap size
+#define RCHAN_DEFAULT_WINDOW 32
+#define RCHAN_RX_MAX (256 * 1024) // Largest transfer the board accepts
+#define RCHAN_RX_SEGMENTS (RCHAN_RX_MAX / RCHAN_SEGMENT + 1)
+#define RCHAN_BURST 16            // New or resent segments per main loop pass
+#define RCHAN_DUP_THRESH 3        // Later segments acked before a fast resend
+#define RCHAN_INITIAL_RTO_MS 200
+#define RCHAN_MIN_RTO_MS 5
+#define RCHAN_MAX_RTO_MS 2000
+#define RCHAN_GIVE_UP_MS 5000     // Transfer abandoned without progress
+
+/* Services a transfer is addressed to */
+typedef enum {
+  RCHAN_SERVICE_BLOB = 1 // Test blobs, see blob.h
+} rchan_service_id_t;
+
+/* MSG_TYPE_RCHAN_DATA data: this header, then bytes segment *
+ * RCHAN_SEGMENT onwards of the transfer, RCHAN_SEGMENT of them in every
+ * segment but the last */
+typedef struct {
+  u16_t transfer; // Per sender, wraps
+  u8_t service;
+  u8_t reserved;
+  u32_t segment;
+  u32_t total_length;
+} rchan_data_header_t;
+
+/* MSG_TYPE_RCHAN_SACK data, sent for every segment received. Everything
+ * below cumulative has arrived; bit n of the bitmap (low word first) is
+ * segment cumulative + 1 + n. trigger is the segment that caused this
+ * SACK, for RTT samples. */
+typedef struct {
+  u16_t transfer;
+  u8_t service;
+  u8_t reserved;
+  u32_t cumulative;
+  u32_t trigger;
+  u32_t bitmap[2];
+} rchan_sack_t;
+
+/* Receiver of completed transfers for one service. data stays valid until
+ * the next transfer to the board starts. */
+typedef struct {
+  u8_t id;
+  void (*deliver)(const u8_t *data, u32_t length, const ip_addr_t *addr,
+                  u16_t port);
+} rchan_service_t;
+
+typedef struct {
+  u32_t tx_transfers;
+  u32_t tx_completed;
+  u32_t tx_aborted;
+  u32_t tx_segments;
+  u32_t tx_timeouts;       // Segments resent after the RTO expired
+  u32_t tx_fast_resends;   // Segments resent on SACK evidence
+  u32_t tx_last_kbps;      // Throughput of the last completed transfer
+  u32_t rx_transfers;
+  u32_t rx_completed;
+  u32_t rx_segments;
+  u32_t rx_duplicates;
+  u32_t rx_busy;           // Segments of a second transfer while one runs
+  u32_t rx_invalid;
+} rchan_stats_t;
+
+/* Function prototypes */
+err_t rchan_send(u8_t service, const u8_t *data, u32_t length,
+                 const ip_addr_t *addr, u16_t port);
+int rchan_tx_busy(void);
+void rchan_receive(const wire_v1_view_t *msg, const ip_addr_t *addr,
+                   u16_t port);
+void rchan_poll(void);
+u16_t rchan_command(const char *args, const ip_addr_t *addr, u16_t port,
+                    u8_t sequence, char *reply, u16_t reply_size);
+
+#endif /* __RCHAN_H_ */
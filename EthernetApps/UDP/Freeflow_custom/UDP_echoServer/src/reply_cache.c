@@ -0,0 +1,136 @@
+/*
+ * Reply Cache Implementation
+ * Keeps the last replies per (client, request type, request id) of
+ * commands that change state and of register batches. A request that
+ * matches a cached entry with the same contents is a retransmit after a
+ * lost reply, and is answered from the stored reply instead of executing
+ * again. Replies are kept as the bytes that were sent, so a BATCH_RESULT
+ * comes back exactly as the first time. Entries expire after a few RTOs,
+ * well before a pipelining client can wrap its 8-bit id.
+ */
+
+#include "reply_cache.h"
+#include "keepalive.h"
+#include <string.h>
+
+static reply_cache_entry_t cache[REPLY_CACHE_ENTRIES];
+static reply_cache_stats_t cache_stats;
+
+/* FNV-1a over the request data */
+static u32_t reply_cache_hash(const u8_t *data, u16_t len) {
+  u32_t hash = 2166136261u;
+  for (u16_t i = 0; i < len; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static u32_t reply_cache_ttl_ms(void) {
+  return REPLY_CACHE_TTL_RTOS * keepalive_rto_ms();
+}
+
+static int reply_cache_expired(const reply_cache_entry_t *e, XTime now) {
+  return now - e->time >=
+         (XTime)reply_cache_ttl_ms() * (COUNTS_PER_SECOND / 1000);
+}
+
+static reply_cache_entry_t *reply_cache_find(const ip_addr_t *addr, u16_t port,
+                                             u8_t req_type, u8_t sequence) {
+  for (int i = 0; i < REPLY_CACHE_ENTRIES; i++) {
+    reply_cache_entry_t *e = &cache[i];
+    if (e->port == port && e->sequence == sequence &&
+        e->req_type == req_type && ip_addr_cmp(&e->addr, addr)) {
+      return e;
+    }
+  }
+  return NULL;
+}
+
+const reply_cache_entry_t *reply_cache_lookup(const ip_addr_t *addr,
+                                              u16_t port,
+                                              const wire_v1_view_t *req,
+                                              u16_t req_len) {
+  reply_cache_entry_t *e =
+      reply_cache_find(addr, port, req->msg_type, req->sequence);
+  if (e == NULL || e->req_hash != reply_cache_hash(req->data, req_len)) {
+    cache_stats.misses++;
+    return NULL;
+  }
+
+  XTime now;
+  XTime_GetTime(&now);
+  if (reply_cache_expired(e, now)) {
+    e->port = 0;
+    cache_stats.expired++;
+    cache_stats.misses++;
+    return NULL;
+  }
+
+  cache_stats.hits++;
+  return e;
+}
+
+void reply_cache_store(const ip_addr_t *addr, u16_t port,
+                       const wire_v1_view_t *req, u16_t req_len,
+                       u8_t reply_type, const void *reply, u16_t reply_len) {
+  if (reply_len > sizeof(((reply_cache_entry_t *)0)->reply)) {
+    return; // Longer replies went out in fragments and are not kept
+  }
+
+  XTime now;
+  XTime_GetTime(&now);
+
+  /* Same request id again (new command after wrap) replaces in place,
+   * otherwise take a free slot or evict the oldest entry */
+  reply_cache_entry_t *e =
+      reply_cache_find(addr, port, req->msg_type, req->sequence);
+  if (e == NULL) {
+    e = &cache[0];
+    for (int i = 0; i < REPLY_CACHE_ENTRIES; i++) {
+      if (cache[i].port == 0) {
+        e = &cache[i];
+        break;
+      }
+      if (cache[i].time < e->time) {
+        e = &cache[i];
+      }
+    }
+    if (e->port != 0) {
+      cache_stats.evictions++;
+    }
+  }
+
+  e->addr = *addr;
+  e->port = port;
+  e->req_type = req->msg_type;
+  e->sequence = req->sequence;
+  e->req_hash = reply_cache_hash(req->data, req_len);
+  e->time = now;
+  e->reply_type = reply_type;
+  e->reply_len = reply_len;
+  memcpy(e->reply, reply, reply_len);
+}
+
+u16_t reply_cache_command(const char *args, const ip_addr_t *addr, u16_t port,
+                          u8_t sequence, char *reply, u16_t reply_size) {
+  if (strncmp(args, "CLEAR", 5) == 0) {
+    memset(cache, 0, sizeof(cache));
+    memset(&cache_stats, 0, sizeof(cache_stats));
+    return 0;
+  }
+
+  int used = 0;
+  for (int i = 0; i < REPLY_CACHE_ENTRIES; i++) {
+    used += cache[i].port != 0;
+  }
+  return snprintf(reply, reply_size,
+                  "RCACHE entries=%d/%d ttl_ms=%lu hits=%lu misses=%lu "
+                  "expired=%lu evictions=%lu",
+                  used, REPLY_CACHE_ENTRIES,
+                  (unsigned long)reply_cache_ttl_ms(),
+                  (unsigned long)cache_stats.hits,
+                  (unsigned long)cache_stats.misses,
+                  (unsigned long)cache_stats.expired,
+                  (unsigned long)cache_stats.evictions);
+}
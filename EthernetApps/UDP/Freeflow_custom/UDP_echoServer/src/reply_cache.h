@@ -0,0 +1,45 @@
+/*
+ * Reply Cache Header
+ * Answers retransmitted COMMAND and BATCH messages without running them again
+ */
+
+#ifndef __REPLY_CACHE_H_
+#define __REPLY_CACHE_H_
+
+#include "data_transfer.h"
+
+/* Cache configuration */
+#define REPLY_CACHE_ENTRIES 8
+#define REPLY_CACHE_TTL_RTOS 4 // Entry lifetime in keepalive RTOs
+
+typedef struct {
+  ip_addr_t addr;
+  u16_t port;     // 0 = entry unused
+  u8_t req_type;  // Message type of the request
+  u8_t sequence;  // Request id
+  u32_t req_hash; // Tells a reused 8-bit id from a true retransmit
+  XTime time;
+  u8_t reply_type; // The reply is stored as sent: binary, not a string
+  u16_t reply_len;
+  u8_t reply[MAX_DATA_SIZE - 4];
+} reply_cache_entry_t;
+
+typedef struct {
+  u32_t hits;
+  u32_t misses;
+  u32_t expired;
+  u32_t evictions;
+} reply_cache_stats_t;
+
+/* Function prototypes */
+const reply_cache_entry_t *reply_cache_lookup(const ip_addr_t *addr,
+                                              u16_t port,
+                                              const wire_v1_view_t *req,
+                                              u16_t req_len);
+void reply_cache_store(const ip_addr_t *addr, u16_t port,
+                       const wire_v1_view_t *req, u16_t req_len,
+                       u8_t reply_type, const void *reply, u16_t reply_len);
+u16_t reply_cache_command(const char *args, const ip_addr_t *addr, u16_t port,
+                          u8_t sequence, char *reply, u16_t reply_size);
+
+#endif /* __REPLY_CACHE_H_ */
@@ -0,0 +1,147 @@
+/*
+ * RX Sink Implementation
+ * Counts and discards datagrams in the receive callback so the measured rate
+ * reflects the GEM/lwIP receive path without any application cost.
+ */
+
+#include "rx_sink.h"
+#include "traffic_gen.h"
+#include "lwip/stats.h"
+#include <string.h>
+
+static struct udp_pcb *sink_pcb;
+static sink_stats_t sink;
+static sink_seq_mode_t sink_mode = SINK_SEQ_TGEN;
+
+static void reset_sink(void) { memset(&sink, 0, sizeof(sink)); }
+
+/* Returns 1 and the sequence number if the datagram carries one */
+static int sink_sequence(const struct pbuf *p, u32_t *sequence) {
+  const u8_t *payload = (const u8_t *)p->payload;
+
+  switch (sink_mode) {
+  case SINK_SEQ_TGEN: {
+    tgen_header_t hdr;
+    if (p->len < TGEN_MIN_SIZE || payload[0] != MSG_TYPE_TGEN) {
+      return 0;
+    }
+    memcpy(&hdr, &payload[4], sizeof(hdr));
+    if (hdr.magic != TGEN_MAGIC) {
+      return 0;
+    }
+    *sequence = hdr.sequence;
+    return 1;
+  }
+  case SINK_SEQ_IPERF:
+    if (p->len < 4) {
+      return 0;
+    }
+    *sequence = ((u32_t)payload[0] << 24) | ((u32_t)payload[1] << 16) |
+                ((u32_t)payload[2] << 8) | payload[3];
+    *sequence &= 0x7FFFFFFF; // Final iperf datagram carries a negative id
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+static void udp_sink_recv(void *arg, struct udp_pcb *tpcb, struct pbuf *p,
+                          const ip_addr_t *addr, u16_t port) {
+  if (p == NULL) {
+    return;
+  }
+
+  XTime now;
+  XTime_GetTime(&now);
+  if (sink.packets == 0) {
+    sink.first_rx = now;
+    sink.first_size = p->tot_len;
+  }
+  sink.last_rx = now;
+  sink.packets++;
+  sink.bytes += p->tot_len;
+
+  u32_t sequence;
+  if (sink_sequence(p, &sequence)) {
+    seq_window_add(&sink.seq, sequence);
+  }
+
+  pbuf_free(p);
+}
+
+u16_t sink_command(const char *args, const ip_addr_t *addr, u16_t port,
+                   u8_t sequence, char *reply, u16_t reply_size) {
+  if (strncmp(args, "RESET", 5) == 0) {
+    args += 5;
+    while (*args == ' ') {
+      args++;
+    }
+    if (strncmp(args, "IPERF", 5) == 0) {
+      sink_mode = SINK_SEQ_IPERF;
+    } else if (strncmp(args, "NONE", 4) == 0) {
+      sink_mode = SINK_SEQ_NONE;
+    } else if (strncmp(args, "TGEN", 4) == 0) {
+      sink_mode = SINK_SEQ_TGEN;
+    }
+    reset_sink();
+    return 0;
+  }
+
+  sink_stats_t snap = sink;
+  u64 elapsed_us = (snap.last_rx - snap.first_rx) /
+                   (COUNTS_PER_SECOND / 1000000);
+  u32_t pps = 0;
+  u32_t kbps = 0;
+
+  /* Both rates cover the intervals after the first datagram: it opens the
+   * window, so neither its arrival nor its bytes are counted */
+  if (elapsed_us > 0 && snap.packets > 1) {
+    pps = (u32_t)((u64)(snap.packets - 1) * 1000000 / elapsed_us);
+    kbps = (u32_t)((snap.bytes - snap.first_size) * 8 * 1000 / elapsed_us);
+  }
+
+  u32_t link_drop = 0;
+  u32_t link_memerr = 0;
+#if LINK_STATS
+  link_drop = lwip_stats.link.drop;
+  link_memerr = lwip_stats.link.memerr;
+#endif
+
+  return snprintf(reply, reply_size,
+                  "SINK pkts=%lu bytes=%llu us=%lu pps=%lu mbps=%lu.%03lu "
+                  "lost=%lu ooo=%lu dup=%lu unsequenced=%lu link_drop=%lu "
+                  "link_memerr=%lu",
+                  (unsigned long)snap.packets,
+                  (unsigned long long)snap.bytes, (unsigned long)elapsed_us,
+                  (unsigned long)pps, (unsigned long)(kbps / 1000),
+                  (unsigned long)(kbps % 1000), (unsigned long)snap.seq.lost,
+                  (unsigned long)snap.seq.reordered,
+                  (unsigned long)snap.seq.duplicates,
+                  (unsigned long)(snap.packets - snap.seq.count),
+                  (unsigned long)link_drop, (unsigned long)link_memerr);
+}
+
+int start_rx_sink(void) {
+  err_t err;
+
+  reset_sink();
+
+  sink_pcb = udp_new();
+  if (!sink_pcb) {
+    xil_printf("[ERROR] Failed to create sink PCB. Out of Memory\r\n");
+    return -1;
+  }
+
+  err = udp_bind(sink_pcb, IP_ADDR_ANY, SINK_PORT);
+  if (err != ERR_OK) {
+    xil_printf("[ERROR] Unable to bind sink to port %d: err = %d\r\n",
+               SINK_PORT, err);
+    udp_remove(sink_pcb);
+    return -1;
+  }
+
+  udp_recv(sink_pcb, udp_sink_recv, NULL);
+
+  xil_printf("[INFO] RX sink listening on port %d\r\n", SINK_PORT);
+  return 0;
+}
@@ -0,0 +1,38 @@
+/*
+ * RX Sink Header
+ * Discard port used to measure the GEM/lwIP receive capacity
+ */
+
+#ifndef __RX_SINK_H_
+#define __RX_SINK_H_
+
+#include "data_transfer.h"
+#include "seq_window.h"
+#include "xtime_l.h"
+
+/* Sink configuration */
+#define SINK_PORT 5001 // Same default port as iperf
+
+/* How the sink extracts a sequence number from each datagram */
+typedef enum {
+  SINK_SEQ_TGEN = 0, // traffic_gen.h datagrams (MSG_TYPE_TGEN header)
+  SINK_SEQ_IPERF,    // iperf2 UDP: big-endian int32 id at offset 0
+  SINK_SEQ_NONE      // Count only
+} sink_seq_mode_t;
+
+/* Sink counters, updated in the receive callback */
+typedef struct {
+  u32_t packets;
+  u64 bytes;
+  u32_t first_size; // Bytes of the first datagram, before the rate window
+  seq_window_t seq;  // seq.count: packets with a usable sequence number
+  XTime first_rx; // Arrival of the first and last datagram
+  XTime last_rx;
+} sink_stats_t;
+
+/* Function prototypes */
+int start_rx_sink(void);
+u16_t sink_command(const char *args, const ip_addr_t *addr, u16_t port,
+                   u8_t sequence, char *reply, u16_t reply_size);
+
+#endif /* __RX_SINK_H_ */
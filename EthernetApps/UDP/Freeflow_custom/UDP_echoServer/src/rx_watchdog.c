@@ -0,0 +1,113 @@
+/*
+ * RX Watchdog Implementation
+ * Decides when to reset the GEM RX path from measured RX activity instead
+ * of on a fixed schedule. The old scheme reset whenever the frame counter
+ * had not moved, which also hit quiet links and dropped the first frames
+ * of the next burst. A reset now needs evidence of a stall: RX errors with
+ * no delivered frames, or silence where a configured traffic profile says
+ * frames should be arriving. Heavy learnt traffic that stops dead looks the
+ * same as a sender finishing its stream, so it is only logged as suspect.
+ */
+
+#include "rx_watchdog.h"
+#include "platform_config.h"
+#include "xparameters.h"
+#include "xemacps_hw.h"
+#include "xil_printf.h"
+#include <string.h>
+
+#define RXWD_POLLS_PER_SECOND 4
+#define RXWD_MIN_MISSED_FRAMES 8 // Expected frames that must be missing
+
+static rxwd_stats_t wd;
+static u32_t stalled_polls;
+static u32_t holdoff_polls;
+
+static void rx_watchdog_reset_rx(rxwd_reason_t reason) {
+  u32_t regctrl =
+      XEmacPs_ReadReg(PLATFORM_EMAC_BASEADDR, XEMACPS_NWCTRL_OFFSET);
+  XEmacPs_WriteReg(PLATFORM_EMAC_BASEADDR, XEMACPS_NWCTRL_OFFSET,
+                   regctrl & ~XEMACPS_NWCTRL_RXEN_MASK);
+  XEmacPs_WriteReg(PLATFORM_EMAC_BASEADDR, XEMACPS_NWCTRL_OFFSET,
+                   regctrl | XEMACPS_NWCTRL_RXEN_MASK);
+
+  rxwd_event_t *ev = &wd.log[wd.resets % RXWD_LOG_SIZE];
+  XTime_GetTime(&ev->time);
+  ev->frames_ewma = wd.frames_ewma;
+  ev->reason = (u8_t)reason;
+  wd.resets++;
+}
+
+void rx_watchdog_poll(void) {
+  /* GEM statistics registers clear on read */
+  u32_t frames = XEmacPs_ReadReg(PLATFORM_EMAC_BASEADDR, XEMACPS_RXCNT_OFFSET);
+  u32_t errors =
+      XEmacPs_ReadReg(PLATFORM_EMAC_BASEADDR, XEMACPS_RXRESERRCNT_OFFSET) +
+      XEmacPs_ReadReg(PLATFORM_EMAC_BASEADDR, XEMACPS_RXORCNT_OFFSET);
+
+  u32_t ewma_before = wd.frames_ewma;
+  wd.polls++;
+  wd.frames += frames;
+  wd.rx_errors += errors;
+  /* Exponential average of frames per poll in 1/16 units, alpha = 1/4 */
+  wd.frames_ewma = ewma_before - (ewma_before >> 2) + ((frames << 4) >> 2);
+
+  if (holdoff_polls > 0) {
+    holdoff_polls--;
+    stalled_polls = 0;
+    return;
+  }
+
+  rxwd_reason_t reason = 0;
+  if (frames == 0) {
+    if (errors > 0) {
+      reason = RXWD_REASON_RX_ERRORS;
+    } else if (wd.expect_fps > 0) {
+      reason = RXWD_REASON_EXPECTED;
+    } else if (ewma_before >= (RXWD_BUSY_FRAMES << 4)) {
+      reason = RXWD_REASON_BUSY_STOP;
+    }
+  }
+
+  if (reason == 0) {
+    stalled_polls = 0;
+    return;
+  }
+
+  /* With a configured profile, wait until enough frames are overdue */
+  u32_t needed = RXWD_STALL_POLLS;
+  if (reason == RXWD_REASON_EXPECTED) {
+    u32_t overdue = (RXWD_MIN_MISSED_FRAMES * RXWD_POLLS_PER_SECOND +
+                     wd.expect_fps - 1) /
+                    wd.expect_fps;
+    if (overdue > needed) {
+      needed = overdue;
+    }
+  }
+
+  if (++stalled_polls < needed) {
+    return;
+  }
+  if (reason == RXWD_REASON_BUSY_STOP) {
+    /* No error counts and no profile: likely a clean end of stream */
+    wd.busy_stops++;
+    xil_printf("[RXWD] Busy traffic stopped (%lu frames/poll), no reset\r\n",
+               (unsigned long)(ewma_before >> 4));
+    stalled_polls = 0;
+    wd.frames_ewma = 0; // Suspect once per stop
+    return;
+  }
+
+  rx_watchdog_reset_rx(reason);
+  stalled_polls = 0;
+  holdoff_polls = RXWD_HOLDOFF_POLLS;
+  /* Learnt activity starts over, so a dead link is not reset forever */
+  wd.frames_ewma = 0;
+}
+
+void rx_watchdog_set_expected(u32_t frames_per_second) {
+  wd.expect_fps = frames_per_second;
+  stalled_polls = 0;
+}
+
+const rxwd_stats_t *rx_watchdog_stats(void) { return &wd; }
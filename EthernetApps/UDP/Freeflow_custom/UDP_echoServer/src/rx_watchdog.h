@@ -0,0 +1,47 @@
+/*
+ * RX Watchdog Header
+ * Adaptive replacement for the fixed-interval GEM RX reset (SI #692601)
+ */
+
+#ifndef __RX_WATCHDOG_H_
+#define __RX_WATCHDOG_H_
+
+#include "lwip/arch.h"
+#include "xtime_l.h"
+
+/* Detection tuning, in watchdog polls (one per 250 ms platform timer tick) */
+#define RXWD_STALL_POLLS 2   // Consecutive stalled polls before a reset
+#define RXWD_HOLDOFF_POLLS 8 // Quiet time after a reset before re-arming
+#define RXWD_BUSY_FRAMES 64  // Frames per poll that count as heavy traffic
+#define RXWD_LOG_SIZE 8      // Most recent resets kept with timestamps
+
+/* Why a reset was triggered */
+typedef enum {
+  RXWD_REASON_RX_ERRORS = 1, // Resource/overrun errors while no frame landed
+  RXWD_REASON_EXPECTED,      // Profile says traffic is due but none arrived
+  RXWD_REASON_BUSY_STOP      // Heavy traffic stopped dead (logged, no reset)
+} rxwd_reason_t;
+
+typedef struct {
+  XTime time;
+  u32_t frames_ewma; // Frames per poll (x16) just before the reset
+  u8_t reason;
+} rxwd_event_t;
+
+typedef struct {
+  u32_t polls;
+  u32_t resets;
+  u32_t frames;    // Total frames seen by the watchdog
+  u32_t rx_errors; // Total resource + overrun errors
+  u32_t busy_stops; // Suspected stalls without evidence, logged only
+  u32_t frames_ewma;
+  u32_t expect_fps; // Expected traffic profile, 0 = learn from activity
+  rxwd_event_t log[RXWD_LOG_SIZE];
+} rxwd_stats_t;
+
+/* Function prototypes */
+void rx_watchdog_poll(void); // Main loop (deferred work) only
+void rx_watchdog_set_expected(u32_t frames_per_second);
+const rxwd_stats_t *rx_watchdog_stats(void);
+
+#endif /* __RX_WATCHDOG_H_ */
@@ -0,0 +1,239 @@
+/*
+ * Send Queue Implementation
+ * Messages that fail with a transient error (no pbuf, TX ring full) are kept
+ * per destination and retried from the main loop, so memory pressure delays
+ * delivery instead of losing command acknowledgments. Queued copies live in
+ * the slab pool at their wire size, shared by all destinations.
+ */
+
+#include "send_queue.h"
+#include "container.h"
+#include "credit.h"
+#include "fec.h"
+#include "proto.h"
+#include "slab.h"
+#include <stddef.h>
+#include <string.h>
+
+static sendq_session_t sessions[SENDQ_SESSIONS];
+static u32_t sendq_no_session; // Messages sent unqueued, every slot was busy
+
+/* Errors that go away once TX completions return memory */
+static int sendq_transient(err_t err) {
+  return err == ERR_MEM || err == ERR_BUF;
+}
+
+/* A slot can change hands only once its destination has gone quiet: an
+ * empty queue alone may just mean that destination is keeping up */
+static int sendq_idle(const sendq_session_t *s, XTime now) {
+  return s->port == 0 ||
+         (s->count == 0 &&
+          now - s->last_used >=
+              (XTime)SENDQ_IDLE_MS * (COUNTS_PER_SECOND / 1000));
+}
+
+static sendq_session_t *sendq_session(const ip_addr_t *addr, u16_t port) {
+  sendq_session_t *idle = NULL;
+  XTime now;
+  XTime_GetTime(&now);
+
+  for (int i = 0; i < SENDQ_SESSIONS; i++) {
+    sendq_session_t *s = &sessions[i];
+    if (s->port == port && ip_addr_cmp(&s->addr, addr)) {
+      s->last_used = now;
+      return s;
+    }
+    /* Unused slots first, then the destination quiet for longest */
+    if (sendq_idle(s, now) &&
+        (idle == NULL || (idle->port != 0 &&
+                          (s->port == 0 || s->last_used < idle->last_used)))) {
+      idle = s;
+    }
+  }
+
+  /* Reuse an idle slot; counters restart for the new destination */
+  if (idle != NULL) {
+    idle->addr = *addr;
+    idle->port = port;
+    idle->head = 0;
+    idle->last_used = now;
+    memset(&idle->counters, 0, sizeof(idle->counters));
+  }
+  return idle;
+}
+
+static sendq_entry_t **sendq_slot(sendq_session_t *s, u8_t index) {
+  return &s->entries[(s->head + index) % SENDQ_DEPTH];
+}
+
+/* Free the entry at queue position index, keeping the others in order */
+static void sendq_remove(sendq_session_t *s, u8_t index) {
+  slab_free(*sendq_slot(s, index));
+  for (u8_t i = index; i + 1 < s->count; i++) {
+    *sendq_slot(s, i) = *sendq_slot(s, i + 1);
+  }
+  s->count--;
+}
+
+/* Drop the oldest queued telemetry; returns 0 if there is none */
+static int sendq_drop_telemetry(sendq_session_t *s) {
+  for (u8_t i = 0; i < s->count; i++) {
+    if ((*sendq_slot(s, i))->cls == SENDQ_TELEMETRY) {
+      sendq_remove(s, i);
+      s->counters.dropped++;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* Count a message that found no room: telemetry is dropped, a reliable
+ * message is refused and reported to the caller */
+static void sendq_refuse(sendq_session_t *s, sendq_class_t cls) {
+  if (cls == SENDQ_TELEMETRY) {
+    s->counters.dropped++;
+  } else {
+    s->counters.rejected++;
+  }
+}
+
+err_t sendq_submit(const data_message_t *msg, sendq_class_t cls,
+                   const ip_addr_t *addr, u16_t port) {
+  /* Streaming messages to an FEC ON client go out wrapped, with parity */
+  if (cls == SENDQ_TELEMETRY && fec_active(msg, addr, port)) {
+    return fec_send(msg, addr, port);
+  }
+
+  /* Small messages to a PACK ON client wait in the open container */
+  if (container_add(msg, cls == SENDQ_RELIABLE, addr, port)) {
+    return ERR_OK;
+  }
+
+  sendq_session_t *s = sendq_session(addr, port);
+  if (s == NULL) {
+    sendq_no_session++;
+    credit_spend(msg, addr, port);
+    return proto_sendto(msg, addr, port);
+  }
+
+  /* Nothing waiting: send directly, keeping the queue out of the fast path.
+   * Streaming messages beyond the client's credit wait in the queue. */
+  int blocked = credit_blocked(msg, cls == SENDQ_RELIABLE, addr, port);
+  if (s->count == 0 && !blocked) {
+    err_t err = proto_sendto(msg, addr, port);
+    if (err == ERR_OK) {
+      s->counters.sent++;
+      credit_spend(msg, addr, port);
+      return ERR_OK;
+    }
+    if (!sendq_transient(err)) {
+      s->counters.send_errors++;
+      return err;
+    }
+  }
+
+  /* Oldest telemetry makes way for either class of newcomer, first for a
+   * ring slot, then for pool memory */
+  sendq_entry_t *e = NULL;
+  u16_t size = message_wire_size(msg);
+  if (s->count < SENDQ_DEPTH || sendq_drop_telemetry(s)) {
+    e = slab_alloc(offsetof(sendq_entry_t, msg) + size);
+    while (e == NULL && sendq_drop_telemetry(s)) {
+      e = slab_alloc(offsetof(sendq_entry_t, msg) + size);
+    }
+  }
+  if (e == NULL) {
+    sendq_refuse(s, cls);
+    if (cls == SENDQ_RELIABLE) {
+      xil_printf("[ERROR] Send queue full for %s:%d, response %d refused\r\n",
+                 inet_ntoa(*addr), port, msg->sequence);
+    }
+    return ERR_MEM;
+  }
+
+  memcpy(&e->msg, msg, size);
+  e->cls = (u8_t)cls;
+  *sendq_slot(s, s->count) = e;
+  s->count++;
+  s->counters.deferred++;
+  if (blocked) {
+    credit_held();
+  }
+  if (s->count > s->counters.max_depth) {
+    s->counters.max_depth = s->count;
+  }
+  return ERR_OK;
+}
+
+void sendq_flush(void) {
+  int budget = SENDQ_FLUSH_BUDGET;
+
+  for (int i = 0; i < SENDQ_SESSIONS && budget > 0; i++) {
+    sendq_session_t *s = &sessions[i];
+
+    u8_t pos = 0;
+    while (pos < s->count && budget > 0) {
+      sendq_entry_t *e = *sendq_slot(s, pos);
+
+      /* Streaming messages wait for credit; reliable ones go past them */
+      if (credit_blocked(&e->msg, e->cls == SENDQ_RELIABLE, &s->addr,
+                         s->port)) {
+        pos++;
+        continue;
+      }
+      err_t err = proto_sendto(&e->msg, &s->addr, s->port);
+      budget--;
+
+      if (err == ERR_OK) {
+        s->counters.sent++;
+        credit_spend(&e->msg, &s->addr, s->port);
+      } else if (sendq_transient(err)) {
+        s->counters.retries++;
+        return; // Memory is short for every destination, try next pass
+      } else {
+        s->counters.send_errors++;
+      }
+
+      if (pos == 0) {
+        slab_free(e);
+        s->head = (s->head + 1) % SENDQ_DEPTH;
+        s->count--;
+      } else {
+        sendq_remove(s, pos);
+      }
+    }
+  }
+}
+
+u16_t sendq_command(const char *args, const ip_addr_t *addr, u16_t port,
+                    u8_t sequence, char *reply, u16_t reply_size) {
+  if (strncmp(args, "RESET", 5) == 0) {
+    for (int i = 0; i < SENDQ_SESSIONS; i++) {
+      memset(&sessions[i].counters, 0, sizeof(sessions[i].counters));
+    }
+    sendq_no_session = 0;
+    return 0;
+  }
+
+  int len = snprintf(reply, reply_size, "QUEUE depth=%d no_session=%lu",
+                     SENDQ_DEPTH, (unsigned long)sendq_no_session);
+
+  for (int i = 0; i < SENDQ_SESSIONS && len < reply_size; i++) {
+    const sendq_session_t *s = &sessions[i];
+    if (s->port == 0) {
+      continue;
+    }
+    len += snprintf(reply + len, reply_size - len,
+                    " | %s:%d pending=%d max=%lu sent=%lu deferred=%lu "
+                    "retries=%lu dropped=%lu rejected=%lu errors=%lu",
+                    inet_ntoa(s->addr), s->port, s->count,
+                    (unsigned long)s->counters.max_depth,
+                    (unsigned long)s->counters.sent,
+                    (unsigned long)s->counters.deferred,
+                    (unsigned long)s->counters.retries,
+                    (unsigned long)s->counters.dropped,
+                    (unsigned long)s->counters.rejected,
+                    (unsigned long)s->counters.send_errors);
+  }
+  return len < reply_size ? len : reply_size - 1;
+}
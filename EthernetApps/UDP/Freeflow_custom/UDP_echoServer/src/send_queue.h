@@ -0,0 +1,59 @@
+/*
+ * Send Queue Header
+ * Bounded per-destination queues that hold messages lwIP could not send yet
+ */
+
+#ifndef __SEND_QUEUE_H_
+#define __SEND_QUEUE_H_
+
+#include "data_transfer.h"
+
+/* Queue configuration */
+#define SENDQ_SESSIONS 4      // Destinations with their own queue
+#define SENDQ_DEPTH 16        // Pending messages per destination
+#define SENDQ_FLUSH_BUDGET 8  // Queued datagrams sent per main loop pass
+#define SENDQ_IDLE_MS 10000   // Quiet this long, a destination frees its slot
+
+/* Delivery policy, chosen by the sender */
+typedef enum {
+  SENDQ_TELEMETRY = 0, // Superseded by newer samples: drop the oldest when full
+  SENDQ_RELIABLE       // Command responses and console text: never dropped
+} sendq_class_t;
+
+/* Queued message, slab-allocated at its wire size: msg is only valid up to
+ * message_wire_size(&msg) bytes */
+typedef struct {
+  u8_t cls;
+  data_message_t msg;
+} sendq_entry_t;
+
+/* Per-destination counters */
+typedef struct {
+  u32_t sent;
+  u32_t deferred;      // Messages that had to wait in the queue
+  u32_t retries;       // Queued sends that failed again on a later pass
+  u32_t dropped;       // Telemetry dropped to make room (oldest first)
+  u32_t rejected;      // Reliable messages refused: queue full of reliable
+                       // ones, or the slab pool exhausted
+  u32_t send_errors;   // Non-transient udp_sendto errors, message discarded
+  u32_t max_depth;
+} sendq_counters_t;
+
+typedef struct {
+  ip_addr_t addr;
+  u16_t port; // 0 = slot unused
+  u8_t head;
+  u8_t count;
+  XTime last_used; // Last message submitted to this destination
+  sendq_counters_t counters;
+  sendq_entry_t *entries[SENDQ_DEPTH]; // Storage shared through the slab
+} sendq_session_t;
+
+/* Function prototypes */
+err_t sendq_submit(const data_message_t *msg, sendq_class_t cls,
+                   const ip_addr_t *addr, u16_t port);
+void sendq_flush(void);
+u16_t sendq_command(const char *args, const ip_addr_t *addr, u16_t port,
+                    u8_t sequence, char *reply, u16_t reply_size);
+
+#endif /* __SEND_QUEUE_H_ */
@@ -0,0 +1,40 @@
+/*
+ * Sequence Window Implementation
+ * Shared by the v2 stream tracking in proto.c and the RX sink. A sequence
+ * ahead of the highest one counts every skipped number as lost; a late one
+ * fills its gap if it is still inside the window. Comparisons are modulo
+ * 2^32, so a long run wraps without a glitch. Late arrivals older than the
+ * window, or older than the first sequence, cannot be matched to a gap and
+ * leave lost as it is.
+ */
+
+#include "seq_window.h"
+
+seq_result_t seq_window_add(seq_window_t *w, u32_t sequence) {
+  if (w->count++ == 0) {
+    w->first = sequence;
+    w->highest = sequence;
+    w->window = 1;
+    return SEQ_NEW;
+  }
+
+  u32_t ahead = sequence - w->highest;
+  if ((s32_t)ahead > 0) {
+    w->lost += ahead - 1;
+    w->window = ahead >= SEQ_WINDOW_BITS ? 1 : (w->window << ahead) | 1;
+    w->highest = sequence;
+    return SEQ_NEW;
+  }
+
+  u32_t behind = w->highest - sequence;
+  if (behind < SEQ_WINDOW_BITS && (w->window >> behind) & 1) {
+    w->duplicates++;
+    return SEQ_DUPLICATE;
+  }
+  w->reordered++;
+  if (behind < SEQ_WINDOW_BITS && (s32_t)(sequence - w->first) > 0) {
+    w->window |= 1u << behind;
+    w->lost--;
+  }
+  return SEQ_LATE;
+}
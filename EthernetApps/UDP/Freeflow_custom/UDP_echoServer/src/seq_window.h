@@ -0,0 +1,33 @@
+/*
+ * Sequence Window Header
+ * Loss, reordering and duplicate accounting over a 32-bit sequence space
+ */
+
+#ifndef __SEQ_WINDOW_H_
+#define __SEQ_WINDOW_H_
+
+#include "lwip/arch.h"
+
+#define SEQ_WINDOW_BITS 32 // Late arrivals matched against this many
+
+/* What one sequence number turned out to be */
+typedef enum {
+  SEQ_NEW = 0,  // Newest so far, or the first one
+  SEQ_LATE,     // Behind the newest, not seen before
+  SEQ_DUPLICATE // Already seen within the window
+} seq_result_t;
+
+typedef struct {
+  u32_t count;     // Sequences added, duplicates included
+  u32_t first;     // First sequence added
+  u32_t highest;   // Highest sequence seen
+  u32_t window;    // Bit n set: highest - n has been received
+  u32_t lost;      // Gaps not (yet) filled by late arrivals
+  u32_t reordered; // Arrived after a higher sequence
+  u32_t duplicates;
+} seq_window_t;
+
+/* Function prototypes */
+seq_result_t seq_window_add(seq_window_t *w, u32_t sequence);
+
+#endif /* __SEQ_WINDOW_H_ */
@@ -0,0 +1,106 @@
+/*
+ * Slab Allocator Implementation
+ * Each size class is a static array carved into equal objects at start-up.
+ * A request takes the smallest class that fits and spills into a larger one
+ * only when its own is empty, so alloc and free are O(1), nothing ever
+ * fragments, and exhaustion is a counted NULL instead of a heap failure.
+ */
+
+#include "slab.h"
+#include <string.h>
+
+static u64 slab_small[SLAB_SMALL_SIZE * SLAB_SMALL_COUNT / 8];
+static u64 slab_medium[SLAB_MEDIUM_SIZE * SLAB_MEDIUM_COUNT / 8];
+static u64 slab_large[SLAB_LARGE_SIZE * SLAB_LARGE_COUNT / 8];
+
+static slab_class_t slab_classes[SLAB_CLASSES] = {
+    {(u8_t *)slab_small, SLAB_SMALL_SIZE, SLAB_SMALL_COUNT},
+    {(u8_t *)slab_medium, SLAB_MEDIUM_SIZE, SLAB_MEDIUM_COUNT},
+    {(u8_t *)slab_large, SLAB_LARGE_SIZE, SLAB_LARGE_COUNT},
+};
+
+static void slab_class_reset(slab_class_t *c) {
+  c->free_list = NULL;
+  for (int i = c->count - 1; i >= 0; i--) {
+    void *obj = c->base + (u32_t)i * c->size;
+    *(void **)obj = c->free_list;
+    c->free_list = obj;
+  }
+  c->in_use = 0;
+  c->peak = 0;
+  c->allocs = 0;
+  c->frees = 0;
+  c->spills = 0;
+  c->failures = 0;
+}
+
+void slab_init(void) {
+  for (int i = 0; i < SLAB_CLASSES; i++) {
+    slab_class_reset(&slab_classes[i]);
+  }
+}
+
+void *slab_alloc(u16_t size) {
+  int fit = 0;
+  while (fit < SLAB_CLASSES && slab_classes[fit].size < size) {
+    fit++;
+  }
+  if (fit == SLAB_CLASSES) {
+    return NULL; // Larger than any class
+  }
+
+  for (int i = fit; i < SLAB_CLASSES; i++) {
+    slab_class_t *c = &slab_classes[i];
+    if (c->free_list == NULL) {
+      continue;
+    }
+    void *obj = c->free_list;
+    c->free_list = *(void **)obj;
+    c->allocs++;
+    if (++c->in_use > c->peak) {
+      c->peak = c->in_use;
+    }
+    if (i != fit) {
+      c->spills++;
+    }
+    return obj;
+  }
+
+  slab_classes[fit].failures++;
+  return NULL;
+}
+
+void slab_free(void *obj) {
+  if (obj == NULL) {
+    return;
+  }
+
+  for (int i = 0; i < SLAB_CLASSES; i++) {
+    slab_class_t *c = &slab_classes[i];
+    if ((u8_t *)obj >= c->base &&
+        (u8_t *)obj < c->base + (u32_t)c->count * c->size) {
+      *(void **)obj = c->free_list;
+      c->free_list = obj;
+      c->in_use--;
+      c->frees++;
+      return;
+    }
+  }
+
+  xil_printf("[ERROR] slab_free of foreign pointer %p\r\n", obj);
+}
+
+u16_t slab_command(const char *args, const ip_addr_t *addr, u16_t port,
+                   u8_t sequence, char *reply, u16_t reply_size) {
+  int len = snprintf(reply, reply_size, "SLAB");
+  for (int i = 0; i < SLAB_CLASSES && len < reply_size; i++) {
+    const slab_class_t *c = &slab_classes[i];
+    len += snprintf(reply + len, reply_size - len,
+                    " | %dB in_use=%d/%d peak=%d allocs=%lu frees=%lu "
+                    "spills=%lu failures=%lu",
+                    c->size, c->in_use, c->count, c->peak,
+                    (unsigned long)c->allocs, (unsigned long)c->frees,
+                    (unsigned long)c->spills, (unsigned long)c->failures);
+  }
+  return len < reply_size ? len : reply_size - 1;
+}
@@ -0,0 +1,42 @@
+/*
+ * Slab Allocator Header
+ * Fixed-size object pools for application state, kept off the lwIP heap
+ */
+
+#ifndef __SLAB_H_
+#define __SLAB_H_
+
+#include "data_transfer.h"
+
+/* Size classes: object size in bytes (multiple of 8) and object count */
+#define SLAB_SMALL_SIZE 64    // Trimmed heartbeats, ack ranges, small state
+#define SLAB_SMALL_COUNT 32
+#define SLAB_MEDIUM_SIZE 256  // Short text responses, batch results
+#define SLAB_MEDIUM_COUNT 16
+#define SLAB_LARGE_SIZE 1032  // Full data_message_t frames plus a header
+#define SLAB_LARGE_COUNT 32
+#define SLAB_CLASSES 3
+
+/* One size class. Free objects are chained through their first word, so
+ * alloc and free are a pointer swap. */
+typedef struct {
+  u8_t *base;
+  u16_t size;
+  u16_t count;
+  void *free_list;
+  u16_t in_use;
+  u16_t peak;
+  u32_t allocs;
+  u32_t frees;
+  u32_t spills;   // Allocations served by this class for a smaller request
+  u32_t failures; // Requests that fit this class but found every fit empty
+} slab_class_t;
+
+/* Function prototypes */
+void slab_init(void);
+void *slab_alloc(u16_t size);
+void slab_free(void *obj);
+u16_t slab_command(const char *args, const ip_addr_t *addr, u16_t port,
+                   u8_t sequence, char *reply, u16_t reply_size);
+
+#endif /* __SLAB_H_ */
@@ -0,0 +1,195 @@
+/*
+ * Status Frame Implementation
+ * With FRAME ON the board sends its status channels as binary frames at a
+ * fixed period. A keyframe carries every channel; in between only a bitmap
+ * of the channels that changed since the previous frame and their new
+ * values go out, which for slowly moving status is a small fraction of the
+ * keyframe. A client that sees a sequence gap asks for a keyframe with
+ * FRAME KEY instead of waiting for the next periodic one.
+ */
+
+#include "status_frame.h"
+#include "send_queue.h"
+#include "telemetry.h"
+#include <stdlib.h>
+#include <string.h>
+
+static u8_t frame_enabled;
+static ip_addr_t frame_dest_ip;
+static u16_t frame_dest_port;
+static u32_t frame_period_ms = STATUS_FRAME_DEFAULT_PERIOD_MS;
+static u32_t frame_key_every = STATUS_FRAME_DEFAULT_KEY_EVERY;
+static XTime frame_next_due;
+static u32_t frame_since_key; // Periods since the last keyframe went out
+static u8_t frame_key_pending;
+static u32_t frame_sequence;
+
+static s32_t frame_values[STATUS_FRAME_CHANNELS];
+static s32_t frame_sent[STATUS_FRAME_CHANNELS]; // As of the last frame sent
+
+static status_frame_stats_t frame_stats;
+
+void status_frame_set(u16_t channel, s32_t value) {
+  if (channel < STATUS_FRAME_CHANNELS) {
+    frame_values[channel] = value;
+  }
+}
+
+/* Builds the delta against the last frame sent; returns its data length,
+ * or 0 if nothing changed */
+static u16_t status_frame_delta(u8_t *out) {
+  u8_t *bitmap = out;
+  u8_t *values = out + STATUS_FRAME_BITMAP_SIZE;
+  u16_t changed = 0;
+
+  memset(bitmap, 0, STATUS_FRAME_BITMAP_SIZE);
+  for (u16_t ch = 0; ch < STATUS_FRAME_CHANNELS; ch++) {
+    if (frame_values[ch] != frame_sent[ch]) {
+      bitmap[ch / 8] |= (u8_t)(1 << (ch % 8));
+      memcpy(&values[changed * 4], &frame_values[ch], 4);
+      changed++;
+    }
+  }
+  return changed == 0 ? 0 : STATUS_FRAME_BITMAP_SIZE + changed * 4;
+}
+
+static void status_frame_send(void) {
+  data_message_t msg;
+  status_frame_header_t hdr;
+  u8_t *out = &msg.data[sizeof(hdr)];
+  u16_t len = 0;
+
+  int key = frame_key_pending || frame_since_key >= frame_key_every;
+  if (!key) {
+    len = status_frame_delta(out);
+    if (len == 0) {
+      frame_stats.unchanged++;
+      return;
+    }
+    key = len >= sizeof(frame_values); // No cheaper than a keyframe
+  }
+  if (key) {
+    memcpy(out, frame_values, sizeof(frame_values));
+    len = sizeof(frame_values);
+  }
+
+  hdr.kind = key ? STATUS_FRAME_KEY : STATUS_FRAME_DELTA;
+  hdr.stream = 0;
+  hdr.channels = STATUS_FRAME_CHANNELS;
+  hdr.sequence = frame_sequence;
+  memcpy(msg.data, &hdr, sizeof(hdr));
+  msg.msg_type = MSG_TYPE_STATUS_FRAME;
+  msg.sequence = sequence_counter++;
+  msg.length = sizeof(hdr) + len;
+
+  /* Nothing advances on failure: the next frame covers the same changes */
+  if (sendq_submit(&msg, SENDQ_TELEMETRY, &frame_dest_ip, frame_dest_port) !=
+      ERR_OK) {
+    frame_stats.send_failures++;
+    return;
+  }
+
+  frame_sequence++;
+  memcpy(frame_sent, frame_values, sizeof(frame_sent));
+  if (key) {
+    frame_key_pending = 0;
+    frame_since_key = 0;
+    frame_stats.keyframes++;
+  } else {
+    frame_stats.deltas++;
+  }
+  frame_stats.bytes += msg.length;
+  frame_stats.key_bytes += sizeof(hdr) + sizeof(frame_values);
+}
+
+void status_frame_poll(void) {
+  if (!frame_enabled) {
+    return;
+  }
+
+  XTime now;
+  XTime_GetTime(&now);
+  if (now < frame_next_due) {
+    return;
+  }
+  frame_next_due = now + (XTime)frame_period_ms * (COUNTS_PER_SECOND / 1000);
+
+  for (u8_t i = 0; i < STATUS_FRAME_COUNTERS; i++) {
+    frame_values[i] = (s32_t)telemetry_counter(i);
+  }
+  frame_since_key++;
+  status_frame_send();
+}
+
+u16_t status_frame_command(const char *args, const ip_addr_t *addr,
+                           u16_t port, u8_t sequence, char *reply,
+                           u16_t reply_size) {
+  char *end;
+
+  if (strncmp(args, "ON", 2) == 0) {
+    /* FRAME ON [period_ms] [key_every] */
+    const char *cursor = args + 2;
+    u32_t period = strtoul(cursor, &end, 0);
+    if (end != cursor) {
+      cursor = end;
+      u32_t key_every = strtoul(cursor, &end, 0);
+      if (period == 0 || (end != cursor && key_every == 0)) {
+        return snprintf(reply, reply_size,
+                        "FRAME error: usage FRAME ON [period_ms >= 1] "
+                        "[key_every >= 1] | OFF | KEY | SET <channel> "
+                        "<value>");
+      }
+      frame_period_ms = period;
+      if (end != cursor) {
+        frame_key_every = key_every;
+      }
+    }
+    frame_dest_ip = *addr;
+    frame_dest_port = port;
+    frame_enabled = 1;
+    frame_key_pending = 1; // A new receiver has no state to apply deltas to
+    frame_next_due = 0;
+    return 0;
+  } else if (strncmp(args, "OFF", 3) == 0) {
+    frame_enabled = 0;
+    return 0;
+  } else if (strncmp(args, "KEY", 3) == 0) {
+    /* Receiver lost sync: keyframe with the next frame */
+    frame_key_pending = 1;
+    frame_stats.key_requests++;
+    return 0;
+  } else if (strncmp(args, "SET", 3) == 0) {
+    u32_t channel = strtoul(args + 3, &end, 0);
+    if (end == args + 3 || channel < STATUS_FRAME_COUNTERS ||
+        channel >= STATUS_FRAME_CHANNELS) {
+      return snprintf(reply, reply_size,
+                      "FRAME error: SET channel must be %d-%d",
+                      STATUS_FRAME_COUNTERS, STATUS_FRAME_CHANNELS - 1);
+    }
+    status_frame_set((u16_t)channel, (s32_t)strtol(end, NULL, 0));
+    return 0;
+  }
+
+  /* Compression against sending every frame as a keyframe, x10 fixed */
+  u32_t ratio_x10 = frame_stats.bytes
+                        ? (u32_t)((u64)frame_stats.key_bytes * 10 /
+                                  frame_stats.bytes)
+                        : 0;
+  return snprintf(reply, reply_size,
+                  "FRAME %s channels=%d period_ms=%lu key_every=%lu "
+                  "sequence=%lu keyframes=%lu deltas=%lu unchanged=%lu "
+                  "key_requests=%lu send_failures=%lu bytes=%lu "
+                  "ratio=%lu.%lux",
+                  frame_enabled ? "on" : "off", STATUS_FRAME_CHANNELS,
+                  (unsigned long)frame_period_ms,
+                  (unsigned long)frame_key_every,
+                  (unsigned long)frame_sequence,
+                  (unsigned long)frame_stats.keyframes,
+                  (unsigned long)frame_stats.deltas,
+                  (unsigned long)frame_stats.unchanged,
+                  (unsigned long)frame_stats.key_requests,
+                  (unsigned long)frame_stats.send_failures,
+                  (unsigned long)frame_stats.bytes,
+                  (unsigned long)(ratio_x10 / 10),
+                  (unsigned long)(ratio_x10 % 10));
+}
@@ -0,0 +1,55 @@
+/*
+ * Status Frame Header
+ * Multi-channel status as keyframes plus change-bitmap delta frames
+ */
+
+#ifndef __STATUS_FRAME_H_
+#define __STATUS_FRAME_H_
+
+#include "data_transfer.h"
+
+/* Frame configuration */
+#define STATUS_FRAME_CHANNELS 200        // A keyframe must fit one message
+#define STATUS_FRAME_DEFAULT_PERIOD_MS 100
+#define STATUS_FRAME_DEFAULT_KEY_EVERY 50 // Frames per keyframe
+#define STATUS_FRAME_BITMAP_SIZE ((STATUS_FRAME_CHANNELS + 7) / 8)
+
+/* Channels 0 to STATUS_FRAME_COUNTERS - 1 mirror the telemetry counters
+ * and are refreshed every frame; the rest are set by status_frame_set() */
+#define STATUS_FRAME_COUNTERS 5
+
+typedef enum {
+  STATUS_FRAME_KEY = 0, // Every channel value
+  STATUS_FRAME_DELTA    // Bitmap of changed channels, then their values
+} status_frame_kind_t;
+
+/* MSG_TYPE_STATUS_FRAME data: this header, then for a keyframe one s32 per
+ * channel, for a delta a bitmap (bit n of byte n / 8 set: channel n
+ * changed) followed by the new s32 of each changed channel in order. A
+ * delta applies to the frame with the previous sequence only; a receiver
+ * that missed one drops deltas until the next keyframe. */
+typedef struct {
+  u8_t kind;
+  u8_t stream;    // Always 0 for now: the board has one status stream
+  u16_t channels;
+  u32_t sequence; // Per stream, one per frame sent
+} status_frame_header_t;
+
+typedef struct {
+  u32_t keyframes;
+  u32_t deltas;
+  u32_t unchanged;  // Frames skipped because nothing changed
+  u32_t key_requests;
+  u32_t send_failures;
+  u32_t bytes;      // Frame bytes sent
+  u32_t key_bytes;  // Bytes the same frames would have cost as keyframes
+} status_frame_stats_t;
+
+/* Function prototypes */
+void status_frame_set(u16_t channel, s32_t value);
+void status_frame_poll(void);
+u16_t status_frame_command(const char *args, const ip_addr_t *addr,
+                           u16_t port, u8_t sequence, char *reply,
+                           u16_t reply_size);
+
+#endif /* __STATUS_FRAME_H_ */
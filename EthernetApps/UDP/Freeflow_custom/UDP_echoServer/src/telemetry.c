@@ -0,0 +1,235 @@
+/*
+ * Telemetry Implementation
+ * Each stream is sampled at its own rate from the main loop and reduced to
+ * min/max/mean/count records over a time window or every N samples, so slow
+ * monitoring clients get summaries instead of every raw sample.
+ */
+
+#include "telemetry.h"
+#include "send_queue.h"
+#include <stdlib.h>
+#include <string.h>
+
+static telem_stream_t streams[TELEM_STREAM_COUNT];
+static u32_t loop_passes;
+
+static const char *const stream_names[TELEM_STREAM_COUNT] = {
+    "loops", "rx_packets", "rx_bytes", "tx_packets", "tx_bytes"};
+
+static const char *const mode_names[] = {"OFF", "RAW", "TIME", "COUNT"};
+
+/* Cumulative counter behind each stream */
+u32_t telemetry_counter(u8_t stream) {
+  switch (stream) {
+  case TELEM_STREAM_LOOPS:
+    return loop_passes;
+  case TELEM_STREAM_RX_PACKETS:
+    return stats.packets_received;
+  case TELEM_STREAM_RX_BYTES:
+    return stats.bytes_received;
+  case TELEM_STREAM_TX_PACKETS:
+    return stats.packets_sent;
+  case TELEM_STREAM_TX_BYTES:
+    return stats.bytes_sent;
+  default:
+    return 0;
+  }
+}
+
+/* Change of a stream's counter since *last, which is brought up to date.
+ * The stats counters restart from 0 when reset_statistics() runs; across a
+ * reset the count since then is the delta, not a wrapped difference. */
+u32_t telemetry_delta(u8_t stream, u32_t *last, u32_t *last_resets) {
+  u32_t counter = telemetry_counter(stream);
+  u32_t delta = counter - *last;
+  if (*last_resets != stats.resets && stream != TELEM_STREAM_LOOPS) {
+    delta = counter;
+  }
+  *last = counter;
+  *last_resets = stats.resets;
+  return delta;
+}
+
+static u32_t ticks_to_ms(XTime t) {
+  return (u32_t)(t / (COUNTS_PER_SECOND / 1000));
+}
+
+static void telemetry_send(telem_stream_t *s, const char *text) {
+  data_message_t msg;
+  msg.msg_type = MSG_TYPE_DATA;
+  msg.sequence = sequence_counter++;
+  msg.length = snprintf((char *)msg.data, sizeof(msg.data), "%s", text);
+  sendq_submit(&msg, SENDQ_TELEMETRY, &s->dest_ip, s->dest_port);
+}
+
+static void telemetry_window_reset(telem_stream_t *s, XTime now) {
+  s->window_start = now;
+  s->count = 0;
+  s->min = 0xFFFFFFFF;
+  s->max = 0;
+  s->sum = 0;
+}
+
+static void telemetry_emit(u8_t stream, XTime now) {
+  telem_stream_t *s = &streams[stream];
+  char text[128];
+
+  if (s->count > 0) {
+    snprintf(text, sizeof(text),
+             "AGG %s n=%lu min=%lu max=%lu mean=%lu t=%lums dt=%lums",
+             stream_names[stream], (unsigned long)s->count,
+             (unsigned long)s->min, (unsigned long)s->max,
+             (unsigned long)(s->sum / s->count),
+             (unsigned long)ticks_to_ms(now),
+             (unsigned long)ticks_to_ms(now - s->window_start));
+    telemetry_send(s, text);
+    s->records++;
+  }
+  telemetry_window_reset(s, now);
+}
+
+static void telemetry_add(u8_t stream, u32_t value, XTime now) {
+  telem_stream_t *s = &streams[stream];
+  s->samples++;
+
+  if (s->mode == TELEM_MODE_RAW || s->send_raw) {
+    char text[64];
+    snprintf(text, sizeof(text), "RAW %s v=%lu t=%lums", stream_names[stream],
+             (unsigned long)value, (unsigned long)ticks_to_ms(now));
+    telemetry_send(s, text);
+  }
+  if (s->mode == TELEM_MODE_RAW) {
+    return;
+  }
+
+  s->count++;
+  s->sum += value;
+  if (value < s->min) {
+    s->min = value;
+  }
+  if (value > s->max) {
+    s->max = value;
+  }
+
+  if (s->mode == TELEM_MODE_COUNT && s->count >= s->window) {
+    telemetry_emit(stream, now);
+  }
+}
+
+void telemetry_poll(void) {
+  loop_passes++;
+
+  XTime now;
+  XTime_GetTime(&now);
+
+  for (u8_t i = 0; i < TELEM_STREAM_COUNT; i++) {
+    telem_stream_t *s = &streams[i];
+    if (s->mode == TELEM_MODE_OFF) {
+      continue;
+    }
+
+    /* Samples are deltas of the cumulative counter over one period */
+    for (int n = 0; n < TELEM_MAX_CATCHUP && now >= s->next_due; n++) {
+      telemetry_add(i, telemetry_delta(i, &s->last_counter, &s->last_resets),
+                    now);
+      s->next_due += s->period;
+    }
+    if (now >= s->next_due) {
+      s->next_due = now + s->period; // Too far behind, skip missed samples
+    }
+
+    XTime window_ticks = (XTime)s->window * (COUNTS_PER_SECOND / 1000);
+    if (s->mode == TELEM_MODE_TIME && now - s->window_start >= window_ticks) {
+      telemetry_emit(i, now);
+    }
+  }
+}
+
+static u16_t agg_status(char *reply, u16_t reply_size) {
+  int len = snprintf(reply, reply_size, "AGG");
+  for (u8_t i = 0; i < TELEM_STREAM_COUNT && len < reply_size; i++) {
+    const telem_stream_t *s = &streams[i];
+    len += snprintf(reply + len, reply_size - len,
+                    " | %d:%s %s%s rate=%lu window=%lu samples=%lu records=%lu",
+                    i, stream_names[i], mode_names[s->mode],
+                    s->send_raw ? "+RAW" : "", (unsigned long)s->rate_hz,
+                    (unsigned long)s->window, (unsigned long)s->samples,
+                    (unsigned long)s->records);
+  }
+  return len < reply_size ? len : reply_size - 1;
+}
+
+u16_t agg_command(const char *args, const ip_addr_t *addr, u16_t port,
+                  u8_t sequence, char *reply, u16_t reply_size) {
+  if (*args == '\0') {
+    return agg_status(reply, reply_size);
+  }
+
+  /* AGG <stream> OFF | <rate_hz> RAW | <rate_hz> TIME <ms> [RAW]
+   *                  | <rate_hz> COUNT <n> [RAW] */
+  char *end;
+  u32_t stream = strtoul(args, &end, 0);
+  if (end == args || stream >= TELEM_STREAM_COUNT) {
+    return snprintf(reply, reply_size, "AGG error: stream 0-%d",
+                    TELEM_STREAM_COUNT - 1);
+  }
+  while (*end == ' ') {
+    end++;
+  }
+
+  telem_stream_t *s = &streams[stream];
+  if (strncmp(end, "OFF", 3) == 0) {
+    s->mode = TELEM_MODE_OFF;
+    return 0;
+  }
+
+  const char *cursor = end;
+  u32_t rate = strtoul(cursor, &end, 0);
+  while (*end == ' ') {
+    end++;
+  }
+
+  u8_t mode;
+  u32_t window = 0;
+  if (strncmp(end, "RAW", 3) == 0) {
+    mode = TELEM_MODE_RAW;
+    end += 3;
+  } else if (strncmp(end, "TIME", 4) == 0) {
+    mode = TELEM_MODE_TIME;
+    window = strtoul(end + 4, &end, 0);
+  } else if (strncmp(end, "COUNT", 5) == 0) {
+    mode = TELEM_MODE_COUNT;
+    window = strtoul(end + 5, &end, 0);
+  } else {
+    mode = TELEM_MODE_OFF;
+  }
+
+  if (mode == TELEM_MODE_OFF || rate == 0 || rate > TELEM_MAX_RATE_HZ ||
+      (mode != TELEM_MODE_RAW && window == 0)) {
+    return snprintf(reply, reply_size,
+                    "AGG error: usage AGG <stream> OFF | <rate_hz 1-%d> "
+                    "RAW | TIME <ms> [RAW] | COUNT <n> [RAW]",
+                    TELEM_MAX_RATE_HZ);
+  }
+
+  XTime now;
+  XTime_GetTime(&now);
+
+  memset(s, 0, sizeof(*s));
+  s->mode = mode;
+  s->send_raw = mode != TELEM_MODE_RAW && strstr(end, "RAW") != NULL;
+  s->rate_hz = rate;
+  s->window = window;
+  s->dest_ip = *addr;
+  s->dest_port = port;
+  s->period = COUNTS_PER_SECOND / rate;
+  s->next_due = now + s->period;
+  s->last_counter = telemetry_counter(stream);
+  s->last_resets = stats.resets;
+  telemetry_window_reset(s, now);
+
+  xil_printf("[INFO] Telemetry %s: %s at %d Hz window %d to %s:%d\r\n",
+             stream_names[stream], mode_names[mode], rate, window,
+             inet_ntoa(*addr), port);
+  return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * Telemetry Header
+ * Samples board counters per stream and decimates them before transmit
+ */
+
+#ifndef __TELEMETRY_H_
+#define __TELEMETRY_H_
+
+#include "data_transfer.h"
+#include "xtime_l.h"
+
+/* Pipeline limits */
+#define TELEM_MAX_RATE_HZ 10000 // Highest sampling rate per stream
+#define TELEM_MAX_CATCHUP 4     // Samples taken in one pass when running late
+
+/* Streams sampled by the board */
+typedef enum {
+  TELEM_STREAM_LOOPS = 0, // Main loop passes per sample period
+  TELEM_STREAM_RX_PACKETS,
+  TELEM_STREAM_RX_BYTES,
+  TELEM_STREAM_TX_PACKETS,
+  TELEM_STREAM_TX_BYTES,
+  TELEM_STREAM_COUNT
+} telem_stream_id_t;
+
+/* What is sent per stream */
+typedef enum {
+  TELEM_MODE_OFF = 0,
+  TELEM_MODE_RAW,   // Every sample
+  TELEM_MODE_TIME,  // One summary per time window
+  TELEM_MODE_COUNT  // One summary every N samples
+} telem_mode_t;
+
+typedef struct {
+  u8_t mode;
+  u8_t send_raw;  // Also send raw samples next to the summaries
+  u32_t rate_hz;
+  u32_t window;   // Milliseconds (TIME) or samples (COUNT)
+  ip_addr_t dest_ip;
+  u16_t dest_port;
+
+  /* Sampling */
+  XTime period;
+  XTime next_due;
+  u32_t last_counter; // Previous cumulative value, samples are deltas
+  u32_t last_resets;  // stats.resets when last_counter was read
+
+  /* Current window */
+  XTime window_start;
+  u32_t count;
+  u32_t min;
+  u32_t max;
+  u64 sum;
+
+  /* Totals */
+  u32_t samples;
+  u32_t records;
+} telem_stream_t;
+
+/* Function prototypes */
+void telemetry_poll(void);
+u32_t telemetry_counter(u8_t stream);
+u32_t telemetry_delta(u8_t stream, u32_t *last, u32_t *last_resets);
+u16_t agg_command(const char *args, const ip_addr_t *addr, u16_t port,
+                  u8_t sequence, char *reply, u16_t reply_size);
+
+#endif /* __TELEMETRY_H_ */
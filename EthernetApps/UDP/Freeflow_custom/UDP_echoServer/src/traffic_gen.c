@@ -0,0 +1,181 @@
+/*
+ * Traffic Generator Implementation
+ * Sends sequenced UDP datagrams of configurable size, count and rate to the
+ * client that issued the TGEN command, then reports the achieved rate.
+ */
+
+#include "traffic_gen.h"
+#include "xtime_l.h"
+#include <stdlib.h>
+#include <string.h>
+
+static tgen_run_t tgen;
+static u32_t tgen_next_run_id = 1;
+static XTime tgen_ticks_per_packet;
+static XTime tgen_next_due;
+static XTime tgen_first_tx;
+static XTime tgen_last_tx;
+
+/* Parse the next unsigned number from a command string */
+static u32_t parse_u32(const char **cursor, u32_t fallback) {
+  char *end;
+  unsigned long value = strtoul(*cursor, &end, 0);
+  if (end == *cursor) {
+    return fallback;
+  }
+  *cursor = end;
+  return (u32_t)value;
+}
+
+static void tgen_send_report(void) {
+  char report[160];
+  XTime elapsed = tgen_last_tx - tgen_first_tx;
+  u32_t pps = 0;
+  u32_t kbps = 0;
+
+  if (elapsed > 0 && tgen.sent > 1) {
+    /* Rate over the interval between the first and last datagram */
+    pps = (u32_t)(((u64)(tgen.sent - 1) * COUNTS_PER_SECOND) / elapsed);
+    kbps = (u32_t)(((u64)(tgen.sent - 1) * tgen.size * 8 *
+                    (COUNTS_PER_SECOND / 1000)) /
+                   elapsed);
+  }
+
+  snprintf(report, sizeof(report),
+           "TGEN done run=%lu sent=%lu bytes=%lu us=%lu pps=%lu kbps=%lu "
+           "alloc_fail=%lu send_fail=%lu",
+           (unsigned long)tgen.run_id, (unsigned long)tgen.sent,
+           (unsigned long)tgen.bytes_sent,
+           (unsigned long)(elapsed / (COUNTS_PER_SECOND / 1000000)),
+           (unsigned long)pps, (unsigned long)kbps,
+           (unsigned long)tgen.alloc_failures,
+           (unsigned long)tgen.send_failures);
+
+  xil_printf("[TGEN] %s\r\n", report);
+  send_text_message(MSG_TYPE_RESPONSE, tgen.cmd_sequence, report,
+                    &tgen.dest_ip, tgen.dest_port);
+}
+
+u16_t tgen_command(const char *args, const ip_addr_t *addr, u16_t port,
+                   u8_t sequence, char *reply, u16_t reply_size) {
+  if (strncmp(args, "STOP", 4) == 0) {
+    if (tgen.state == TGEN_RUNNING) {
+      tgen.state = TGEN_IDLE;
+      tgen_send_report();
+    }
+    return 0;
+  }
+
+  if (tgen.state == TGEN_RUNNING) {
+    return snprintf(reply, reply_size, "TGEN busy run=%lu sent=%lu/%lu",
+                    (unsigned long)tgen.run_id, (unsigned long)tgen.sent,
+                    (unsigned long)tgen.count);
+  }
+
+  /* TGEN [size] [count] [rate_pps] */
+  u32_t size = parse_u32(&args, TGEN_DEFAULT_SIZE);
+  u32_t count = parse_u32(&args, TGEN_DEFAULT_COUNT);
+  u32_t rate = parse_u32(&args, 0);
+
+  if (size < TGEN_MIN_SIZE || size > TGEN_MAX_SIZE || count == 0 ||
+      rate > COUNTS_PER_SECOND) {
+    return snprintf(reply, reply_size,
+                    "TGEN error: usage TGEN <size %d-%d> <count> <rate_pps>",
+                    (int)TGEN_MIN_SIZE, TGEN_MAX_SIZE);
+  }
+
+  memset(&tgen, 0, sizeof(tgen));
+  tgen.run_id = tgen_next_run_id++;
+  tgen.size = (u16_t)size;
+  tgen.count = count;
+  tgen.rate = rate;
+  tgen.dest_ip = *addr;
+  tgen.dest_port = port;
+  tgen.cmd_sequence = sequence;
+
+  tgen_ticks_per_packet = rate ? (COUNTS_PER_SECOND / rate) : 0;
+  XTime_GetTime(&tgen_next_due);
+  tgen.state = TGEN_RUNNING;
+
+  xil_printf("[TGEN] Run %d: %d x %d bytes at %d pps to %s:%d\r\n",
+             tgen.run_id, count, size, rate, inet_ntoa(*addr), port);
+
+  return snprintf(reply, reply_size,
+                  "TGEN started run=%lu size=%lu count=%lu rate=%lu",
+                  (unsigned long)tgen.run_id, (unsigned long)size,
+                  (unsigned long)count, (unsigned long)rate);
+}
+
+/* Build one generated datagram in place in a freshly allocated pbuf */
+static struct pbuf *tgen_build_packet(XTime now) {
+  struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, tgen.size, PBUF_RAM);
+  if (p == NULL) {
+    return NULL;
+  }
+
+  u8_t *payload = (u8_t *)p->payload;
+  tgen_header_t hdr;
+  hdr.magic = TGEN_MAGIC;
+  hdr.run_id = tgen.run_id;
+  hdr.sequence = tgen.sent;
+  hdr.count = tgen.count;
+  hdr.tx_time_lo = (u32_t)now;
+  hdr.tx_time_hi = (u32_t)(now >> 32);
+
+  /* data_message_t header, followed by the generator header and filler */
+  payload[0] = MSG_TYPE_TGEN;
+  payload[1] = (u8_t)tgen.sent;
+  u16_t data_len = tgen.size - 4;
+  memcpy(&payload[2], &data_len, sizeof(data_len));
+  memcpy(&payload[4], &hdr, sizeof(hdr));
+  for (u16_t i = TGEN_MIN_SIZE; i < tgen.size; i++) {
+    payload[i] = (u8_t)i;
+  }
+
+  return p;
+}
+
+void tgen_poll(void) {
+  if (tgen.state != TGEN_RUNNING) {
+    return;
+  }
+
+  XTime now;
+  XTime_GetTime(&now);
+
+  for (int burst = 0; burst < TGEN_MAX_BURST && tgen.sent < tgen.count;
+       burst++) {
+    if (tgen_ticks_per_packet != 0 && now < tgen_next_due) {
+      break;
+    }
+
+    struct pbuf *p = tgen_build_packet(now);
+    if (p == NULL) {
+      tgen.alloc_failures++;
+      break; // Retry on the next pass once TX completions free memory
+    }
+
+    err_t err = udp_sendto(data_pcb, p, &tgen.dest_ip, tgen.dest_port);
+    pbuf_free(p);
+    if (err != ERR_OK) {
+      tgen.send_failures++;
+      break;
+    }
+
+    if (tgen.sent == 0) {
+      tgen_first_tx = now;
+    }
+    tgen_last_tx = now;
+    tgen.sent++;
+    tgen.bytes_sent += tgen.size;
+    tgen_next_due += tgen_ticks_per_packet;
+    XTime_GetTime(&now);
+  }
+
+  if (tgen.sent >= tgen.count) {
+    tgen.state = TGEN_IDLE;
+    tgen_send_report();
+  }
+}
+
+int tgen_is_running(void) { return tgen.state == TGEN_RUNNING; }
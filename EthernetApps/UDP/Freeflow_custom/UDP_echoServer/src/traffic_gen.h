@@ -0,0 +1,53 @@
+/*
+ * Traffic Generator Header
+ * iperf-style UDP source used to measure the board's TX ceiling
+ */
+
+#ifndef __TRAFFIC_GEN_H_
+#define __TRAFFIC_GEN_H_
+
+#include "data_transfer.h"
+
+/* Generator limits */
+#define TGEN_MAGIC 0x4E454754 // "TGEN" on the wire (little endian)
+#define TGEN_MIN_SIZE (4 + sizeof(tgen_header_t))
+#define TGEN_MAX_SIZE 1472 // Largest UDP payload without IP fragmentation
+#define TGEN_DEFAULT_SIZE 1024
+#define TGEN_DEFAULT_COUNT 10000
+#define TGEN_MAX_BURST 32 // Datagrams per main loop pass, keeps RX serviced
+
+/* Header at the start of every generated datagram's data field */
+typedef struct {
+  u32_t magic;
+  u32_t run_id;
+  u32_t sequence; // 0 .. count - 1
+  u32_t count;    // Datagrams in this run
+  u32_t tx_time_lo;
+  u32_t tx_time_hi; // XTime ticks when the datagram was queued for TX
+} tgen_header_t;
+
+/* Generator state */
+typedef enum { TGEN_IDLE = 0, TGEN_RUNNING } tgen_state_t;
+
+typedef struct {
+  tgen_state_t state;
+  u32_t run_id;
+  u16_t size;  // UDP payload bytes per datagram
+  u32_t count; // Datagrams to send
+  u32_t rate;  // Datagrams per second, 0 = as fast as possible
+  u32_t sent;
+  u32_t bytes_sent;
+  u32_t alloc_failures;
+  u32_t send_failures;
+  ip_addr_t dest_ip;
+  u16_t dest_port;
+  u8_t cmd_sequence; // Sequence of the TGEN command, echoed in the report
+} tgen_run_t;
+
+/* Function prototypes */
+u16_t tgen_command(const char *args, const ip_addr_t *addr, u16_t port,
+                   u8_t sequence, char *reply, u16_t reply_size);
+void tgen_poll(void);
+int tgen_is_running(void);
+
+#endif /* __TRAFFIC_GEN_H_ */
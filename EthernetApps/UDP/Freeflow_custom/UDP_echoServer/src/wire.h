@@ -0,0 +1,219 @@
+/*
+ * Wire Format Header
+ * Message types and v1/v2 framing shared by the firmware (C) and the Qt
+ * client (C++17). Depends on nothing but the C library.
+ */
+
+#ifndef __WIRE_H_
+#define __WIRE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Message types for protocol */
+typedef enum {
+  MSG_TYPE_DATA = 0x01,
+  MSG_TYPE_COMMAND = 0x02,
+  MSG_TYPE_RESPONSE = 0x03,
+  MSG_TYPE_HEARTBEAT = 0x04,
+  MSG_TYPE_TGEN = 0x05,      // Traffic generator datagram
+  MSG_TYPE_FREC = 0x06,      // Flight recorder dump chunk
+  MSG_TYPE_ACK_RANGE = 0x07, // Coalesced command acknowledgements
+  MSG_TYPE_BATCH = 0x08,     // Register operation script
+  MSG_TYPE_BATCH_RESULT = 0x09,
+  MSG_TYPE_CONTAINER = 0x0A, // Several small messages in one datagram
+  MSG_TYPE_STATUS_FRAME = 0x0B, // Keyframe or delta of the status channels
+  MSG_TYPE_FRAGMENT = 0x0C, // Piece of a message larger than one frame
+  MSG_TYPE_FEC = 0x0D, // Streaming message in an FEC group, or its parity
+  MSG_TYPE_RCHAN_DATA = 0x0E, // Segment of a reliable channel transfer
+  MSG_TYPE_RCHAN_SACK = 0x0F, // Selective acknowledgement of segments
+  MSG_TYPE_CREDIT = 0x10      // Flow control grant, or a paused board's probe
+} msg_type_t;
+
+/* v1: u8 msg_type, u8 sequence, u16 length, then the data. Sent either
+ * trimmed to length or as the full WIRE_V1_MAX_SIZE frame. */
+#define WIRE_V1_HEADER_SIZE 4
+#define WIRE_V1_MAX_SIZE 1024
+#define WIRE_V1_MAX_DATA (WIRE_V1_MAX_SIZE - WIRE_V1_HEADER_SIZE)
+#define WIRE_V1_LENGTH_OFFSET 2
+
+/* v2: u8 version, u8 msg_type, u8 flags, u8 tag, u32 sequence, u64
+ * timestamp, u16 stream_id, u16 length, then the data and, with
+ * WIRE_FLAG_CRC, a CRC32C trailer that length does not count. v1 starts
+ * with its msg_type, always below 0x80, so the first byte tells the two
+ * apart. */
+#define WIRE_V2_VERSION 0x82
+#define WIRE_V2_HEADER_SIZE 20
+#define WIRE_V2_SEQUENCE_OFFSET 4
+#define WIRE_V2_TIMESTAMP_OFFSET 8
+#define WIRE_V2_STREAM_OFFSET 16
+#define WIRE_V2_LENGTH_OFFSET 18
+#define WIRE_CRC_SIZE 4
+
+/* v2 header flags */
+#define WIRE_FLAG_REPLY 0x01 // tag echoes the request this answers
+#define WIRE_FLAG_CRC 0x02   // A CRC32C of header and data follows the data
+#define WIRE_FLAG_LZ4 0x04   // data is an LZ4 block, length its packed size
+
+#ifdef __cplusplus
+#define WIRE_STATIC_ASSERT(cond, msg) static_assert(cond, msg)
+#else
+#define WIRE_STATIC_ASSERT(cond, msg) _Static_assert(cond, msg)
+#endif
+
+/* Frames go through the codec below, but the firmware still copies payload
+ * headers such as those of fragment.h and rchan.h to and from native
+ * structs, which is only correct on a little-endian host */
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "wire.h: payload headers are native structs, little-endian hosts only"
+#endif
+
+WIRE_STATIC_ASSERT(WIRE_V2_LENGTH_OFFSET + 2 == WIRE_V2_HEADER_SIZE,
+                   "v2 fields must fill the header exactly");
+WIRE_STATIC_ASSERT(WIRE_V2_VERSION >= 0x80 && MSG_TYPE_CREDIT < 0x80,
+                   "v2 must stay distinguishable from v1 by its first byte");
+
+/* Why a datagram was rejected */
+typedef enum {
+  WIRE_OK = 0,
+  WIRE_ERR_SHORT,   // Shorter than its header
+  WIRE_ERR_VERSION, // Not the framing the decoder was asked for
+  WIRE_ERR_LENGTH   // length runs past the datagram or the frame limit
+} wire_status_t;
+
+/* Decoded v1 header; data points into the datagram, nothing is copied */
+typedef struct {
+  uint8_t msg_type;
+  uint8_t sequence;
+  uint16_t length;
+  const uint8_t *data;
+} wire_v1_view_t;
+
+/* v2 header in host order */
+typedef struct {
+  uint8_t version;
+  uint8_t msg_type;
+  uint8_t flags;
+  uint8_t tag;
+  uint32_t sequence;  // Per stream, never wraps in practice
+  uint64_t timestamp; // Sender clock in microseconds
+  uint16_t stream_id;
+  uint16_t length;
+} wire_v2_header_t;
+
+/* Decoded v2 datagram; data and crc point into it, crc is NULL without
+ * WIRE_FLAG_CRC */
+typedef struct {
+  wire_v2_header_t hdr;
+  const uint8_t *data;
+  const uint8_t *crc;
+} wire_v2_view_t;
+
+/* Little-endian accessors, safe at any alignment */
+static inline uint16_t wire_get_u16(const uint8_t *p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t wire_get_u32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+         ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t wire_get_u64(const uint8_t *p) {
+  return (uint64_t)wire_get_u32(p) | ((uint64_t)wire_get_u32(p + 4) << 32);
+}
+
+static inline void wire_put_u16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void wire_put_u32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static inline void wire_put_u64(uint8_t *p, uint64_t v) {
+  wire_put_u32(p, (uint32_t)v);
+  wire_put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static inline int wire_is_v2(const uint8_t *buf, size_t len) {
+  return len >= 1 && buf[0] == WIRE_V2_VERSION;
+}
+
+/* Writes a v1 header; length bytes of data are expected to follow */
+static inline void wire_v1_encode(uint8_t *buf, uint8_t msg_type,
+                                  uint8_t sequence, uint16_t length) {
+  buf[0] = msg_type;
+  buf[1] = sequence;
+  wire_put_u16(buf + WIRE_V1_LENGTH_OFFSET, length);
+}
+
+/* Messages may be trimmed to their data, only the header is mandatory */
+static inline wire_status_t wire_v1_decode(const uint8_t *buf, size_t len,
+                                           wire_v1_view_t *view) {
+  if (len < WIRE_V1_HEADER_SIZE) {
+    return WIRE_ERR_SHORT;
+  }
+  if (buf[0] == WIRE_V2_VERSION) {
+    return WIRE_ERR_VERSION;
+  }
+  view->msg_type = buf[0];
+  view->sequence = buf[1];
+  view->length = wire_get_u16(buf + WIRE_V1_LENGTH_OFFSET);
+  view->data = buf + WIRE_V1_HEADER_SIZE;
+  if (view->length > len - WIRE_V1_HEADER_SIZE ||
+      view->length > WIRE_V1_MAX_DATA) {
+    return WIRE_ERR_LENGTH;
+  }
+  return WIRE_OK;
+}
+
+static inline void wire_v2_encode(uint8_t *buf, const wire_v2_header_t *hdr) {
+  buf[0] = WIRE_V2_VERSION;
+  buf[1] = hdr->msg_type;
+  buf[2] = hdr->flags;
+  buf[3] = hdr->tag;
+  wire_put_u32(buf + WIRE_V2_SEQUENCE_OFFSET, hdr->sequence);
+  wire_put_u64(buf + WIRE_V2_TIMESTAMP_OFFSET, hdr->timestamp);
+  wire_put_u16(buf + WIRE_V2_STREAM_OFFSET, hdr->stream_id);
+  wire_put_u16(buf + WIRE_V2_LENGTH_OFFSET, hdr->length);
+}
+
+/* Checks the framing only; the CRC is left to the caller. An LZ4 block
+ * never exceeds the data it packs, so length is held to the v1 limit.
+ * crc is NULL unless the datagram decoded with a trailer. */
+static inline wire_status_t wire_v2_decode(const uint8_t *buf, size_t len,
+                                           wire_v2_view_t *view) {
+  view->crc = NULL;
+  if (len < WIRE_V2_HEADER_SIZE) {
+    return WIRE_ERR_SHORT;
+  }
+  if (buf[0] != WIRE_V2_VERSION) {
+    return WIRE_ERR_VERSION;
+  }
+  view->hdr.version = buf[0];
+  view->hdr.msg_type = buf[1];
+  view->hdr.flags = buf[2];
+  view->hdr.tag = buf[3];
+  view->hdr.sequence = wire_get_u32(buf + WIRE_V2_SEQUENCE_OFFSET);
+  view->hdr.timestamp = wire_get_u64(buf + WIRE_V2_TIMESTAMP_OFFSET);
+  view->hdr.stream_id = wire_get_u16(buf + WIRE_V2_STREAM_OFFSET);
+  view->hdr.length = wire_get_u16(buf + WIRE_V2_LENGTH_OFFSET);
+  view->data = buf + WIRE_V2_HEADER_SIZE;
+
+  size_t trailer = (view->hdr.flags & WIRE_FLAG_CRC) ? WIRE_CRC_SIZE : 0;
+  if ((size_t)view->hdr.length + trailer > len - WIRE_V2_HEADER_SIZE ||
+      view->hdr.length > WIRE_V1_MAX_DATA) {
+    return WIRE_ERR_LENGTH;
+  }
+  if (trailer != 0) {
+    view->crc = view->data + view->hdr.length;
+  }
+  return WIRE_OK;
+}
+
+#endif /* __WIRE_H_ */